@@ -38,6 +38,7 @@ stdenv.mkDerivation rec {
   patchPhase = ''
     patchShebangs util/test_fnvsum.py
     patchShebangs util/test_ncp.py
+    patchShebangs util/test_nhex.py
 
     # see include/nlc_linuxversion.h for the gory details
     if [ -e /usr/include/linux/version.h ]; then
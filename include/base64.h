@@ -0,0 +1,98 @@
+#ifndef base64_h_
+#define base64_h_
+
+/*	base64.h
+ * Base64 (RFC 4648 standard and URL-safe alphabets) and base32 (RFC 4648)
+ * encoding and decoding, in the style of binhex.h:
+ *	b2b64() / b642b()	base64
+ *	b2b32() / b322b()	base32
+ * plus streaming state (struct base_stream) for data arriving in chunks.
+ *
+ * Long inputs go through AVX2 kernels (base32 also needs BMI2),
+ * picked at runtime; results are identical to the scalar code.
+ * b64_isa() caps the kernels used, as hx_isa() does for binhex.
+ *
+ * Decoding ignores whitespace; padding ('=') is optional but must be
+ * correct where present. Base32 decoding accepts lower case.
+ *
+ * (c) 2018 Sirio Balmelli
+ */
+#include <nonlibc.h>
+#include <binhex.h> /* HX_SCALAR ... */
+#include <stdint.h>
+#include <sys/types.h> /* ssize_t */
+
+
+/* flags */
+#define B64_URL		0x1	/* base64 URL-safe alphabet: '-' and '_' for '+' and '/' */
+#define B64_NOPAD	0x2	/* encoding: no trailing '=' padding */
+
+
+/* Encoded length (without '\0') of 'n' bytes, with padding. */
+#define B64_ENC_LEN(n) (((n) + 2) / 3 * 4)
+#define B32_ENC_LEN(n) (((n) + 4) / 5 * 8)
+
+/* Decoded length of 'len' characters, at most. */
+#define B64_DEC_MAX(len) (((len) + 3) / 4 * 3)
+#define B32_DEC_MAX(len) (((len) + 7) / 8 * 5)
+
+
+/*	base_stream
+ * State of a base64 or base32 stream (one or the other: don't mix calls).
+ * Encoding carries a partial group of bytes across chunks,
+ * decoding a partial group of characters.
+ */
+struct base_stream {
+	unsigned	flags;
+	size_t		cols;	/* encode: chars per line (a whole number of groups); 0: one line */
+	size_t		col;	/* encode: chars on the current line */
+	size_t		pos;	/* decode: characters consumed */
+	uint64_t	bits;	/* partial group */
+	unsigned	cnt;	/* bytes (encode) or chars (decode) in 'bits' */
+	unsigned	pad;	/* decode: '=' seen */
+};
+
+
+NLC_PUBLIC	unsigned	b64_isa(unsigned max);
+
+NLC_PUBLIC	size_t		b2b64(const unsigned char *bin, char *out, size_t byte_cnt,
+					unsigned flags);
+NLC_PUBLIC	ssize_t		b642b(const char *b64, size_t len, uint8_t *out, unsigned flags);
+
+NLC_PUBLIC	size_t		b2b32(const unsigned char *bin, char *out, size_t byte_cnt,
+					unsigned flags);
+NLC_PUBLIC	ssize_t		b322b(const char *b32, size_t len, uint8_t *out, unsigned flags);
+
+
+NLC_PUBLIC	void		base_stream_init(struct base_stream *bs, unsigned flags, size_t cols);
+
+/* Chars b64_stream_enc() / b32_stream_enc() (or _enc_end()) write for 'len' bytes, at most. */
+NLC_INLINE	size_t		b64_stream_enc_max(const struct base_stream *bs, size_t len)
+{
+	size_t chars = B64_ENC_LEN(len + bs->cnt);
+	size_t line = bs->cols / 4 * 4;
+	return chars + (line ? chars / line + 1 : 0);
+}
+NLC_INLINE	size_t		b32_stream_enc_max(const struct base_stream *bs, size_t len)
+{
+	size_t chars = B32_ENC_LEN(len + bs->cnt);
+	size_t line = bs->cols / 8 * 8;
+	return chars + (line ? chars / line + 1 : 0);
+}
+
+NLC_PUBLIC	size_t		b64_stream_enc(struct base_stream *bs, const void *bin, size_t len,
+					char *out);
+NLC_PUBLIC	size_t		b64_stream_enc_end(struct base_stream *bs, char *out);
+NLC_PUBLIC	ssize_t		b64_stream_dec(struct base_stream *bs, const char *b64, size_t len,
+					uint8_t *out);
+NLC_PUBLIC	ssize_t		b64_stream_dec_end(struct base_stream *bs, uint8_t *out);
+
+NLC_PUBLIC	size_t		b32_stream_enc(struct base_stream *bs, const void *bin, size_t len,
+					char *out);
+NLC_PUBLIC	size_t		b32_stream_enc_end(struct base_stream *bs, char *out);
+NLC_PUBLIC	ssize_t		b32_stream_dec(struct base_stream *bs, const char *b32, size_t len,
+					uint8_t *out);
+NLC_PUBLIC	ssize_t		b32_stream_dec_end(struct base_stream *bs, uint8_t *out);
+
+
+#endif /* base64_h_ */
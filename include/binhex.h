@@ -7,10 +7,27 @@
  * (c) Sirio Balmelli
  */
 #include <nonlibc.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h> /* ssize_t */
 #include <string.h> /* memset() */
 #include <nlc_endian.h>
 
+/*	SIMD
+ * b2hx(), b2hx_BE(), hx2b() and hx2b_BE() run long inputs through SSE2,
+ * AVX2 or AVX-512 (BW) kernels, picked at runtime for the CPU.
+ * Results are identical to the scalar code whichever kernels run.
+ * hx_isa() caps the kernels used (e.g. HX_SCALAR for none) and returns
+ * the level actually in use.
+ */
+#define HX_SCALAR	0
+#define HX_SSE2		1
+#define HX_AVX2		2
+#define HX_AVX512	3
+
+NLC_PUBLIC	unsigned hx_isa(unsigned max);
+
+
 NLC_PUBLIC	size_t b2hx(const unsigned char *bin, char *hex, size_t byte_cnt);
 /* Big Endian */
 NLC_PUBLIC	size_t b2hx_BE(const unsigned char *bin, char *hex, size_t byte_cnt);
@@ -78,4 +95,67 @@ NLC_INLINE uint64_t	hx2b_u64	(const char *hex)
 	hx2b(hex, (uint8_t *)&ret, sizeof(uint64_t));
 	return le64toh(ret);
 }
+
+
+/*	hx_stream
+ * Hex conversion of data arriving (or leaving) in arbitrary chunks,
+ * in stream order (as b2hx_BE()/hx2b_BE(): first byte first).
+ * State carries across chunks: the line position when encoding;
+ * a lone nibble (odd digit count so far) when decoding.
+ * Decoding skips whitespace anywhere, also between the two digits of a byte.
+ */
+struct hx_stream {
+	size_t		cols;	/* encode: bytes per line; 0 is one long line */
+	size_t		col;	/* encode: bytes on the current line */
+	size_t		pos;	/* decode: characters consumed */
+	uint8_t		nibble;	/* decode: high nibble waiting for the low one */
+	bool		half;	/* decode: 'nibble' is valid */
+};
+
+NLC_PUBLIC	void	hx_stream_init(struct hx_stream *hs, size_t cols);
+
+/* Chars hx_stream_enc() writes for 'len' bytes, at most. */
+NLC_INLINE	size_t	hx_stream_enc_max(const struct hx_stream *hs, size_t len)
+{
+	return len * 2 + (hs->cols ? len / hs->cols + 1 : 0);
+}
+
+NLC_PUBLIC	size_t	hx_stream_enc(struct hx_stream *hs, const void *bin, size_t len,
+				char *hex);
+NLC_PUBLIC	size_t	hx_stream_enc_end(struct hx_stream *hs, char *hex);
+
+NLC_PUBLIC	ssize_t	hx_stream_dec(struct hx_stream *hs, const char *hex, size_t len,
+				uint8_t *out);
+NLC_PUBLIC	int	hx_stream_dec_end(struct hx_stream *hs);
+
+
+/*	hx_parse
+ * Bulk parsing of delimited hex tokens (e.g. "0x1f, 0xa0 7\n") into uint64_t,
+ * the equivalent of hx2b_u64() on each, in a single forward pass.
+ * A bad token gives a value of 0 and an error:
+ */
+#define HX_TOK_OK	0
+#define HX_TOK_BAD	1	/* not a hex digit in the token */
+#define HX_TOK_RANGE	2	/* more than 64 significant bits */
+#define HX_TOK_EMPTY	3	/* prefix ('0x' etc.) only */
+
+struct hx_tok_err {
+	size_t		index;	/* of the token, counting from 0 */
+	size_t		offset;	/* of the token in the buffer */
+	int		code;
+};
+
+struct hx_parse {
+	size_t			pos;		/* buffer offset to continue from */
+	size_t			tokens;		/* parsed so far */
+	size_t			err_cnt;	/* bad tokens so far (recorded or not) */
+	struct hx_tok_err	*errs;		/* first 'err_max' errors */
+	size_t			err_max;
+};
+
+NLC_PUBLIC	void	hx_parse_init(struct hx_parse *hp, struct hx_tok_err *errs, size_t err_max);
+NLC_PUBLIC	size_t	hx_parse_u64(struct hx_parse *hp, const char *buf, size_t len,
+				uint64_t *out, size_t out_max);
+
+
 #endif /* binhex_h_ */
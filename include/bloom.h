@@ -0,0 +1,94 @@
+#ifndef bloom_h_
+#define bloom_h_
+
+/*	bloom.h		blocked Bloom filter (and counting variant)
+ *
+ * A compact probabilistic set: "definitely not present" or "probably present".
+ * Meant as a negative-lookup cache in front of slower indexes.
+ *
+ * - blocked: each key sets/tests bits in a single 64B (cache line) block,
+ *   so a lookup costs one cache miss whatever the number of probes
+ * - one fnv_hash64() per key: the block and all 'k' probes within it
+ *   are derived from it by double hashing
+ * - counting variant (BLOOM_COUNTING): 4-bit counters instead of bits,
+ *   so keys may be deleted; counters saturate at 15 and then stick
+ * - batch insert/query hash a run of keys and prefetch their blocks
+ *   before touching any of them
+ * - the filter lives in nmem memory, laid out exactly as its file:
+ *   bloom_save() writes it and bloom_open() maps it back, with no parsing
+ *   or loading (a filter opened from a file is read-only)
+ *
+ * Sizing is by bits (or counters) per key; 'k' is picked for that ratio.
+ * Approximate false-positive rates (worse than an unblocked filter,
+ * increasingly so at more bits per key):
+ *	 8 bits/key: 2.5%	10 bits/key: 1.1%	16 bits/key: 0.25%
+ * A counting filter has only 128 counters per block: 10 counters/key give 1.8%.
+ *
+ * The file is in host byte order (refused, not converted, on mismatch).
+ *
+ * Thread-safety: concurrent queries only.
+ *
+ * (c) 2018 Sirio Balmelli
+ */
+
+#include <nonlibc.h>
+#include <nmem.h>
+#include <stddef.h> /* size_t */
+#include <stdint.h>
+
+
+/* bytes per block: one cache line */
+#define BLOOM_BLOCK	64
+/* keys per batch in bloom_{add|has}_batch(): hashed and prefetched together */
+#define BLOOM_BATCH	16
+
+/* flags */
+#define BLOOM_COUNTING	0x1
+
+
+/*	bloom_hdr
+ * Start of the mapping (and file); blocks follow.
+ * Padded to one block so that blocks are cache-line aligned.
+ */
+struct bloom_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	flags;
+	uint32_t	k;		/* probes per key */
+	uint32_t	reserved;
+	uint64_t	blocks;
+	uint64_t	count;		/* keys added (less those deleted) */
+	uint8_t		pad[BLOOM_BLOCK - 40];
+};
+
+NLC_ASSERT(bloom_hdr_size, sizeof(struct bloom_hdr) == BLOOM_BLOCK);
+
+
+/*	bloom
+ */
+struct bloom {
+	struct nmem		nm;
+	struct bloom_hdr	*hdr;
+	uint8_t			*blocks;
+	int			readonly;	/* opened from a file */
+};
+
+
+NLC_PUBLIC __attribute__((warn_unused_result))
+		struct bloom	*bloom_new(size_t n, unsigned bits_per_key, uint32_t flags);
+NLC_PUBLIC __attribute__((warn_unused_result))
+		struct bloom	*bloom_open(const char *path);
+NLC_PUBLIC int		bloom_save(const struct bloom *bf, const char *path);
+NLC_PUBLIC void		bloom_free(struct bloom *bf);
+
+NLC_PUBLIC int		bloom_add(struct bloom *bf, const void *key, size_t key_len);
+NLC_PUBLIC int		bloom_has(const struct bloom *bf, const void *key, size_t key_len);
+NLC_PUBLIC int		bloom_del(struct bloom *bf, const void *key, size_t key_len);
+
+NLC_PUBLIC int		bloom_add_batch(struct bloom *bf, const void *const *keys,
+					const size_t *key_lens, size_t cnt);
+NLC_PUBLIC size_t	bloom_has_batch(const struct bloom *bf, const void *const *keys,
+					const size_t *key_lens, size_t cnt, uint8_t *found);
+
+
+#endif /* bloom_h_ */
@@ -0,0 +1,90 @@
+#ifndef cdc_h_
+#define cdc_h_
+
+/*	cdc.h		content-defined chunking
+ *
+ * Split data into chunks whose boundaries depend on content, not offset:
+ * an insertion or deletion only changes the chunks around it,
+ * so identical regions of two versions of a file give identical chunks
+ * (and digests) for deduplication.
+ *
+ * Boundaries are found with a Gear rolling hash (as FastCDC):
+ *	h = (h << 1) + g(byte)
+ * over 32-bit 'h', i.e. a window of the last 32 bytes. A boundary follows
+ * the first byte where the top bits of 'h' are all 0:
+ * - never before 'min' bytes into a chunk, always at 'max' bytes
+ * - "normalized chunking": a stricter mask (more bits) before 'avg' bytes,
+ *   a looser one after, so that chunk sizes cluster around 'avg'
+ *
+ * Because 'h' only depends on the last 32 bytes, it is computed for a vector
+ * of positions at once (prefix doubling, no serial dependency): with AVX2 or
+ * AVX-512, picked at runtime, the scan runs several times faster than a
+ * byte-at-a-time loop. The scalar and vector scans give identical boundaries;
+ * cdc_isa() caps the scan used, as hx_isa() does for binhex.
+ *
+ * Each chunk gets a 64-bit digest: fnv_fast64() by default (fast enough not to
+ * slow the scan down), or plain fnv_hash64() with CDC_FNV1A.
+ *
+ * (c) 2018 Sirio Balmelli
+ */
+
+#include <nonlibc.h>
+#include <nmem.h>
+#include <binhex.h> /* HX_SCALAR ... */
+#include <stddef.h> /* size_t */
+#include <stdint.h>
+
+
+/* normalization: mask bits added before 'avg' and removed after it */
+#ifndef CDC_NORMAL
+	#define CDC_NORMAL 2
+#endif
+
+/* smallest 'min' allowed: the scan starts a few windows before 'min' */
+#define CDC_MIN		64
+
+/* flags */
+#define CDC_FNV1A	0x1	/* digest with fnv_hash64() instead of fnv_fast64() */
+
+
+/*	cdc
+ * Chunking parameters: set up by cdc_init(), read-only afterwards.
+ */
+struct cdc {
+	size_t		min;
+	size_t		avg;
+	size_t		max;
+	uint32_t	mask_s;		/* before 'avg' */
+	uint32_t	mask_l;		/* from 'avg' on */
+	uint32_t	flags;
+};
+
+/*	cdc_chunk
+ */
+struct cdc_chunk {
+	size_t		offset;
+	size_t		len;
+	uint64_t	digest;
+};
+
+/*	cdc_emit_t
+ * Called by cdc_nmem() for each chunk; return nonzero to stop.
+ */
+typedef int (*cdc_emit_t)(const struct cdc_chunk *chunk, void *ctx);
+
+
+NLC_PUBLIC int		cdc_init(struct cdc *cdc, size_t min, size_t avg, size_t max,
+				uint32_t flags);
+
+NLC_PUBLIC size_t	cdc_next(const struct cdc *cdc, const void *data, size_t len);
+NLC_PUBLIC size_t	cdc_next_scalar(const struct cdc *cdc, const void *data, size_t len);
+NLC_PUBLIC unsigned	cdc_isa(unsigned max);
+
+NLC_PUBLIC size_t	cdc_chunks(const struct cdc *cdc, const void *data, size_t len,
+				struct cdc_chunk *out, size_t out_max);
+
+NLC_PUBLIC int		cdc_nmem(const struct cdc *cdc, const struct nmem *nm,
+				cdc_emit_t emit, void *ctx);
+
+
+#endif /* cdc_h_ */
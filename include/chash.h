@@ -0,0 +1,81 @@
+#ifndef chash_h_
+#define chash_h_
+
+/*	chash.h		consistent hashing
+ *
+ * Map keys to nodes (e.g. cache shards) so that a change in membership
+ * moves only the keys which must move.
+ * Keys are given as their fnv_hash64(); nodes are hashed from their ID the same way.
+ *
+ * - chash_jump(): jump consistent hash (Lamping & Veach); no state at all,
+ *   but nodes are numbered 0..n-1 and may only be added/removed at the end
+ * - chash_hrw(): weighted rendezvous (highest random weight) hashing:
+ *   every node scores the key, the best score wins. Any node may be added,
+ *   removed or reweighted. Cost is linear in the number of nodes: scores are
+ *   computed a vector of nodes at a time from flat (SoA) arrays
+ * - chash_route(): O(1) lookup in a table of 2^bits slots, each assigned
+ *   (by chash_table()) to the rendezvous winner for that slot;
+ *   rebuild the table after any membership change
+ *
+ * Scores are computed with IEEE float operations only (no fast-math, no FMA
+ * contraction), so that all builds on all platforms map keys identically.
+ *
+ * Thread-safety: concurrent lookups only.
+ *
+ * (c) 2018 Sirio Balmelli
+ */
+
+#include <nonlibc.h>
+#include <stddef.h> /* size_t */
+#include <stdint.h>
+#include <sys/types.h> /* ssize_t */
+
+
+/* max table size: 2^CHASH_BITS_MAX slots */
+#define CHASH_BITS_MAX	24
+
+
+/*	chash
+ * Nodes are referred to by index, in order of chash_add().
+ * Removing a node (weight 0) keeps every index valid.
+ */
+struct chash {
+	size_t		cnt;		/* nodes */
+	size_t		cap;		/* array lengths, a multiple of the vector width */
+	uint32_t	*seed;		/* per node: hash of its ID */
+	float		*weight;	/* per node: 0 if removed (and in padding) */
+	float		*inv_weight;	/* 1 / weight: +inf if removed */
+
+	uint32_t	*table;		/* chash_table(): node per slot */
+	unsigned	bits;		/* 2^bits slots */
+};
+
+
+NLC_PUBLIC int32_t	chash_jump(uint64_t key_hash, int32_t buckets);
+
+NLC_PUBLIC __attribute__((warn_unused_result))
+		struct chash	*chash_new(void);
+NLC_PUBLIC void		chash_free(struct chash *ch);
+
+NLC_PUBLIC ssize_t	chash_add(struct chash *ch, const void *id, size_t id_len, float weight);
+NLC_PUBLIC int		chash_weight(struct chash *ch, size_t node, float weight);
+
+NLC_PUBLIC ssize_t	chash_hrw(const struct chash *ch, uint64_t key_hash);
+
+NLC_PUBLIC int		chash_table(struct chash *ch, unsigned bits);
+
+
+/*	chash_route()
+ * The node for 'key_hash' according to the table built by chash_table()
+ * (which must have found at least one node).
+ * NOTE: this is rendezvous hashing at the granularity of table slots:
+ * not necessarily the same node as chash_hrw() gives for the same key.
+ */
+NLC_INLINE uint32_t	chash_route(const struct chash *ch, uint64_t key_hash)
+{
+	/* FNV's high bits are its best mixed */
+	return ch->table[key_hash >> (64 - ch->bits)];
+}
+
+
+#endif /* chash_h_ */
@@ -0,0 +1,69 @@
+#ifndef clifo_h_
+#define clifo_h_
+
+/*	clifo.h		Concurrent LIFO (stack)
+
+The thread-safe sibling of lifo.h: any number of threads may push and pop
+	"ID"s (integers, pointers) concurrently, without locks.
+
+This is a Treiber stack over nodes addressed by 32-bit index:
+-	the stack top is a 64-bit word {tag, index}, swapped with CAS;
+	the tag changes at every swap, so a top popped and pushed back
+	in the meantime (ABA) fails the CAS instead of corrupting the stack.
+-	nodes are never freed while the stack lives: popped nodes go on a
+	second (free) stack of the same kind, to be reused by the next push.
+	Reading a node which another thread has just popped is therefore safe;
+	its CAS simply fails.
+-	nodes live in segments, each twice the size of the one before.
+	Growing adds a segment: nothing moves, nobody waits.
+
+The tag is 32 bits: a thread would have to stall for 2^32 operations on
+	the same stack between reading the top and its CAS to see ABA.
+
+(c) 2018 Sirio Balmelli - https://b-ad.ch
+*/
+
+#include <lifo.h> /* LIFO_MEM_TYPE */
+#include <stdint.h>
+
+
+/*	Nodes in the first segment; then doubling.
+*/
+#ifndef CLIFO_SEG_BASE
+	#define CLIFO_SEG_BASE 1024
+#endif
+/* enough segments to address 2^32 nodes with any CLIFO_SEG_BASE */
+#define CLIFO_SEGS 33
+
+
+/*	clifo_node
+*/
+struct clifo_node {
+	LIFO_MEM_TYPE	val;
+	uint32_t	next;	/* index +1 of the node below; 0 is none */
+};
+
+
+/*	clifo
+Top-of-stack words are on their own cache lines: they are what threads fight over.
+*/
+struct clifo {
+	uint64_t		top __attribute__((aligned(NLC_CACHE_LINE)));
+	uint64_t		free __attribute__((aligned(NLC_CACHE_LINE)));
+	uint64_t		alloc __attribute__((aligned(NLC_CACHE_LINE))); /* nodes handed out */
+	struct clifo_node	*seg[CLIFO_SEGS];
+};
+
+
+/*
+	public
+*/
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct clifo	*clifo_new();
+NLC_PUBLIC	void		clifo_free(struct clifo *cl);
+
+NLC_PUBLIC	int		clifo_push(struct clifo *cl, LIFO_MEM_TYPE push_this);
+NLC_PUBLIC	int		clifo_pop(struct clifo *cl, LIFO_MEM_TYPE *pop_here);
+
+
+#endif /* clifo_h_ */
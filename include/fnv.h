@@ -16,9 +16,210 @@
 #include <stdint.h>
 
 
+/* FNV1a parameters */
+#define FNV64_BASIS	14695981039346656037u
+#define FNV64_PRIME	1099511628211u
+#define FNV32_BASIS	2166136261u
+#define FNV32_PRIME	16777619u
+
+
 NLC_PUBLIC uint64_t	fnv_hash64(uint64_t *hash, const void *data, size_t data_len);
 NLC_PUBLIC uint32_t	fnv_hash32(uint32_t *hash, const void *data, size_t data_len);
 NLC_PUBLIC uint16_t	fnv_hash16(uint16_t *hash, const void *data, size_t data_len);
 
 
+/*	128-bit hashing
+ * Only where the compiler has a native 128-bit integer type.
+ * The prime is 2^88 + 2^8 + 0x3b.
+ */
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 fnv128_t;
+
+#define FNV128_BASIS_HI	0x6c62272e07bb0142u
+#define FNV128_BASIS_LO	0x62b821756295c58du
+#define FNV128_BASIS	((fnv128_t)FNV128_BASIS_HI << 64 | FNV128_BASIS_LO)
+#define FNV128_PRIME_LO	0x13bu /* low bits of the prime: all but 2^88 */
+#define FNV128_PRIME	((fnv128_t)1 << 88 | FNV128_PRIME_LO)
+
+NLC_PUBLIC fnv128_t	fnv_hash128(fnv128_t *hash, const void *data, size_t data_len);
+#endif
+
+
+/*	batch hashing
+ * Hash 'cnt' independent keys at once: 'data[i]' of 'data_len[i]' bytes
+ * is hashed (starting from basis) into 'hash[i]'.
+ * Results are identical to calling fnv_hash64()/fnv_hash32() on each key.
+ * Keys are hashed in interleaved lanes so that multiply latency overlaps.
+ */
+#define FNV_BATCH_LANES 8
+
+NLC_PUBLIC void		fnv_hash64_batch(uint64_t *hash, const void *const *data,
+					const size_t *data_len, size_t cnt);
+NLC_PUBLIC void		fnv_hash32_batch(uint32_t *hash, const void *const *data,
+					const size_t *data_len, size_t cnt);
+
+
+/*	tree hashing
+ * A 64-bit FNV1a tree hash, so that large inputs can be hashed in parallel:
+ * - input is split into leaves of 'leaf_len' bytes; the last leaf may be short
+ *   (an empty input is a single, empty leaf)
+ * - each leaf is hashed with fnv_hash64() starting from basis
+ * - the root is fnv_hash64() starting from basis, over all leaf digests in order,
+ *   each digest taken as 8 little-endian bytes
+ *
+ * The result depends only on the input and 'leaf_len';
+ * never on which leaves are hashed by whom or in which order.
+ * Note that it is NOT the same value as fnv_hash64() over the whole input.
+ */
+#define FNV_TREE_LEAF (1UL << 20) /* default leaf length; as used by 'fnvsum --tree' */
+
+NLC_PUBLIC size_t	fnv_tree_leaves(size_t data_len, size_t leaf_len);
+NLC_PUBLIC void		fnv_tree_leaf64(const void *data, size_t data_len, size_t leaf_len,
+					size_t first, size_t cnt, uint64_t *digests);
+NLC_PUBLIC uint64_t	fnv_tree_root64(uint64_t *root, const uint64_t *digests, size_t cnt);
+NLC_PUBLIC uint64_t	fnv_tree_hash64(const void *data, size_t data_len, size_t leaf_len);
+
+
+/*	fast hashing
+ * A word-at-a-time 64-bit FNV variant for checksumming bulk data:
+ * NOT the same value as fnv_hash64(), but several times faster on large inputs.
+ *
+ * - input is consumed in stripes of FNV_FAST_STRIPE bytes,
+ *   each stripe being FNV_FAST_LANES 64-bit little-endian words
+ * - word 'i' of each stripe goes to lane 'i', which starts at (FNV64_BASIS ^ i):
+ *	lane = rotl64((lane ^ word) * FNV64_PRIME, FNV_FAST_ROT)
+ *   (the rotate feeds high bits, which a multiply never propagates downwards,
+ *   back into the low bits of the next multiply)
+ * - the result is fnv_hash64(), starting from basis, over:
+ *   all lanes in order (each as 8 little-endian bytes),
+ *   then the trailing bytes of a partial stripe (if any),
+ *   then the total input length (as 8 little-endian bytes)
+ *
+ * Lanes are independent multiply chains, so throughput is limited by
+ * multiplier throughput (or memory bandwidth) instead of multiply latency.
+ */
+#define FNV_FAST_LANES	8
+#define FNV_FAST_STRIPE	(FNV_FAST_LANES * sizeof(uint64_t))
+#define FNV_FAST_ROT	29
+
+/*	struct fnv_fast64_state
+ * Streaming state: may be fed input in pieces of any size;
+ * the result is identical to fnv_fast64() over the concatenated input.
+ */
+struct fnv_fast64_state {
+	uint64_t	lane[FNV_FAST_LANES];
+	uint8_t		buf[FNV_FAST_STRIPE];	/* partial stripe */
+	size_t		buf_len;
+	uint64_t	total;			/* bytes hashed so far */
+};
+
+NLC_PUBLIC void		fnv_fast64_init(struct fnv_fast64_state *state);
+NLC_PUBLIC void		fnv_fast64_update(struct fnv_fast64_state *state,
+					const void *data, size_t data_len);
+NLC_PUBLIC uint64_t	fnv_fast64_final(const struct fnv_fast64_state *state);
+NLC_PUBLIC uint64_t	fnv_fast64(const void *data, size_t data_len);
+
+
+/*	compile-time hashing
+ * FNV1a of literals, for e.g. switch()ing on hashed keys instead of strcmp() chains;
+ * results are identical to fnv_hash32()/fnv_hash64() over the same bytes
+ * (the terminating '\0' is NOT hashed).
+ *
+ * FNV32_STR("literal") / FNV64_STR("literal"):
+ *	a string literal of up to FNV_STR_MAX bytes (longer fails to compile).
+ *	Folds to a constant whenever optimizing (-O1 and up), so may be compared
+ *	against at no runtime cost; but it is NOT a C integer constant expression:
+ *	indexing a string literal never is.
+ *
+ * FNV32_CHARS('g', 'e', 't') / FNV64_CHARS(...):
+ *	1 to FNV_CHARS_MAX character constants.
+ *	An integer constant expression: usable in 'case' labels,
+ *	_Static_assert() and static initializers.
+ *	(the empty key hashes to FNV32_BASIS/FNV64_BASIS)
+ *
+ * Example:
+ *	switch (fnv_hash32(NULL, cmd, strlen(cmd))) {
+ *	case FNV32_CHARS('g', 'e', 't'):
+ *		...
+ *	}
+ */
+#define FNV_STR_MAX	64
+#define FNV_CHARS_MAX	32
+
+#define FNV32_STR(s) FNV_CT_STR(uint32_t, FNV32_BASIS, FNV32_PRIME, "" s)
+#define FNV64_STR(s) FNV_CT_STR(uint64_t, FNV64_BASIS, FNV64_PRIME, "" s)
+
+#define FNV32_CHARS(...) FNV_CT_CAT(FNV_CT_C, FNV_CT_NARG(__VA_ARGS__)) \
+		(uint32_t, FNV32_PRIME, FNV32_BASIS, __VA_ARGS__)
+#define FNV64_CHARS(...) FNV_CT_CAT(FNV_CT_C, FNV_CT_NARG(__VA_ARGS__)) \
+		(uint64_t, FNV64_PRIME, FNV64_BASIS, __VA_ARGS__)
+
+
+/* Implementation: not for direct use.
+ *
+ * FNV_CT_STR() hashes FNV_STR_MAX positions of 's' unconditionally;
+ * past the end of 's' the byte is its '\0' (a no-op XOR)
+ * and the multiplier is 1, so those steps leave the hash unchanged.
+ * The running hash appears exactly once in each step, so the expansion
+ * grows linearly with FNV_STR_MAX.
+ * The ("" s) concatenation above only compiles for a literal 's'.
+ */
+#define FNV_CT_STEP(T, P, s, i, h)						\
+	((T)((T)((T)(h) ^ (uint8_t)(s)[(i) < sizeof(s) ? (i) : sizeof(s) - 1])	\
+		* ((i) < sizeof(s) - 1 ? (T)(P) : (T)1)))
+#define FNV_CT_4(T, P, s, i, h)							\
+	FNV_CT_STEP(T, P, s, (i) + 3, FNV_CT_STEP(T, P, s, (i) + 2,		\
+	FNV_CT_STEP(T, P, s, (i) + 1, FNV_CT_STEP(T, P, s, (i), h))))
+#define FNV_CT_16(T, P, s, i, h)						\
+	FNV_CT_4(T, P, s, (i) + 12, FNV_CT_4(T, P, s, (i) + 8,			\
+	FNV_CT_4(T, P, s, (i) + 4, FNV_CT_4(T, P, s, (i), h))))
+#define FNV_CT_64(T, P, s, h)							\
+	FNV_CT_16(T, P, s, 48, FNV_CT_16(T, P, s, 32,				\
+	FNV_CT_16(T, P, s, 16, FNV_CT_16(T, P, s, 0, h))))
+#define FNV_CT_STR(T, BASIS, P, s)						\
+	((T)(FNV_CT_64(T, P, s, BASIS)						\
+		+ 0 * sizeof(char[sizeof(s) <= FNV_STR_MAX + 1 ? 1 : -1])))
+
+#define FNV_CT_CAT(a, b) FNV_CT_CAT_(a, b)
+#define FNV_CT_CAT_(a, b) a ## b
+
+#define FNV_CT_NARG(...) FNV_CT_NARG_(__VA_ARGS__, \
+	32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1)
+#define FNV_CT_NARG_(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,_17,_18,_19,_20,_21,_22,_23,_24,_25,_26,_27,_28,_29,_30,_31,_32, N, ...) N
+
+#define FNV_CT_CSTEP(T, P, h, c) ((T)((T)((T)(h) ^ (uint8_t)(c)) * (T)(P)))
+#define FNV_CT_C1(T, P, h, c) FNV_CT_CSTEP(T, P, h, c)
+#define FNV_CT_C2(T, P, h, c, ...) FNV_CT_C1(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C3(T, P, h, c, ...) FNV_CT_C2(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C4(T, P, h, c, ...) FNV_CT_C3(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C5(T, P, h, c, ...) FNV_CT_C4(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C6(T, P, h, c, ...) FNV_CT_C5(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C7(T, P, h, c, ...) FNV_CT_C6(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C8(T, P, h, c, ...) FNV_CT_C7(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C9(T, P, h, c, ...) FNV_CT_C8(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C10(T, P, h, c, ...) FNV_CT_C9(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C11(T, P, h, c, ...) FNV_CT_C10(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C12(T, P, h, c, ...) FNV_CT_C11(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C13(T, P, h, c, ...) FNV_CT_C12(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C14(T, P, h, c, ...) FNV_CT_C13(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C15(T, P, h, c, ...) FNV_CT_C14(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C16(T, P, h, c, ...) FNV_CT_C15(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C17(T, P, h, c, ...) FNV_CT_C16(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C18(T, P, h, c, ...) FNV_CT_C17(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C19(T, P, h, c, ...) FNV_CT_C18(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C20(T, P, h, c, ...) FNV_CT_C19(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C21(T, P, h, c, ...) FNV_CT_C20(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C22(T, P, h, c, ...) FNV_CT_C21(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C23(T, P, h, c, ...) FNV_CT_C22(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C24(T, P, h, c, ...) FNV_CT_C23(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C25(T, P, h, c, ...) FNV_CT_C24(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C26(T, P, h, c, ...) FNV_CT_C25(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C27(T, P, h, c, ...) FNV_CT_C26(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C28(T, P, h, c, ...) FNV_CT_C27(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C29(T, P, h, c, ...) FNV_CT_C28(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C30(T, P, h, c, ...) FNV_CT_C29(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C31(T, P, h, c, ...) FNV_CT_C30(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+#define FNV_CT_C32(T, P, h, c, ...) FNV_CT_C31(T, P, FNV_CT_CSTEP(T, P, h, c), __VA_ARGS__)
+
+
 #endif /* fnv_h_ */
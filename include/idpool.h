@@ -0,0 +1,132 @@
+#ifndef idpool_h_
+#define idpool_h_
+
+/*	idpool.h	ID allocator: lifo free-list over a hierarchical bitmap
+
+Hands out 32-bit IDs in [0, max), e.g. connection or slot numbers;
+	and knows which are allocated.
+
+The bitmap (one bit per ID, set if allocated) is the truth:
+-	'used': the bits themselves.
+-	'nonfull': a bit per 'used' word, set if it has a free ID;
+	and 'nonfull2', a bit per 'nonfull' word, set if it has any set:
+	the lowest free ID is 3 count-trailing-zeros away (and a short
+	scan of 'nonfull2', from a hint).
+-	'nonempty': a bit per 'used' word, set if it has an allocated ID:
+	iteration skips 64 free IDs per clear bit, 4096 per zero word.
+
+The free-list is a stack of released IDs (narrow: see LIFO_DECLARE()),
+	so idpool_alloc() returns the most recently released ID: likely still
+	in cache, wherever it is used.
+When the stack is empty, idpool_alloc() takes the lowest free ID instead.
+The stack holds up to IDPOOL_LIST_MAX IDs: IDs released beyond that are
+	only marked free in the bitmap, and found there.
+
+Releasing an ID twice (or one never allocated) is detected, and fails.
+
+Memory: max/8 Bytes of bitmap, plus 1/32 of that in summaries,
+	plus at most IDPOOL_LIST_MAX * 4 Bytes of free-list;
+	i.e. ~13MB for 100M IDs.
+The bitmap is calloc()ed: pages never touched cost nothing.
+
+Thread-safety: NONE
+
+(c) 2018 Sirio Balmelli - https://b-ad.ch
+*/
+
+#include <nonlibc.h>
+#include <ndebug.h>
+#include <lifo.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*	Free IDs kept on the stack, at most.
+*/
+#ifndef IDPOOL_LIST_MAX
+	#define IDPOOL_LIST_MAX (1 << 20)
+#endif
+
+/*	Returned by idpool_next() when there are no more allocated IDs.
+*/
+#define IDPOOL_NONE ((size_t)-1)
+
+
+LIFO_DECLARE(idpool_list, uint32_t)
+
+
+/*	idpool
+*/
+struct idpool {
+	size_t			max;		/* IDs are [0, max) */
+	size_t			count;		/* allocated */
+	size_t			words;		/* in 'used' */
+	size_t			hint2;		/* no free ID before this 'nonfull2' word */
+	struct idpool_list	*list;
+	uint64_t		*used;
+	uint64_t		*nonempty;
+	uint64_t		*nonfull;
+	uint64_t		*nonfull2;
+};
+
+
+/*
+	public
+*/
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct idpool	*idpool_new(size_t max);
+NLC_PUBLIC	void		idpool_free(struct idpool *ip);
+
+NLC_PUBLIC	int		idpool_alloc_low(struct idpool *ip, uint32_t *id);
+NLC_PUBLIC	int		idpool_release(struct idpool *ip, uint32_t id);
+NLC_PUBLIC	size_t		idpool_next(const struct idpool *ip, size_t from);
+
+
+/*	idpool_is_alloc()
+*/
+NLC_INLINE	bool		idpool_is_alloc(const struct idpool *ip, uint32_t id)
+{
+	return id < ip->max && (ip->used[id >> 6] >> (id & 63)) & 0x1;
+}
+
+/*	idpool_mark()
+Set free 'id' as allocated, in the bitmap and its summaries.
+*/
+NLC_INLINE	void		idpool_mark(struct idpool *ip, uint32_t id)
+{
+	size_t w = id >> 6;
+	uint64_t old = ip->used[w];
+	ip->used[w] = old | 1ULL << (id & 63);
+	if (!old)
+		ip->nonempty[w >> 6] |= 1ULL << (w & 63);
+	if (ip->used[w] == UINT64_MAX) {
+		ip->nonfull[w >> 6] &= ~(1ULL << (w & 63));
+		if (!ip->nonfull[w >> 6])
+			ip->nonfull2[w >> 12] &= ~(1ULL << ((w >> 6) & 63));
+	}
+	ip->count++;
+}
+
+/*	idpool_alloc()
+Most recently released ID, else the lowest free one.
+Returns 0 on success; nonzero if all IDs are allocated.
+*/
+NLC_INLINE	int		idpool_alloc(struct idpool *ip, uint32_t *id)
+{
+	if (idpool_list_pop(ip->list, id) == LIFO_ERR)
+		return idpool_alloc_low(ip, id);
+	idpool_mark(ip, *id);
+	return 0;
+}
+
+/*	IDPOOL_FOREACH()
+Iterate 'id' (a size_t) over allocated IDs, in ascending order.
+'ip' may not be changed while iterating, except to release 'id' itself.
+*/
+#define IDPOOL_FOREACH(ip, id)							\
+	for (size_t id = idpool_next(ip, 0);					\
+		id != IDPOOL_NONE;						\
+		id = idpool_next(ip, id + 1))
+
+
+#endif /* idpool_h_ */
@@ -7,18 +7,20 @@ The point is to very quickly push and pop "ID"s (integers, pointers) into a
 	fast, memory-efficient LIFO (Last-In-First-Out).
 
 This library calls malloc()/mmap() to alloc a LIFO,
-	and if necessary grows by calling realloc()/mremap().
-However, it NEVER shrinks the stack.
+	and if necessary grows by calling realloc()/mremap(),
+	or mprotect() for a stack from lifo_new_reserved() (see below).
+It never shrinks the stack on its own: see lifo_trim().
 
 If you need a FIFO (queue):
 -	Do you really NEED a queue?
 	Reworking your algo to use a stack (LIFO) will be faster.
 -	Can your queue have a maximum bound?
-	If so a circular buffer is your best bet. Check out 'memorywell'.
+	If so a circular buffer is your best bet: see ring.h.
 -	Otherwise you have a choice between hash tables (e.g. Judy)
 		or (gasp!) a linked list.
 
 Thread-safety: NONE
+	For a stack shared between threads, see clifo.h.
 
 (c) 2017, Sirio Balmelli - https://b-ad.ch
 */
@@ -26,25 +28,50 @@ Thread-safety: NONE
 
 
 /*	mmap
-On systems which support it, use mmap() and mremap() directly.
+On systems which support it, use mmap() directly:
+-	on Linux, grow by mremap().
+-	lifo_new_reserved() instead reserves address space (PROT_NONE) for the
+	largest the stack may get, and commits (mprotect()) LIFO_RESERVE_GROW
+	more of it each time the stack grows.
+	The stack never moves: pointers to it stay valid, other threads may
+	keep reading while it grows, and growth costs only the pages touched.
+	It cannot grow past its reservation.
 */
-#ifdef __linux__
+#if defined(__linux__) && !defined(_GNU_SOURCE)
 	#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <stddef.h>  /* size_t */
+#include <string.h>  /* memcpy() */
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
 	#include <unistd.h>
 	#include <sys/mman.h>
-	#ifdef MAP_UNINITIALIZED
-		#define LIFO_MMAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_UNINITIALIZED)
-	#else
-		#define LIFO_MMAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+	#include <stdlib.h>
+	#define LIFO_HAVE_RESERVE
+	#ifndef MAP_NORESERVE
+		#define MAP_NORESERVE 0
+	#endif
+	#ifdef __linux__
+		#ifdef MAP_UNINITIALIZED
+			#define LIFO_MMAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_UNINITIALIZED)
+		#else
+			#define LIFO_MMAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+		#endif
 	#endif
 #else
 	#include <stdlib.h>
 #endif
 
+/*	madvise() advice for memory returned by lifo_trim().
+MADV_FREE is cheaper, but the kernel only takes the pages back (and RSS only
+	drops) under memory pressure.
+*/
+#if defined(MADV_DONTNEED) && !defined(LIFO_MADVISE)
+	#define LIFO_MADVISE MADV_DONTNEED
+#endif
 
 
-#include <stdint.h>
-#include <stddef.h>  /* size_t */
 
 #include <nonlibc.h>
 #include <ndebug.h>
@@ -74,13 +101,31 @@ Otherwise, assume it should be able to hold a pointer or equivalent-sized uint.
 	#endif
 #endif
 
+/*	How much of its reservation a stack from lifo_new_reserved() commits
+each time it grows: whole pages.
+*/
+#ifndef LIFO_RESERVE_GROW
+	#define LIFO_RESERVE_GROW (4096 * 2048)
+#endif
+
+
+
+/*	lifo_trim() returns memory once the stack is below 1/LIFO_TRIM_RATIO
+of its high-water mark (and keeps twice what is in use):
+a stack hovering around some size is never trimmed and regrown over and over.
+*/
+#ifndef LIFO_TRIM_RATIO
+	#define LIFO_TRIM_RATIO 4
+#endif
+
 
 
 /*	lifo
 */
 struct lifo {
 	size_t		next;		/* aka: 'cnt' ... it's an index */
-	size_t		mem_len;	/* in Bytes */
+	size_t		mem_len;	/* in Bytes: high-water mark since lifo_trim() */
+	size_t		mem_max;	/* reserved, in Bytes; 0 unless lifo_new_reserved() */
 	LIFO_MEM_TYPE	mem[];
 };
 
@@ -91,21 +136,34 @@ struct lifo {
 */
 NLC_PUBLIC	__attribute__((warn_unused_result))
 		struct lifo	*lifo_new();
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct lifo	*lifo_new_reserved(size_t max);
 NLC_PUBLIC	void		lifo_free(struct lifo *stk);
 NLC_PUBLIC	__attribute__((warn_unused_result))
 		struct lifo	*lifo_extend(struct lifo *stk);
+NLC_PUBLIC	int		lifo_reserve(struct lifo **stk, size_t cnt);
+NLC_PUBLIC	int		lifo_reserve_sz(struct lifo **stk, size_t cnt, size_t size);
+
+NLC_PUBLIC	size_t		lifo_trim(struct lifo **stk);
+NLC_PUBLIC	size_t		lifo_trim_sz(struct lifo **stk, size_t size);
+NLC_PUBLIC	size_t		lifo_rss(const struct lifo *stk);
 
 
 
 /*	lifo_push()
+Returns index pushed, or LIFO_ERR if the stack cannot grow
+	(e.g. a reserved stack is full): '*stk' is then left as it was.
 */
 NLC_INLINE	size_t		lifo_push(struct lifo **stk, LIFO_MEM_TYPE push_this)
 {
 	struct lifo *sk = *stk;
 
 	/* most of the time we do NOT need to extend the stack */
-	if (__builtin_expect( !(sk->mem_len - (sk->next * sizeof(LIFO_MEM_TYPE))), 0))
-		*stk = sk = lifo_extend(sk);
+	if (__builtin_expect( !(sk->mem_len - (sk->next * sizeof(LIFO_MEM_TYPE))), 0)) {
+		if (!(sk = lifo_extend(sk)))
+			return LIFO_ERR;
+		*stk = sk;
+	}
 
 	sk->mem[sk->next] = push_this;
 	return sk->next++;
@@ -122,6 +180,137 @@ NLC_INLINE	size_t		lifo_pop(struct lifo *stk, LIFO_MEM_TYPE *pop_here)
 	return LIFO_ERR;
 }
 
+/*	lifo_push_n()
+Push 'cnt' IDs from 'src', in order ('src[cnt-1]' ends up on top).
+Returns index of the first one pushed, or LIFO_ERR if the stack cannot grow.
+*/
+NLC_INLINE	size_t		lifo_push_n(struct lifo **stk, const LIFO_MEM_TYPE *src, size_t cnt)
+{
+	if (__builtin_expect(
+		(*stk)->mem_len / sizeof(LIFO_MEM_TYPE) - (*stk)->next < cnt, 0)
+		&& lifo_reserve(stk, cnt))
+	{
+		return LIFO_ERR;
+	}
+
+	struct lifo *sk = *stk;
+	size_t ret = sk->next;
+	memcpy(&sk->mem[ret], src, cnt * sizeof(LIFO_MEM_TYPE));
+	sk->next += cnt;
+	return ret;
+}
+
+/*	lifo_pop_n()
+Pop up to 'cnt' IDs into 'dst', in the order they were pushed
+	(the top of the stack ends up last): lifo_push_n() puts them back as they were.
+Returns number of IDs popped (0 if stack is empty).
+*/
+NLC_INLINE	size_t		lifo_pop_n(struct lifo *stk, LIFO_MEM_TYPE *dst, size_t cnt)
+{
+	if (cnt > stk->next)
+		cnt = stk->next;
+	stk->next -= cnt;
+	memcpy(dst, &stk->mem[stk->next], cnt * sizeof(LIFO_MEM_TYPE));
+	return cnt;
+}
+
+
+
+
+/*	LIFO_DECLARE()
+Declare a stack of 'type' named 'name', alongside any others:
+	'struct name' and inline name_new(), name_new_reserved(), name_free(),
+	name_push(), name_pop(), name_push_n(), name_pop_n(), name_reserve(),
+	name_trim() and name_rss(), which work as their lifo_ equivalents above.
+Use the narrowest type that fits: e.g. after LIFO_DECLARE(id32, uint32_t),
+	a 'struct id32' holds twice the IDs a 'struct lifo' does (on 64-bit)
+	in the same memory and cache.
+
+Memory is managed by the lifo_ functions (one library for all stacks):
+	'struct name' has the layout of 'struct lifo' up to 'mem',
+	so 'type' may not be aligned wider than size_t.
+*/
+#define LIFO_DECLARE(name, type)						\
+struct name {									\
+	size_t		next;							\
+	size_t		mem_len;						\
+	size_t		mem_max;						\
+	type		mem[];							\
+};										\
+NLC_ASSERT(name##_lifo_layout_,							\
+	offsetof(struct name, mem) == offsetof(struct lifo, mem));		\
+										\
+__attribute__((warn_unused_result))						\
+NLC_INLINE	struct name	*name##_new()					\
+{										\
+	return (struct name *)lifo_new();					\
+}										\
+__attribute__((warn_unused_result))						\
+NLC_INLINE	struct name	*name##_new_reserved(size_t max)		\
+{										\
+	return (struct name *)lifo_new_reserved(max);				\
+}										\
+NLC_INLINE	void		name##_free(struct name *stk)			\
+{										\
+	lifo_free((struct lifo *)stk);						\
+}										\
+NLC_INLINE	int		name##_reserve(struct name **stk, size_t cnt)	\
+{										\
+	return lifo_reserve_sz((struct lifo **)stk, cnt, sizeof(type));	\
+}										\
+NLC_INLINE	size_t		name##_trim(struct name **stk)			\
+{										\
+	return lifo_trim_sz((struct lifo **)stk, sizeof(type));			\
+}										\
+NLC_INLINE	size_t		name##_rss(const struct name *stk)		\
+{										\
+	return lifo_rss((const struct lifo *)stk);				\
+}										\
+										\
+NLC_INLINE	size_t		name##_push(struct name **stk, type push_this)	\
+{										\
+	struct name *sk = *stk;							\
+	/* 'mem_len' need not be a multiple of sizeof(type) */			\
+	if (__builtin_expect((sk->next + 1) * sizeof(type) > sk->mem_len, 0)) {	\
+		if (name##_reserve(stk, 1))					\
+			return LIFO_ERR;					\
+		sk = *stk;							\
+	}									\
+	sk->mem[sk->next] = push_this;						\
+	return sk->next++;							\
+}										\
+NLC_INLINE	size_t		name##_pop(struct name *stk, type *pop_here)	\
+{										\
+	if (stk->next) {							\
+		*pop_here = stk->mem[--(stk->next)];				\
+		return stk->next;						\
+	}									\
+	return LIFO_ERR;							\
+}										\
+NLC_INLINE	size_t		name##_push_n(struct name **stk,		\
+					const type *src, size_t cnt)		\
+{										\
+	if (__builtin_expect(							\
+		(*stk)->mem_len / sizeof(type) - (*stk)->next < cnt, 0)		\
+		&& name##_reserve(stk, cnt))					\
+	{									\
+		return LIFO_ERR;						\
+	}									\
+	struct name *sk = *stk;							\
+	size_t ret = sk->next;							\
+	memcpy(&sk->mem[ret], src, cnt * sizeof(type));				\
+	sk->next += cnt;							\
+	return ret;								\
+}										\
+NLC_INLINE	size_t		name##_pop_n(struct name *stk, type *dst, size_t cnt) \
+{										\
+	if (cnt > stk->next)							\
+		cnt = stk->next;						\
+	stk->next -= cnt;							\
+	memcpy(dst, &stk->mem[stk->next], cnt * sizeof(type));			\
+	return cnt;								\
+}
+
 
 
 #endif /* lifo_h_ */
@@ -0,0 +1,97 @@
+#ifndef mag_h_
+#define mag_h_
+
+/*	mag.h		Per-thread magazine caches in front of a shared depot
+
+A pool of "ID"s (integers, pointers) shared between threads, where the
+	common case of push and pop touches only memory private to the thread
+	(after Bonwick's magazine allocator).
+
+Each thread keeps a 'struct mag_cache' of two magazines:
+	small fixed-size 'struct lifo's of up to MAG_SIZE IDs.
+Push and pop work on the 'loaded' magazine; when it is full (empty),
+	it is swapped with the 'prev' one; only when both are,
+	a whole magazine is exchanged with the depot:
+	a full one for an empty one (or the reverse).
+The depot is a pair of clifo (lock-free) stacks of magazines.
+
+Memory is bounded:
+-	a thread holds at most 2 magazines; mag_cache_flush() gives them
+	back to the depot (e.g. when going idle, or exiting).
+-	the depot keeps at most 'empty_max' empty magazines, frees the rest.
+
+Note that IDs cached by one thread are not visible to others:
+	mag_pop() may fail while other threads' caches hold IDs.
+
+Thread-safety: a mag_cache belongs to one thread; the depot is shared.
+
+(c) 2018 Sirio Balmelli - https://b-ad.ch
+*/
+
+#include <clifo.h>
+#include <lifo.h>
+
+
+/*	IDs per magazine.
+*/
+#ifndef MAG_SIZE
+	#define MAG_SIZE 256
+#endif
+
+
+/*	mag_depot
+*/
+struct mag_depot {
+	struct clifo	*full;		/* magazines holding IDs (maybe not full) */
+	struct clifo	*empty;
+	size_t		empty_cnt;
+	size_t		empty_max;
+};
+
+/*	mag_cache
+*/
+struct mag_cache {
+	struct mag_depot	*depot;
+	struct lifo		*loaded;
+	struct lifo		*prev;
+};
+
+
+/*
+	public
+*/
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct mag_depot	*mag_depot_new(size_t empty_max);
+NLC_PUBLIC	void			mag_depot_free(struct mag_depot *dp);
+
+NLC_PUBLIC	void			mag_cache_init(struct mag_cache *mc, struct mag_depot *dp);
+NLC_PUBLIC	int			mag_cache_flush(struct mag_cache *mc);
+
+NLC_PUBLIC	int			mag_push_slow(struct mag_cache *mc, LIFO_MEM_TYPE push_this);
+NLC_PUBLIC	int			mag_pop_slow(struct mag_cache *mc, LIFO_MEM_TYPE *pop_here);
+
+
+/*	mag_push()
+Returns 0 on success; nonzero if out of memory.
+*/
+NLC_INLINE	int			mag_push(struct mag_cache *mc, LIFO_MEM_TYPE push_this)
+{
+	/* a magazine is never extended: check before lifo_push() */
+	if (NLC_UNLIKELY(!mc->loaded || mc->loaded->next == MAG_SIZE))
+		return mag_push_slow(mc, push_this);
+	lifo_push(&mc->loaded, push_this);
+	return 0;
+}
+
+/*	mag_pop()
+Returns 0 on success; nonzero if no IDs are available (to this thread).
+*/
+NLC_INLINE	int			mag_pop(struct mag_cache *mc, LIFO_MEM_TYPE *pop_here)
+{
+	if (NLC_UNLIKELY(!mc->loaded || lifo_pop(mc->loaded, pop_here) == LIFO_ERR))
+		return mag_pop_slow(mc, pop_here);
+	return 0;
+}
+
+
+#endif /* mag_h_ */
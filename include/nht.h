@@ -0,0 +1,89 @@
+#ifndef nht_h_
+#define nht_h_
+
+/*	nht.h		the Nonlibc Hash Table
+ *
+ * An open-addressing hash table mapping byte-string keys to integer/pointer values,
+ * in the style of "SwissTable":
+ * - slots are arranged in groups of NHT_GROUP; each slot has a control byte
+ *   holding 7 bits of its key's hash, so a whole group is probed with a couple
+ *   of (SSE2) vector compares before touching any key
+ * - keys of up to NHT_INLINE bytes are copied into the slot;
+ *   longer keys are referenced by pointer and MUST outlive their entry
+ * - no allocation per entry: one block of memory per table
+ * - resizing is incremental: the old table is moved into the new one a few groups
+ *   at a time by subsequent inserts/deletes, so no single insert pays for
+ *   rehashing the whole table
+ *
+ * Hashing defaults to fnv_hash64(); any nht_hash_t may be given instead.
+ *
+ * Thread-safety: NONE
+ *
+ * (c) 2018 Sirio Balmelli
+ */
+
+#include <nonlibc.h>
+#include <stddef.h> /* size_t */
+#include <stdint.h>
+
+
+/* slots per group: one SSE2 vector of control bytes */
+#define NHT_GROUP	16
+/* keys of up to this many bytes are stored inline */
+#define NHT_INLINE	16
+/* tables of more groups than this are refused: see nht_hash_t */
+#define NHT_GROUPS_MAX	(1UL << 25)
+
+/* groups of the old table migrated by each insert/delete, while resizing */
+#ifndef NHT_MIGRATE
+	#define NHT_MIGRATE 2
+#endif
+
+/* (linux) advise huge pages for tables: fewer TLB misses on lookup in large tables,
+ * but a longer stall on first touching each (2MiB) page: off by default
+ */
+#ifndef NHT_HUGEPAGE
+	#define NHT_HUGEPAGE 0
+#endif
+
+
+/*	nht_val_t
+ * Values are either a pointer or an equivalent-sized integer;
+ * functions taking a value accept either without a cast.
+ */
+typedef union {
+	void		*pointer;
+	uintptr_t	integer;
+} nht_val_t __attribute__((transparent_union));
+
+NLC_ASSERT(nht_val_check, sizeof(void *) == sizeof(uintptr_t));
+
+
+/*	nht_hash_t
+ * Hash 'key_len' bytes at 'key'.
+ * Only the high 32 bits are used (25 to pick a group, 7 for the control byte):
+ * they must be well mixed. This is the case for FNV1a (multiply carries upwards).
+ */
+typedef uint64_t (*nht_hash_t)(const void *key, size_t key_len);
+
+
+struct nht; /* opaque */
+
+
+NLC_PUBLIC uint64_t	nht_fnv64(const void *key, size_t key_len);
+
+NLC_PUBLIC __attribute__((warn_unused_result))
+		struct nht	*nht_new(size_t hint, nht_hash_t hash);
+NLC_PUBLIC void		nht_free(struct nht *nht);
+
+NLC_PUBLIC size_t	nht_count(const struct nht *nht);
+
+NLC_PUBLIC int		nht_get(const struct nht *nht, const void *key, size_t key_len,
+				nht_val_t *val);
+NLC_PUBLIC int		nht_set(struct nht *nht, const void *key, size_t key_len,
+				nht_val_t val);
+NLC_PUBLIC int		nht_del(struct nht *nht, const void *key, size_t key_len,
+				nht_val_t *val);
+
+
+#endif /* nht_h_ */
@@ -50,7 +50,10 @@ union {
 
 
 NLC_PUBLIC int		nmem_file(const char *path, struct nmem *out);
+NLC_PUBLIC int		nmem_file_rw(const char *path, struct nmem *out);
+NLC_PUBLIC int		nmem_resize(struct nmem *nm, size_t len);
 NLC_PUBLIC int		nmem_alloc(size_t len, const char *tmp_dir, struct nmem *out);
+NLC_PUBLIC int		nmem_deliver(struct nmem *nm, const char *deliver_path);
 NLC_PUBLIC void		nmem_free(struct nmem *nm, const char *deliver_path);
 
 NLC_PUBLIC ssize_t	nmem_in_splice(struct nmem	*nm,
@@ -0,0 +1,129 @@
+#ifndef plifo_h_
+#define plifo_h_
+
+/*	plifo.h		Persistent LIFO: a lifo living in a file
+
+For a stack which must survive a restart (e.g. a free-list of millions of IDs)
+	without being rebuilt by pushing every entry again:
+	the stack is mmap()ed from a file (see nmem.h), and mapping it back
+	on restart is O(1).
+
+File layout:
+-	a header (struct plifo_hdr), padded to PLIFO_HDR_LEN.
+-	a 'struct lifo' exactly as in memory: push and pop are lifo_push()
+	and lifo_pop() on the mapping, and cost the same.
+
+Crash consistency is by explicit sync points:
+-	plifo_sync() writes the stack back to disk, then records in the
+	header how many entries it had and a checksum (fnv_fast64()) of them.
+-	plifo_close() syncs and marks the file clean:
+	plifo_open() of a clean file checks only the header (O(1)).
+-	after a crash, plifo_open() checks the entries present at the last
+	sync against their checksum (O(n)), and rolls the stack back to them.
+	If any of them were popped and overwritten since, it fails:
+	the caller must rebuild the stack.
+
+The file is binary and native-endian; it must be opened by one process
+	at a time, built with the same LIFO_MEM_TYPE.
+
+Thread-safety: NONE
+
+(c) 2018 Sirio Balmelli - https://b-ad.ch
+*/
+
+#include <lifo.h>
+#include <nmem.h>
+#include <stdint.h>
+
+
+/*	Header space at the start of the file; the stack follows.
+*/
+#define PLIFO_HDR_LEN 4096
+
+#define PLIFO_MAGIC	0x6f66696c70636c6eULL	/* "nlcplifo" */
+#define PLIFO_VERSION	1
+
+#define PLIFO_CLEAN	0x1	/* closed with plifo_close() */
+#define PLIFO_OPEN	0x2	/* opened and not (yet) closed */
+
+
+/*	plifo_hdr
+*/
+struct plifo_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	mem_size;	/* sizeof(LIFO_MEM_TYPE) */
+	uint64_t	state;
+	uint64_t	sync_next;	/* entries at last sync */
+	uint64_t	sync_sum;	/* fnv_fast64() of those entries */
+	uint64_t	hdr_sum;	/* fnv_fast64() of the above: must be last */
+};
+NLC_ASSERT(plifo_hdr_fits, sizeof(struct plifo_hdr) <= PLIFO_HDR_LEN);
+
+
+/*	plifo
+*/
+struct plifo {
+	struct nmem		nm;
+	struct plifo_hdr	*hdr;
+	struct lifo		*stk;	/* in 'nm', after the header */
+};
+
+
+/*
+	public
+*/
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct plifo	*plifo_new(const char *path);
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct plifo	*plifo_open(const char *path);
+NLC_PUBLIC	int		plifo_sync(struct plifo *pl);
+NLC_PUBLIC	int		plifo_close(struct plifo *pl);
+
+NLC_PUBLIC	int		plifo_reserve(struct plifo *pl, size_t cnt);
+
+
+/*	plifo_push()
+The stack lives in the file: grow it with plifo_reserve(), never lifo_extend().
+Returns index pushed, or LIFO_ERR if the file cannot grow.
+*/
+NLC_INLINE	size_t		plifo_push(struct plifo *pl, LIFO_MEM_TYPE push_this)
+{
+	if (__builtin_expect(
+		pl->stk->mem_len - pl->stk->next * sizeof(LIFO_MEM_TYPE) < sizeof(LIFO_MEM_TYPE), 0)
+		&& plifo_reserve(pl, 1))
+	{
+		return LIFO_ERR;
+	}
+	return lifo_push(&pl->stk, push_this);
+}
+
+/*	plifo_pop()
+*/
+NLC_INLINE	size_t		plifo_pop(struct plifo *pl, LIFO_MEM_TYPE *pop_here)
+{
+	return lifo_pop(pl->stk, pop_here);
+}
+
+/*	plifo_push_n()
+*/
+NLC_INLINE	size_t		plifo_push_n(struct plifo *pl, const LIFO_MEM_TYPE *src, size_t cnt)
+{
+	if (__builtin_expect(
+		pl->stk->mem_len / sizeof(LIFO_MEM_TYPE) - pl->stk->next < cnt, 0)
+		&& plifo_reserve(pl, cnt))
+	{
+		return LIFO_ERR;
+	}
+	return lifo_push_n(&pl->stk, src, cnt);
+}
+
+/*	plifo_pop_n()
+*/
+NLC_INLINE	size_t		plifo_pop_n(struct plifo *pl, LIFO_MEM_TYPE *dst, size_t cnt)
+{
+	return lifo_pop_n(pl->stk, dst, cnt);
+}
+
+
+#endif /* plifo_h_ */
@@ -0,0 +1,130 @@
+#ifndef ring_h_
+#define ring_h_
+
+/*	ring.h		Bounded FIFO (circular buffer) between threads
+
+The queue lifo.h sends you looking for: a fixed power-of-2 number of slots,
+	holding "ID"s (integers, pointers), passed from producer thread(s)
+	to consumer thread(s) without locks.
+
+Each end of the ring ("prod", "cons") is a pair of 64-bit counters
+	on its own cache line:
+-	'head': slots claimed by this end (CAS if several threads share the end).
+-	'tail': slots this end is done with, published to the other end.
+A producer claims slots between its 'head' and the consumers' 'tail',
+	copies into them, then moves its 'tail' up: the consumers may now
+	read them (and the reverse).
+With several producers (consumers), each waits for the ones who claimed
+	before it to publish, so 'tail' only ever moves in order.
+Counters never wrap (2^64): slot is counter & mask.
+
+A single producer (consumer) needs no CAS at all, and caches the other end's
+	'tail' so as to only read that cache line when it seems full (empty).
+
+Batches (ring_enqueue_n(), ring_dequeue_n()) claim and publish once for
+	the whole batch: use them.
+
+Event loops: with RING_EVENTFD (Linux only), ring_fd() is an eventfd which
+	becomes readable when an enqueue finds the ring empty.
+	The consumer should ring_fd_clear() and then dequeue until the ring is
+	empty, before waiting on the fd again: no wakeup is then lost.
+
+(c) 2018 Sirio Balmelli - https://b-ad.ch
+*/
+
+#include <nonlibc.h>
+#include <ndebug.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*	Size of the 'tokens' being passed.
+Allow caller to define their own type.
+*/
+#ifndef RING_MEM_TYPE
+	#define RING_MEM_TYPE uintptr_t
+#endif
+
+/*	Spins waiting on another thread (which may have been preempted)
+before yielding the CPU.
+*/
+#ifndef RING_SPIN
+	#define RING_SPIN 128
+#endif
+
+
+/*	flags to ring_new()
+*/
+#define RING_MP		0x1	/* multiple producers */
+#define RING_MC		0x2	/* multiple consumers */
+#define RING_EVENTFD	0x4	/* see ring_fd() */
+
+#define RING_SPSC	0
+#define RING_MPSC	RING_MP
+#define RING_MPMC	(RING_MP | RING_MC)
+
+
+/*	ring_end
+*/
+struct ring_end {
+	uint64_t	head;
+	uint64_t	tail;
+	uint64_t	cache;		/* single thread: last 'tail' seen of the other end */
+};
+
+/*	ring
+*/
+struct ring {
+	struct ring_end	prod __attribute__((aligned(NLC_CACHE_LINE)));
+	struct ring_end	cons __attribute__((aligned(NLC_CACHE_LINE)));
+	uint64_t	size __attribute__((aligned(NLC_CACHE_LINE)));
+	uint64_t	mask;
+	unsigned	flags;
+	int		fd;		/* -1 unless RING_EVENTFD */
+	RING_MEM_TYPE	slots[] __attribute__((aligned(NLC_CACHE_LINE)));
+};
+
+
+/*
+	public
+*/
+NLC_PUBLIC	__attribute__((warn_unused_result))
+		struct ring	*ring_new(size_t size, unsigned flags);
+NLC_PUBLIC	void		ring_free(struct ring *rg);
+
+NLC_PUBLIC	size_t		ring_enqueue_n(struct ring *rg,
+					const RING_MEM_TYPE *src, size_t cnt);
+NLC_PUBLIC	size_t		ring_dequeue_n(struct ring *rg,
+					RING_MEM_TYPE *dst, size_t cnt);
+
+NLC_PUBLIC	int		ring_fd(const struct ring *rg);
+NLC_PUBLIC	void		ring_fd_clear(struct ring *rg);
+
+
+/*	ring_enqueue()
+Returns 0 on success; nonzero if the ring is full.
+*/
+NLC_INLINE	int		ring_enqueue(struct ring *rg, RING_MEM_TYPE val)
+{
+	return !ring_enqueue_n(rg, &val, 1);
+}
+
+/*	ring_dequeue()
+Returns 0 on success; nonzero if the ring is empty.
+*/
+NLC_INLINE	int		ring_dequeue(struct ring *rg, RING_MEM_TYPE *dst)
+{
+	return !ring_dequeue_n(rg, dst, 1);
+}
+
+/*	ring_count()
+IDs in the ring; only a hint while other threads are using it.
+*/
+NLC_INLINE	size_t		ring_count(const struct ring *rg)
+{
+	return __atomic_load_n(&rg->prod.tail, __ATOMIC_ACQUIRE)
+		- __atomic_load_n(&rg->cons.tail, __ATOMIC_ACQUIRE);
+}
+
+
+#endif /* ring_h_ */
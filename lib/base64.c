@@ -0,0 +1,723 @@
+#include <base64.h>
+#include <stdbool.h>
+#include <string.h> /* memcpy() */
+
+
+static const char b64_std[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char b64_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const char b32_abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+
+/* Character values (-1: not in the alphabet), as tables:
+ * on random input, comparing ranges mispredicts at almost every character.
+ */
+#define B_X16(f, i) f((i)+0), f((i)+1), f((i)+2), f((i)+3), f((i)+4), f((i)+5),	\
+	f((i)+6), f((i)+7), f((i)+8), f((i)+9), f((i)+10), f((i)+11),			\
+	f((i)+12), f((i)+13), f((i)+14), f((i)+15)
+#define B_X256(f) { B_X16(f, 0), B_X16(f, 16), B_X16(f, 32), B_X16(f, 48),	\
+	B_X16(f, 64), B_X16(f, 80), B_X16(f, 96), B_X16(f, 112),			\
+	B_X16(f, 128), B_X16(f, 144), B_X16(f, 160), B_X16(f, 176),			\
+	B_X16(f, 192), B_X16(f, 208), B_X16(f, 224), B_X16(f, 240) }
+
+#define B_IN(c, lo, hi) ((c) >= (lo) && (c) <= (hi))
+#define B64_V(c, c62, c63) (B_IN(c, 'A', 'Z') ? (c) - 'A'			\
+			: B_IN(c, 'a', 'z') ? (c) - 'a' + 26				\
+			: B_IN(c, '0', '9') ? (c) - '0' + 52				\
+			: (c) == (c62) ? 62 : (c) == (c63) ? 63 : -1)
+#define B64_STD(c) B64_V(c, '+', '/')
+#define B64_URL_V(c) B64_V(c, '-', '_')
+#define B32_V(c) (B_IN(c, 'A', 'Z') ? (c) - 'A'				\
+			: B_IN(c, 'a', 'z') ? (c) - 'a'				\
+			: B_IN(c, '2', '7') ? (c) - '2' + 26 : -1)
+
+static const int8_t b64_std_val[256] = B_X256(B64_STD);
+static const int8_t b64_url_val[256] = B_X256(B64_URL_V);
+static const int8_t b32_val_tab[256] = B_X256(B32_V);
+
+
+
+/*	kernels
+ * Convert whole groups (3 bytes <-> 4 chars; 5 bytes <-> 8 chars) in blocks,
+ * returning how many groups they did; the scalar code does the rest
+ * (all of it where a kernel is NULL).
+ * Decoding kernels stop before a block containing any character
+ * outside the alphabet: the scalar code finds (and handles) it.
+ * 'c62' and 'c63' are the last two characters of the base64 alphabet.
+ */
+struct b64_kernels {
+	unsigned	isa;
+	size_t		(*enc64)(const uint8_t *bin, size_t groups, char *out, char c62, char c63);
+	size_t		(*dec64)(const char *in, size_t groups, uint8_t *out, char c62, char c63);
+	size_t		(*enc32)(const uint8_t *bin, size_t groups, char *out);
+	size_t		(*dec32)(const char *in, size_t groups, uint8_t *out);
+};
+
+static const struct b64_kernels b64_scalar = {
+	.isa = HX_SCALAR
+};
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define B64_TARGET_AVX2		__attribute__((target("avx2")))
+#define B64_TARGET_AVX2_BMI2	__attribute__((target("avx2,bmi2")))
+
+/* (unsigned)x <= max */
+#define B64_LE(x, max) _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(max)), x)
+
+
+/*	enc64_AVX2()
+ * 24 bytes to 32 chars; reads 28 bytes.
+ * Bytes are spread to 4 per 32-bit lane, 6-bit fields split out with
+ * multiplies (W. Muła's method), then mapped to characters by range.
+ */
+B64_TARGET_AVX2 static size_t enc64_AVX2(const uint8_t *bin, size_t groups, char *out,
+					char c62, char c63)
+{
+	const __m256i shuf = _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	size_t g = 0;
+	for (; (g + 8) * 3 + 4 <= groups * 3; g += 8) {
+		__m256i in = _mm256_set_m128i(_mm_loadu_si128((const __m128i *)&bin[g * 3 + 12]),
+					_mm_loadu_si128((const __m128i *)&bin[g * 3]));
+		in = _mm256_shuffle_epi8(in, shuf);
+		__m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+					_mm256_set1_epi32(0x04000040));
+		__m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+					_mm256_set1_epi32(0x01000010));
+		__m256i idx = _mm256_or_si256(t0, t1);
+
+		/* 'A' + idx; then 'a', '0' ranges; then the last two */
+		__m256i off = _mm256_set1_epi8('A');
+		off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)),
+					_mm256_set1_epi8('a' - 26 - 'A')));
+		off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(51)),
+					_mm256_set1_epi8(('0' - 52) - ('a' - 26))));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(c62 - 62),
+					_mm256_cmpeq_epi8(idx, _mm256_set1_epi8(62)));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(c63 - 63),
+					_mm256_cmpeq_epi8(idx, _mm256_set1_epi8(63)));
+		_mm256_storeu_si256((__m256i *)&out[g * 4], _mm256_add_epi8(idx, off));
+	}
+	return g;
+}
+
+
+/*	dec64_AVX2()
+ * 32 chars to 24 bytes.
+ */
+B64_TARGET_AVX2 static size_t dec64_AVX2(const char *in, size_t groups, uint8_t *out,
+					char c62, char c63)
+{
+	const __m256i shuf = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i store = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+	size_t g = 0;
+	for (; g + 8 <= groups; g += 8) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)&in[g * 4]);
+		__m256i upper = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('A')), 25);
+		__m256i lower = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('a')), 25);
+		__m256i digit = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('0')), 9);
+		__m256i is62 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c62));
+		__m256i is63 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c63));
+		__m256i ok = _mm256_or_si256(_mm256_or_si256(upper, lower),
+				_mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+		if (_mm256_movemask_epi8(ok) != -1)
+			break;
+
+		__m256i off = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+		off = _mm256_or_si256(off, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+		off = _mm256_or_si256(off, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+		off = _mm256_or_si256(off, _mm256_and_si256(is62, _mm256_set1_epi8(62 - c62)));
+		off = _mm256_or_si256(off, _mm256_and_si256(is63, _mm256_set1_epi8(63 - c63)));
+		__m256i v = _mm256_add_epi8(c, off);
+
+		/* 4 x 6 bits -> 24 bits per lane, then 3 bytes each, packed */
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, shuf);
+		v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_maskstore_epi32((int *)&out[g * 3], store, v);
+	}
+	return g;
+}
+
+
+/*	enc32_AVX2()
+ * 20 bytes to 32 chars; reads 23 bytes.
+ * Each 5-byte group is spread to 8 x 5 bits with pdep.
+ */
+B64_TARGET_AVX2_BMI2 static size_t enc32_AVX2(const uint8_t *bin, size_t groups, char *out)
+{
+	size_t g = 0;
+	for (; (g + 4) * 5 + 3 <= groups * 5; g += 4) {
+		uint64_t s[4];
+		for (int i=0; i < 4; i++) {
+			uint64_t x;
+			memcpy(&x, &bin[(g + i) * 5], sizeof(x));
+			x = __builtin_bswap64(x) >> 24;
+			s[i] = __builtin_bswap64(_pdep_u64(x, 0x1f1f1f1f1f1f1f1fULL));
+		}
+		__m256i idx = _mm256_loadu_si256((const __m256i *)s);
+		__m256i off = _mm256_set1_epi8('A');
+		off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)),
+					_mm256_set1_epi8('2' - 26 - 'A')));
+		_mm256_storeu_si256((__m256i *)&out[g * 8], _mm256_add_epi8(idx, off));
+	}
+	return g;
+}
+
+
+/*	dec32_AVX2()
+ * 32 chars to 20 bytes; pext packs each group's 8 x 5 bits.
+ */
+B64_TARGET_AVX2_BMI2 static size_t dec32_AVX2(const char *in, size_t groups, uint8_t *out)
+{
+	size_t g = 0;
+	for (; g + 4 <= groups; g += 4) {
+		__m256i c = _mm256_loadu_si256((const __m256i *)&in[g * 8]);
+		__m256i upper = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('A')), 25);
+		__m256i lower = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('a')), 25);
+		__m256i digit = B64_LE(_mm256_sub_epi8(c, _mm256_set1_epi8('2')), 5);
+		__m256i ok = _mm256_or_si256(_mm256_or_si256(upper, lower), digit);
+		if (_mm256_movemask_epi8(ok) != -1)
+			break;
+
+		__m256i off = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+		off = _mm256_or_si256(off, _mm256_and_si256(lower, _mm256_set1_epi8(-'a')));
+		off = _mm256_or_si256(off, _mm256_and_si256(digit, _mm256_set1_epi8(26 - '2')));
+		uint64_t v[4];
+		_mm256_storeu_si256((__m256i *)v, _mm256_add_epi8(c, off));
+		for (int i=0; i < 4; i++) {
+			uint64_t x = _pext_u64(__builtin_bswap64(v[i]), 0x1f1f1f1f1f1f1f1fULL);
+			x = __builtin_bswap64(x << 24);
+			memcpy(&out[(g + i) * 5], &x, 5);
+		}
+	}
+	return g;
+}
+
+static const struct b64_kernels b64_AVX2 = {
+	.isa = HX_AVX2,
+	.enc64 = enc64_AVX2,
+	.dec64 = dec64_AVX2,
+	.enc32 = enc32_AVX2,
+	.dec32 = dec32_AVX2
+};
+
+
+/*	b64_best()
+ */
+static const struct b64_kernels *b64_best(unsigned max)
+{
+	__builtin_cpu_init();
+	if (max >= HX_AVX2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2"))
+		return &b64_AVX2;
+	return &b64_scalar;
+}
+
+#else
+static const struct b64_kernels *b64_best(unsigned max)
+{
+	return &b64_scalar;
+}
+#endif
+
+
+/* kernels in use: resolved on first use */
+static const struct b64_kernels *b64_k = NULL;
+
+NLC_INLINE const struct b64_kernels *b64_kernels()
+{
+	const struct b64_kernels *k = __atomic_load_n(&b64_k, __ATOMIC_RELAXED);
+	if (NLC_UNLIKELY(!k)) {
+		k = b64_best(HX_AVX512);
+		__atomic_store_n(&b64_k, k, __ATOMIC_RELAXED);
+	}
+	return k;
+}
+
+
+/*	b64_isa()
+ * Use the best kernels up to 'max' (HX_SCALAR ... HX_AVX512) this CPU supports;
+ * currently HX_AVX2 is the only SIMD level.
+ * Returns the level in use.
+ */
+unsigned b64_isa(unsigned max)
+{
+	const struct b64_kernels *k = b64_best(max);
+	__atomic_store_n(&b64_k, k, __ATOMIC_RELAXED);
+	return k->isa;
+}
+
+
+
+/*	base_codec
+ * What differs between base64 and base32, for the code common to both.
+ */
+struct base_codec {
+	unsigned	bits;	/* per char */
+	unsigned	chars;	/* per group */
+	unsigned	bytes;	/* per group */
+	/* whole groups, kernels first */
+	void		(*enc)(const uint8_t *bin, size_t groups, char *out, unsigned flags);
+	size_t		(*dec)(const char *in, size_t groups, uint8_t *out, unsigned flags);
+	/* value of 'c'; -1 if not in the alphabet */
+	int		(*val)(char c, unsigned flags);
+	const char	*(*alphabet)(unsigned flags);
+};
+
+
+static const char *b64_alphabet(unsigned flags)
+{
+	return flags & B64_URL ? b64_url : b64_std;
+}
+
+static int b64_val(char c, unsigned flags)
+{
+	return (flags & B64_URL ? b64_url_val : b64_std_val)[(uint8_t)c];
+}
+
+static void b64_enc(const uint8_t *bin, size_t groups, char *out, unsigned flags)
+{
+	const char *abc = b64_alphabet(flags);
+	const struct b64_kernels *k = b64_kernels();
+	size_t g = k->enc64 ? k->enc64(bin, groups, out, abc[62], abc[63]) : 0;
+	for (; g < groups; g++) {
+		const uint8_t *b = &bin[g * 3];
+		uint32_t x = (uint32_t)b[0] << 16 | (uint32_t)b[1] << 8 | b[2];
+		char *o = &out[g * 4];
+		o[0] = abc[x >> 18];
+		o[1] = abc[(x >> 12) & 0x3f];
+		o[2] = abc[(x >> 6) & 0x3f];
+		o[3] = abc[x & 0x3f];
+	}
+}
+
+static size_t b64_dec(const char *in, size_t groups, uint8_t *out, unsigned flags)
+{
+	const char *abc = b64_alphabet(flags);
+	const struct b64_kernels *k = b64_kernels();
+	size_t g = k->dec64 ? k->dec64(in, groups, out, abc[62], abc[63]) : 0;
+	for (; g < groups; g++) {
+		const char *c = &in[g * 4];
+		int v0 = b64_val(c[0], flags), v1 = b64_val(c[1], flags);
+		int v2 = b64_val(c[2], flags), v3 = b64_val(c[3], flags);
+		if ((v0 | v1 | v2 | v3) < 0)
+			break;
+		uint32_t x = v0 << 18 | v1 << 12 | v2 << 6 | v3;
+		uint8_t *o = &out[g * 3];
+		o[0] = x >> 16;
+		o[1] = x >> 8;
+		o[2] = x;
+	}
+	return g;
+}
+
+static const struct base_codec base64 = {
+	.bits = 6,
+	.chars = 4,
+	.bytes = 3,
+	.enc = b64_enc,
+	.dec = b64_dec,
+	.val = b64_val,
+	.alphabet = b64_alphabet
+};
+
+
+static const char *b32_alphabet(unsigned flags __attribute__((unused)))
+{
+	return b32_abc;
+}
+
+static int b32_val(char c, unsigned flags __attribute__((unused)))
+{
+	return b32_val_tab[(uint8_t)c];
+}
+
+static void b32_enc(const uint8_t *bin, size_t groups, char *out,
+			unsigned flags __attribute__((unused)))
+{
+	const struct b64_kernels *k = b64_kernels();
+	size_t g = k->enc32 ? k->enc32(bin, groups, out) : 0;
+	for (; g < groups; g++) {
+		const uint8_t *b = &bin[g * 5];
+		uint64_t x = (uint64_t)b[0] << 32 | (uint64_t)b[1] << 24 | (uint64_t)b[2] << 16
+			| (uint64_t)b[3] << 8 | b[4];
+		for (int i=0; i < 8; i++)
+			out[g * 8 + i] = b32_abc[(x >> (35 - i * 5)) & 0x1f];
+	}
+}
+
+static size_t b32_dec(const char *in, size_t groups, uint8_t *out, unsigned flags)
+{
+	const struct b64_kernels *k = b64_kernels();
+	size_t g = k->dec32 ? k->dec32(in, groups, out) : 0;
+	for (; g < groups; g++) {
+		uint64_t x = 0;
+		int bad = 0;
+		for (int i=0; i < 8; i++) {
+			int v = b32_val(in[g * 8 + i], flags);
+			bad |= v;
+			x = x << 5 | (v & 0x1f);
+		}
+		if (bad < 0)
+			break;
+		for (int i=0; i < 5; i++)
+			out[g * 5 + i] = x >> (32 - i * 8);
+	}
+	return g;
+}
+
+static const struct base_codec base32 = {
+	.bits = 5,
+	.chars = 8,
+	.bytes = 5,
+	.enc = b32_enc,
+	.dec = b32_dec,
+	.val = b32_val,
+	.alphabet = b32_alphabet
+};
+
+
+
+/*	base_stream_init()
+ * Reset 'bs' for a new stream.
+ * 'flags' are B64_URL and/or B64_NOPAD;
+ * 'cols' is (at most) chars per line when encoding, rounded down to whole groups
+ * (0: no line breaks).
+ */
+void base_stream_init(struct base_stream *bs, unsigned flags, size_t cols)
+{
+	*bs = (struct base_stream){ .flags = flags, .cols = cols };
+}
+
+
+/*	enc_groups()
+ * Encode whole groups, breaking lines.
+ * Returns number of chars written.
+ */
+static size_t enc_groups(const struct base_codec *cd, struct base_stream *bs,
+			const uint8_t *bin, size_t groups, char *out)
+{
+	size_t line = bs->cols / cd->chars;
+	if (!line) {
+		cd->enc(bin, groups, out, bs->flags);
+		return groups * cd->chars;
+	}
+
+	size_t pos = 0;
+	while (groups) {
+		size_t n = line - bs->col / cd->chars;
+		if (n > groups)
+			n = groups;
+		cd->enc(bin, n, &out[pos], bs->flags);
+		bin += n * cd->bytes;
+		groups -= n;
+		pos += n * cd->chars;
+		if ((bs->col += n * cd->chars) == line * cd->chars) {
+			out[pos++] = '\n';
+			bs->col = 0;
+		}
+	}
+	return pos;
+}
+
+
+/*	stream_enc()
+ */
+static size_t stream_enc(const struct base_codec *cd, struct base_stream *bs,
+			const uint8_t *bin, size_t len, char *out)
+{
+	size_t pos = 0;
+
+	/* complete a carried partial group */
+	if (bs->cnt) {
+		while (bs->cnt < cd->bytes && len) {
+			bs->bits = bs->bits << 8 | *bin++;
+			bs->cnt++;
+			len--;
+		}
+		if (bs->cnt < cd->bytes)
+			return 0;
+		uint8_t group[8];
+		for (unsigned i=0; i < cd->bytes; i++)
+			group[i] = bs->bits >> ((cd->bytes - 1 - i) * 8);
+		pos += enc_groups(cd, bs, group, 1, out);
+		bs->cnt = 0;
+		bs->bits = 0;
+	}
+
+	size_t groups = len / cd->bytes;
+	pos += enc_groups(cd, bs, bin, groups, &out[pos]);
+
+	/* carry the rest */
+	for (size_t i = groups * cd->bytes; i < len; i++) {
+		bs->bits = bs->bits << 8 | bin[i];
+		bs->cnt++;
+	}
+	return pos;
+}
+
+
+/*	stream_enc_end()
+ */
+static size_t stream_enc_end(const struct base_codec *cd, struct base_stream *bs, char *out)
+{
+	size_t pos = 0;
+	if (bs->cnt) {
+		const char *abc = cd->alphabet(bs->flags);
+		unsigned chars = (bs->cnt * 8 + cd->bits - 1) / cd->bits;
+		uint64_t x = bs->bits << (chars * cd->bits - bs->cnt * 8);
+		for (unsigned i=0; i < chars; i++)
+			out[pos++] = abc[(x >> ((chars - 1 - i) * cd->bits)) & ((1 << cd->bits) - 1)];
+		if (!(bs->flags & B64_NOPAD)) {
+			for (; chars < cd->chars; chars++)
+				out[pos++] = '=';
+		}
+		bs->col += pos;
+	}
+	if (bs->cols >= cd->chars && bs->col)
+		out[pos++] = '\n';
+	bs->cnt = 0;
+	bs->bits = 0;
+	bs->col = 0;
+	return pos;
+}
+
+
+/*	stream_dec()
+ */
+static ssize_t stream_dec(const struct base_codec *cd, struct base_stream *bs,
+			const char *in, size_t len, uint8_t *out)
+{
+	size_t i = 0;
+	size_t pos = 0;
+
+	while (i < len) {
+		/* whole groups, directly */
+		if (!bs->cnt && !bs->pad) {
+			size_t done = cd->dec(&in[i], (len - i) / cd->chars, &out[pos], bs->flags);
+			i += done * cd->chars;
+			pos += done * cd->bytes;
+			if (i == len)
+				break;
+		}
+
+		char c = in[i];
+		switch (c) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case '\v':
+		case '\f':
+			break;
+		case '=':
+			/* only after a partial group, up to a whole one */
+			if (!bs->cnt || bs->cnt + bs->pad >= cd->chars)
+				goto bad;
+			bs->pad++;
+			break;
+		default:
+		{
+			int v = cd->val(c, bs->flags);
+			if (v < 0 || bs->pad)
+				goto bad;
+			bs->bits = bs->bits << cd->bits | v;
+			if (++bs->cnt == cd->chars) {
+				for (unsigned j=0; j < cd->bytes; j++)
+					out[pos++] = bs->bits >> ((cd->bytes - 1 - j) * 8);
+				bs->cnt = 0;
+				bs->bits = 0;
+			}
+		}
+		}
+		i++;
+	}
+
+	bs->pos += len;
+	return pos;
+bad:
+	bs->pos += i;
+	return -1;
+}
+
+
+/*	stream_dec_end()
+ */
+static ssize_t stream_dec_end(const struct base_codec *cd, struct base_stream *bs,
+				uint8_t *out)
+{
+	ssize_t ret = 0;
+	unsigned bits = bs->cnt * cd->bits;
+	unsigned bytes = bits / 8;
+
+	/* a partial group: the fewest chars carrying 'bytes', correctly padded */
+	if (bs->cnt && (!bytes || bits - bytes * 8 >= cd->bits))
+		ret = -1;
+	else if (bs->pad && bs->cnt + bs->pad != cd->chars)
+		ret = -1;
+	else
+		for (; ret < bytes; ret++)
+			out[ret] = bs->bits >> (bits - (ret + 1) * 8);
+
+	bs->cnt = 0;
+	bs->pad = 0;
+	bs->bits = 0;
+	return ret;
+}
+
+
+
+/*	b64_stream_enc()
+ * Encode 'len' bytes at 'bin' to base64 at 'out'; bytes short of a whole
+ * group are kept for the next call.
+ * Writes at most b64_stream_enc_max() chars; NOT '\0'-terminated.
+ * Returns number of chars written.
+ */
+size_t b64_stream_enc(struct base_stream *bs, const void *bin, size_t len, char *out)
+{
+	return stream_enc(&base64, bs, bin, len, out);
+}
+
+/*	b64_stream_enc_end()
+ * End the stream: encode (and pad) a last partial group, end the last line.
+ * Returns number of chars written to 'out' (at most 5).
+ */
+size_t b64_stream_enc_end(struct base_stream *bs, char *out)
+{
+	return stream_enc_end(&base64, bs, out);
+}
+
+/*	b64_stream_dec()
+ * Decode 'len' chars of base64 at 'b64' into 'out' (at least B64_DEC_MAX(len) bytes);
+ * whitespace is skipped, chars short of a whole group kept for the next call.
+ * Returns number of bytes written;
+ * -1 on a character outside the alphabet or misplaced padding:
+ * its position in the stream is then 'bs->pos'.
+ */
+ssize_t b64_stream_dec(struct base_stream *bs, const char *b64, size_t len, uint8_t *out)
+{
+	return stream_dec(&base64, bs, b64, len, out);
+}
+
+/*	b64_stream_dec_end()
+ * End the stream: decode a last partial group into 'out' (at most 2 bytes).
+ * Returns number of bytes written; -1 if the stream ended improperly
+ * (a group cut short, or incomplete padding).
+ */
+ssize_t b64_stream_dec_end(struct base_stream *bs, uint8_t *out)
+{
+	return stream_dec_end(&base64, bs, out);
+}
+
+
+/*	b32_stream_enc()
+ * As b64_stream_enc(), for base32.
+ */
+size_t b32_stream_enc(struct base_stream *bs, const void *bin, size_t len, char *out)
+{
+	return stream_enc(&base32, bs, bin, len, out);
+}
+
+/*	b32_stream_enc_end()
+ * As b64_stream_enc_end(), for base32 (at most 9 chars).
+ */
+size_t b32_stream_enc_end(struct base_stream *bs, char *out)
+{
+	return stream_enc_end(&base32, bs, out);
+}
+
+/*	b32_stream_dec()
+ * As b64_stream_dec(), for base32 ('out' at least B32_DEC_MAX(len) bytes).
+ */
+ssize_t b32_stream_dec(struct base_stream *bs, const char *b32, size_t len, uint8_t *out)
+{
+	return stream_dec(&base32, bs, b32, len, out);
+}
+
+/*	b32_stream_dec_end()
+ * As b64_stream_dec_end(), for base32 (at most 4 bytes).
+ */
+ssize_t b32_stream_dec_end(struct base_stream *bs, uint8_t *out)
+{
+	return stream_dec_end(&base32, bs, out);
+}
+
+
+
+/*	b2b64()
+ * Writes 'byte_cnt' bytes at 'bin' as (B64_ENC_LEN(byte_cnt) +1) base64 chars
+ * to 'out', padded unless B64_NOPAD; URL-safe alphabet with B64_URL.
+ * (+1 because trailing '\0').
+ * Does NOT check that enough mem in 'out' exists.
+ *
+ * Returns number of CHARACTERS written, including '\0'.
+ */
+size_t b2b64(const unsigned char *bin, char *out, size_t byte_cnt, unsigned flags)
+{
+	if (!bin || !out)
+		return 0;
+	struct base_stream bs;
+	base_stream_init(&bs, flags, 0);
+	size_t pos = b64_stream_enc(&bs, bin, byte_cnt, out);
+	pos += b64_stream_enc_end(&bs, &out[pos]);
+	out[pos++] = '\0';
+	return pos;
+}
+
+/*	b642b()
+ * Decode 'len' chars of base64 at 'b64' into 'out' (at least B64_DEC_MAX(len) bytes).
+ * Whitespace is ignored; padding is optional.
+ * 'flags' may be B64_URL.
+ *
+ * Returns number of bytes written; -1 if 'b64' is not valid base64.
+ */
+ssize_t b642b(const char *b64, size_t len, uint8_t *out, unsigned flags)
+{
+	struct base_stream bs;
+	base_stream_init(&bs, flags, 0);
+	ssize_t pos = b64_stream_dec(&bs, b64, len, out);
+	if (pos < 0)
+		return -1;
+	ssize_t end = b64_stream_dec_end(&bs, &out[pos]);
+	if (end < 0)
+		return -1;
+	return pos + end;
+}
+
+
+/*	b2b32()
+ * As b2b64(), for base32 (B32_ENC_LEN(byte_cnt) +1 chars).
+ */
+size_t b2b32(const unsigned char *bin, char *out, size_t byte_cnt, unsigned flags)
+{
+	if (!bin || !out)
+		return 0;
+	struct base_stream bs;
+	base_stream_init(&bs, flags, 0);
+	size_t pos = b32_stream_enc(&bs, bin, byte_cnt, out);
+	pos += b32_stream_enc_end(&bs, &out[pos]);
+	out[pos++] = '\0';
+	return pos;
+}
+
+/*	b322b()
+ * As b642b(), for base32 ('out' at least B32_DEC_MAX(len) bytes).
+ */
+ssize_t b322b(const char *b32, size_t len, uint8_t *out, unsigned flags)
+{
+	struct base_stream bs;
+	base_stream_init(&bs, flags, 0);
+	ssize_t pos = b32_stream_dec(&bs, b32, len, out);
+	if (pos < 0)
+		return -1;
+	ssize_t end = b32_stream_dec_end(&bs, &out[pos]);
+	if (end < 0)
+		return -1;
+	return pos + end;
+}
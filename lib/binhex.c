@@ -4,6 +4,412 @@
 static const char *syms = "0123456789abcdef";
 
 
+
+/*	kernels
+ * Each set of kernels converts whole blocks and returns how much it did;
+ * the scalar code below finishes off the rest (all of it where a kernel is NULL).
+ * enc:		'cnt' bytes at 'bin' to hex, in order (b2hx_BE())
+ * enc_le:	'cnt' bytes at 'bin' to hex, from the last byte (b2hx())
+ * scan:	count leading hex digits in the 'max' chars at 'hex'
+ * dec:		'pairs' digit pairs ending at 'last' (validated by scan),
+ *		from the back, into 'out' upwards (hx2b())
+ * dec_be:	as dec, into 'out_end' downwards (hx2b_BE())
+ * delims:	bitmask of the token delimiters (hx_delim()) in 64 chars at 'p'
+ */
+struct hx_kernels {
+	unsigned	isa;
+	size_t		(*enc)(const unsigned char *bin, char *hex, size_t cnt);
+	size_t		(*enc_le)(const unsigned char *bin, char *hex, size_t cnt);
+	size_t		(*scan)(const char *hex, size_t max);
+	size_t		(*dec)(const char *last, uint8_t *out, size_t pairs);
+	size_t		(*dec_be)(const char *last, uint8_t *out_end, size_t pairs);
+	uint64_t	(*delims)(const char *p);
+};
+
+
+/*	hx_delim()
+ * Separates tokens for hx_parse_u64(): whitespace or ','.
+ */
+NLC_INLINE bool hx_delim(char c)
+{
+	return c == ' ' || c == ',' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+
+static size_t hx_scan_scalar(const char *hex, size_t max)
+{
+	size_t i = 0;
+	uint8_t res;
+	while (i < max && !hex_parse_nibble(&hex[i], &res))
+		i++;
+	return i;
+}
+
+static uint64_t hx_delims_scalar(const char *p)
+{
+	uint64_t d = 0;
+	for (unsigned i=0; i < 64; i++)
+		d |= (uint64_t)hx_delim(p[i]) << i;
+	return d;
+}
+
+static const struct hx_kernels hx_scalar = {
+	.isa = HX_SCALAR,
+	.scan = hx_scan_scalar,
+	.delims = hx_delims_scalar
+};
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+
+#define HX_TARGET_SSE2		__attribute__((target("sse2")))
+#define HX_TARGET_AVX2		__attribute__((target("avx2")))
+#define HX_TARGET_AVX512	__attribute__((target("avx512f,avx512bw")))
+
+
+/*	HX_KERNELS()
+ * Define the loops of a set of kernels, over its block functions:
+ *	hx_enc_block_<name>(bin, hex, rev):	'W' bytes to 2*'W' digits,
+ *						bytes reversed first if 'rev'
+ *	hx_dec_block_<name>(hex, out, rev):	2*'W' digits to 'W' bytes,
+ *						reversed before storing if 'rev'
+ *	hx_valid_<name>(hex):			bitmask of the hex digits in 'W'
+ *						characters at 'hex'
+ *	hx_delim_<name>(p):			bitmask of the delimiters in 'W'
+ *						characters at 'p'
+ * Scanning reads whole blocks while they fit in 'max', then finishes scalar:
+ * nothing outside the 'max' chars at 'hex' is read.
+ */
+#define HX_KERNELS(name, W, TARGET)						\
+TARGET static size_t hx_enc_##name(const unsigned char *bin, char *hex, size_t cnt)\
+{										\
+	size_t i = 0;								\
+	for (; i + W <= cnt; i += W)						\
+		hx_enc_block_##name(&bin[i], &hex[i * 2], false);		\
+	return i;								\
+}										\
+TARGET static size_t hx_enc_le_##name(const unsigned char *bin, char *hex, size_t cnt)\
+{										\
+	size_t i = 0;								\
+	for (; i + W <= cnt; i += W)						\
+		hx_enc_block_##name(&bin[cnt - i - W], &hex[i * 2], true);	\
+	return i;								\
+}										\
+TARGET static size_t hx_scan_##name(const char *hex, size_t max)		\
+{										\
+	const uint64_t all = ~0ULL >> (64 - W);					\
+	size_t cnt = 0;								\
+	for (; cnt + W <= max; cnt += W) {					\
+		uint64_t bad = ~hx_valid_##name(&hex[cnt]) & all;		\
+		if (bad)							\
+			return cnt + __builtin_ctzll(bad);			\
+	}									\
+	return cnt + hx_scan_scalar(&hex[cnt], max - cnt);			\
+}										\
+TARGET static size_t hx_dec_##name(const char *last, uint8_t *out, size_t pairs)\
+{										\
+	size_t i = 0;								\
+	for (; i + W <= pairs; i += W)						\
+		hx_dec_block_##name(last - (i + W) * 2 + 1, &out[i], true);	\
+	return i;								\
+}										\
+TARGET static size_t hx_dec_be_##name(const char *last, uint8_t *out_end, size_t pairs)\
+{										\
+	size_t i = 0;								\
+	for (; i + W <= pairs; i += W)						\
+		hx_dec_block_##name(last - (i + W) * 2 + 1, out_end - i - W, false);\
+	return i;								\
+}										\
+TARGET static uint64_t hx_delims_##name(const char *p)				\
+{										\
+	uint64_t d = 0;								\
+	for (unsigned i=0; i < 64; i += W)					\
+		d |= hx_delim_##name(&p[i]) << i;				\
+	return d;								\
+}										\
+static const struct hx_kernels hx_##name = {					\
+	.isa = HX_##name,							\
+	.enc = hx_enc_##name,							\
+	.enc_le = hx_enc_le_##name,						\
+	.scan = hx_scan_##name,							\
+	.dec = hx_dec_##name,							\
+	.dec_be = hx_dec_be_##name,						\
+	.delims = hx_delims_##name						\
+};
+
+
+
+/*	SSE2: 16 bytes
+ * No byte shuffle: digits are computed, reversal is done by words.
+ */
+HX_TARGET_SSE2 static inline __m128i hx_rev_SSE2(__m128i x)
+{
+	x = _mm_shuffle_epi32(x, 0x1b);
+	x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+/* nibbles to digits: n + '0', plus 'a' - '0' - 10 for n > 9 */
+HX_TARGET_SSE2 static inline __m128i hx_digits_SSE2(__m128i n)
+{
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+				_mm_set1_epi8('a' - '0' - 10));
+	return _mm_add_epi8(n, _mm_add_epi8(alpha, _mm_set1_epi8('0')));
+}
+
+HX_TARGET_SSE2 static inline void hx_enc_block_SSE2(const unsigned char *bin, char *hex, bool rev)
+{
+	__m128i b = _mm_loadu_si128((const __m128i *)bin);
+	if (rev)
+		b = hx_rev_SSE2(b);
+	__m128i lo = hx_digits_SSE2(_mm_and_si128(b, _mm_set1_epi8(0xf)));
+	__m128i hi = hx_digits_SSE2(_mm_and_si128(_mm_srli_epi16(b, 4), _mm_set1_epi8(0xf)));
+	_mm_storeu_si128((__m128i *)hex, _mm_unpacklo_epi8(hi, lo));
+	_mm_storeu_si128((__m128i *)&hex[16], _mm_unpackhi_epi8(hi, lo));
+}
+
+/* (unsigned)x <= max */
+#define HX_LE_SSE2(x, max) _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(max)), x)
+
+HX_TARGET_SSE2 static inline uint64_t hx_valid_SSE2(const char *hex)
+{
+	__m128i c = _mm_loadu_si128((const __m128i *)hex);
+	__m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	__m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i ok = _mm_or_si128(HX_LE_SSE2(digit, 9), HX_LE_SSE2(alpha, 5));
+	return (uint16_t)_mm_movemask_epi8(ok);
+}
+
+/* digits to nibbles: low 4 bits, plus 9 for letters */
+HX_TARGET_SSE2 static inline __m128i hx_nibbles_SSE2(__m128i c)
+{
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('9')), _mm_set1_epi8(9));
+	return _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0xf)), alpha);
+}
+
+/* pairs of nibbles (first one high) in 16-bit lanes, to 16-bit bytes */
+HX_TARGET_SSE2 static inline __m128i hx_pairs_SSE2(__m128i n)
+{
+	return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(n, 4), _mm_set1_epi16(0xf0)),
+			_mm_srli_epi16(n, 8));
+}
+
+HX_TARGET_SSE2 static inline void hx_dec_block_SSE2(const char *hex, uint8_t *out, bool rev)
+{
+	__m128i a = hx_nibbles_SSE2(_mm_loadu_si128((const __m128i *)hex));
+	__m128i b = hx_nibbles_SSE2(_mm_loadu_si128((const __m128i *)&hex[16]));
+	__m128i r = _mm_packus_epi16(hx_pairs_SSE2(a), hx_pairs_SSE2(b));
+	if (rev)
+		r = hx_rev_SSE2(r);
+	_mm_storeu_si128((__m128i *)out, r);
+}
+
+HX_TARGET_SSE2 static inline uint64_t hx_delim_SSE2(const char *p)
+{
+	__m128i c = _mm_loadu_si128((const __m128i *)p);
+	__m128i d = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+				_mm_cmpeq_epi8(c, _mm_set1_epi8(',')));
+	d = _mm_or_si128(d, HX_LE_SSE2(_mm_sub_epi8(c, _mm_set1_epi8('\t')), '\r' - '\t'));
+	return (uint16_t)_mm_movemask_epi8(d);
+}
+
+HX_KERNELS(SSE2, 16, HX_TARGET_SSE2)
+
+
+
+/*	AVX2: 32 bytes
+ * Digits by table lookup; unpack and pack work within 128-bit lanes,
+ * the lanes are put in order after.
+ */
+HX_TARGET_AVX2 static inline __m256i hx_rev_AVX2(__m256i x)
+{
+	const __m256i rev = _mm256_setr_epi8(
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, rev), 0x4e);
+}
+
+HX_TARGET_AVX2 static inline void hx_enc_block_AVX2(const unsigned char *bin, char *hex, bool rev)
+{
+	const __m256i lut = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)syms));
+	__m256i b = _mm256_loadu_si256((const __m256i *)bin);
+	if (rev)
+		b = hx_rev_AVX2(b);
+	__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(b, _mm256_set1_epi8(0xf)));
+	__m256i hi = _mm256_shuffle_epi8(lut,
+		_mm256_and_si256(_mm256_srli_epi16(b, 4), _mm256_set1_epi8(0xf)));
+	__m256i x = _mm256_unpacklo_epi8(hi, lo);
+	__m256i y = _mm256_unpackhi_epi8(hi, lo);
+	_mm256_storeu_si256((__m256i *)hex, _mm256_permute2x128_si256(x, y, 0x20));
+	_mm256_storeu_si256((__m256i *)&hex[32], _mm256_permute2x128_si256(x, y, 0x31));
+}
+
+/* (unsigned)x <= max */
+#define HX_LE_AVX2(x, max) _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(max)), x)
+
+HX_TARGET_AVX2 static inline uint64_t hx_valid_AVX2(const char *hex)
+{
+	__m256i c = _mm256_loadu_si256((const __m256i *)hex);
+	__m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+	__m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)),
+				_mm256_set1_epi8('a'));
+	__m256i ok = _mm256_or_si256(HX_LE_AVX2(digit, 9), HX_LE_AVX2(alpha, 5));
+	return (uint32_t)_mm256_movemask_epi8(ok);
+}
+
+/* digits to pairs of nibbles (first one high) in 16-bit lanes */
+HX_TARGET_AVX2 static inline __m256i hx_pairs_AVX2(__m256i c)
+{
+	__m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('9')),
+				_mm256_set1_epi8(9));
+	__m256i n = _mm256_add_epi8(_mm256_and_si256(c, _mm256_set1_epi8(0xf)), alpha);
+	return _mm256_maddubs_epi16(n, _mm256_set1_epi16(0x0110));
+}
+
+HX_TARGET_AVX2 static inline void hx_dec_block_AVX2(const char *hex, uint8_t *out, bool rev)
+{
+	__m256i a = hx_pairs_AVX2(_mm256_loadu_si256((const __m256i *)hex));
+	__m256i b = hx_pairs_AVX2(_mm256_loadu_si256((const __m256i *)&hex[32]));
+	__m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+	if (rev)
+		r = hx_rev_AVX2(r);
+	_mm256_storeu_si256((__m256i *)out, r);
+}
+
+HX_TARGET_AVX2 static inline uint64_t hx_delim_AVX2(const char *p)
+{
+	__m256i c = _mm256_loadu_si256((const __m256i *)p);
+	__m256i d = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8(',')));
+	d = _mm256_or_si256(d, HX_LE_AVX2(_mm256_sub_epi8(c, _mm256_set1_epi8('\t')), '\r' - '\t'));
+	return (uint32_t)_mm256_movemask_epi8(d);
+}
+
+HX_KERNELS(AVX2, 32, HX_TARGET_AVX2)
+
+
+
+/*	AVX-512 (BW): 64 bytes
+ * As AVX2, over 4 lanes.
+ */
+HX_TARGET_AVX512 static inline __m512i hx_rev_AVX512(__m512i x)
+{
+	const __m512i rev = _mm512_broadcast_i32x4(_mm_setr_epi8(
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+	return _mm512_shuffle_i64x2(_mm512_shuffle_epi8(x, rev),
+				_mm512_shuffle_epi8(x, rev), 0x1b);
+}
+
+HX_TARGET_AVX512 static inline void hx_enc_block_AVX512(const unsigned char *bin, char *hex, bool rev)
+{
+	const __m512i lut = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)syms));
+	__m512i b = _mm512_loadu_si512(bin);
+	if (rev)
+		b = hx_rev_AVX512(b);
+	__m512i lo = _mm512_shuffle_epi8(lut, _mm512_and_si512(b, _mm512_set1_epi8(0xf)));
+	__m512i hi = _mm512_shuffle_epi8(lut,
+		_mm512_and_si512(_mm512_srli_epi16(b, 4), _mm512_set1_epi8(0xf)));
+	__m512i x = _mm512_unpacklo_epi8(hi, lo);
+	__m512i y = _mm512_unpackhi_epi8(hi, lo);
+	_mm512_storeu_si512(hex, _mm512_permutex2var_epi64(x,
+		_mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11), y));
+	_mm512_storeu_si512(&hex[64], _mm512_permutex2var_epi64(x,
+		_mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15), y));
+}
+
+HX_TARGET_AVX512 static inline uint64_t hx_valid_AVX512(const char *hex)
+{
+	__m512i c = _mm512_loadu_si512(hex);
+	__m512i digit = _mm512_sub_epi8(c, _mm512_set1_epi8('0'));
+	__m512i alpha = _mm512_sub_epi8(_mm512_or_si512(c, _mm512_set1_epi8(0x20)),
+				_mm512_set1_epi8('a'));
+	return _mm512_cmple_epu8_mask(digit, _mm512_set1_epi8(9))
+		| _mm512_cmple_epu8_mask(alpha, _mm512_set1_epi8(5));
+}
+
+HX_TARGET_AVX512 static inline __m512i hx_pairs_AVX512(__m512i c)
+{
+	__m512i n = _mm512_and_si512(c, _mm512_set1_epi8(0xf));
+	n = _mm512_mask_add_epi8(n, _mm512_cmpgt_epi8_mask(c, _mm512_set1_epi8('9')),
+				n, _mm512_set1_epi8(9));
+	return _mm512_maddubs_epi16(n, _mm512_set1_epi16(0x0110));
+}
+
+HX_TARGET_AVX512 static inline void hx_dec_block_AVX512(const char *hex, uint8_t *out, bool rev)
+{
+	__m512i a = hx_pairs_AVX512(_mm512_loadu_si512(hex));
+	__m512i b = hx_pairs_AVX512(_mm512_loadu_si512(&hex[64]));
+	__m512i r = _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7),
+					_mm512_packus_epi16(a, b));
+	if (rev)
+		r = hx_rev_AVX512(r);
+	_mm512_storeu_si512(out, r);
+}
+
+HX_TARGET_AVX512 static inline uint64_t hx_delim_AVX512(const char *p)
+{
+	__m512i c = _mm512_loadu_si512(p);
+	return _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8(' '))
+		| _mm512_cmpeq_epi8_mask(c, _mm512_set1_epi8(','))
+		| _mm512_cmple_epu8_mask(_mm512_sub_epi8(c, _mm512_set1_epi8('\t')),
+					_mm512_set1_epi8('\r' - '\t'));
+}
+
+HX_KERNELS(AVX512, 64, HX_TARGET_AVX512)
+
+
+/*	hx_best()
+ * The best kernels up to 'max' this CPU supports.
+ */
+static const struct hx_kernels *hx_best(unsigned max)
+{
+	__builtin_cpu_init();
+	if (max >= HX_AVX512 && __builtin_cpu_supports("avx512bw"))
+		return &hx_AVX512;
+	if (max >= HX_AVX2 && __builtin_cpu_supports("avx2"))
+		return &hx_AVX2;
+	if (max >= HX_SSE2 && __builtin_cpu_supports("sse2"))
+		return &hx_SSE2;
+	return &hx_scalar;
+}
+
+#else
+static const struct hx_kernels *hx_best(unsigned max)
+{
+	return &hx_scalar;
+}
+#endif
+
+
+/* kernels in use: resolved on first use */
+static const struct hx_kernels *hx_k = NULL;
+
+NLC_INLINE const struct hx_kernels *hx_kernels()
+{
+	const struct hx_kernels *k = __atomic_load_n(&hx_k, __ATOMIC_RELAXED);
+	if (NLC_UNLIKELY(!k)) {
+		k = hx_best(HX_AVX512);
+		__atomic_store_n(&hx_k, k, __ATOMIC_RELAXED);
+	}
+	return k;
+}
+
+
+/*	hx_isa()
+ * Use the best kernels up to 'max' (HX_SCALAR ... HX_AVX512) this CPU supports.
+ * Returns the level in use.
+ */
+unsigned hx_isa(unsigned max)
+{
+	const struct hx_kernels *k = hx_best(max);
+	__atomic_store_n(&hx_k, k, __ATOMIC_RELAXED);
+	return k->isa;
+}
+
+
+
 /*	b2hx()
  * Writes byte_cnt bytes as (byte_cnt *2 +1) ascii hex digits to the mem in `*out`.
  * (+1 because trailing '\0').
@@ -27,10 +433,12 @@ size_t b2hx(const unsigned char *bin, char *hex, size_t byte_cnt)
 	if (!bin || !hex || !byte_cnt)
 		return 0;
 
-	size_t hex_pos = 0;
-	for (int i=byte_cnt-1; i >= 0; i--) {
-		hex[hex_pos++] = syms[bin[i] >> 4];
-		hex[hex_pos++] = syms[bin[i] & 0xf];
+	const struct hx_kernels *k = hx_kernels();
+	size_t done = k->enc_le ? k->enc_le(bin, hex, byte_cnt) : 0;
+	size_t hex_pos = done * 2;
+	for (size_t i = byte_cnt - done; i > 0; i--) {
+		hex[hex_pos++] = syms[bin[i-1] >> 4];
+		hex[hex_pos++] = syms[bin[i-1] & 0xf];
 	}
 	hex[hex_pos++] = '\0'; /* end of string */
 
@@ -45,8 +453,10 @@ size_t	b2hx_BE	(const unsigned char *bin, char *hex, size_t byte_cnt)
 	if (!bin || !hex || !byte_cnt)
 		return 0;
 
-	size_t hex_pos = 0;
-	for (int i=0; i < byte_cnt; i++) {
+	const struct hx_kernels *k = hx_kernels();
+	size_t done = k->enc ? k->enc(bin, hex, byte_cnt) : 0;
+	size_t hex_pos = done * 2;
+	for (size_t i = done; i < byte_cnt; i++) {
 		hex[hex_pos++] = syms[bin[i] >> 4];
 		hex[hex_pos++] = syms[bin[i] & 0xf];
 	}
@@ -154,39 +564,23 @@ const char *hex_burn_leading(const char *hex)
 }
 
 
-/*	COUNT_NIBBLES_COMMON
- * Dedup some code in the following functions.
- * Unless you are a maintainer, this is safe to ignore.
+/*	hx_count()
+ * How many nibbles are there ACTUALLY? (at most 'max')
+ * 'hex' is a string: the scan does not read past its end.
+ * We may be parsing a 64-bit int expressed in 1 character (LSnibble).
+ * Therefore, we must parse backwards.
+ * One may be forgiven for thinking "surely we can turn this into a
+ * single-pass operation", but one would be wrong, since a single pass
+ * means shifting _all_ earlier values (up/down depending on endianness)
+ * each time one parses the next byte.
+ * The basic problem appears to be that human representation is
+ * _actually_ variable-sized little-endian, disguised as big-endian
+ * by implicit right-alignment of numbers.
  */
-#define COUNT_NIBBLES_COMMON							\
-	/* How many nibbles are there ACTUALLY?					\
-	 * We may be parsing a 64-bit int expressed in 1 character (LSnibble).	\
-	 * Therefore, we must parse backwards.					\
-	 * One may be forgiven for thinking "surely we can turn this into a	\
-	 * single-pass operation", but one would be wrong, since a single pass	\
-	 * means shifting _all_ earlier values (up/down depending on endianness)\
-	 * each time one parses the next byte.					\
-	 * The basic problem appears to be that human representation is		\
-	 * _actually_ variable-sized little-endian, disguised as big-endian	\
-	 * by implicit right-alignment of numbers.				\
-	 */									\
-	int nibble_cnt = 0;							\
-	while (nibble_cnt < bytes * 2) {					\
-		switch (*hex) {							\
-			/* valid hex: check next nibble */			\
-			case '0'...'9':						\
-			case 'A'...'F':						\
-			case 'a'...'f':						\
-				nibble_cnt++;					\
-				hex++;						\
-				break;						\
-			default:						\
-				goto out_while;					\
-		}								\
-	}									\
-out_while:									\
-	/* last symbol was either bad or out of bounds. backtrack */		\
-	hex--;
+NLC_INLINE size_t hx_count(const char *hex, size_t max)
+{
+	return hx_kernels()->scan(hex, strnlen(hex, max));
+}
 
 
 /*	hx2b()
@@ -207,13 +601,20 @@ size_t hx2b(const char *hex, uint8_t *out, size_t bytes)
 {
 	/* Burn any leading characters */
 	hex = hex_burn_leading(hex);
-	COUNT_NIBBLES_COMMON
+	size_t nibble_cnt = hx_count(hex, bytes * 2);
 
 	/* first clean. then parse */
 	memset(out, 0x0, bytes);
 
-	/* parse all the nibbles, from the BACK (LSn of LSB == i=0) */
-	for (int i=0; i < nibble_cnt; i++, hex--) {
+	/* whole blocks of pairs, then all the remaining nibbles,
+	 * from the BACK (LSn of LSB == i=0)
+	 */
+	const char *last = hex + nibble_cnt - 1;
+	const struct hx_kernels *k = hx_kernels();
+	size_t done = k->dec ? k->dec(last, out, nibble_cnt / 2) : 0;
+	hex = last - done * 2;
+	out += done;
+	for (size_t i = done * 2; i < nibble_cnt; i++, hex--) {
 		uint8_t res;
 		if (hex_parse_nibble(hex, &res))
 			break;
@@ -240,14 +641,20 @@ size_t hx2b_BE(const char *hex, uint8_t *out, size_t bytes)
 {
 	/* Burn any leading characters */
 	hex = hex_burn_leading(hex);
-	COUNT_NIBBLES_COMMON
+	size_t nibble_cnt = hx_count(hex, bytes * 2);
 
 	/* first clean. then parse */
 	memset(out, 0x0, bytes);
 
-	/* parse all the nibbles, from the BACK (LSn of LSB == i=0) */
-	out += bytes -1;
-	for (int i=0; i < nibble_cnt; i++, hex--) {
+	/* whole blocks of pairs, then all the remaining nibbles,
+	 * from the BACK (LSn of LSB == i=0)
+	 */
+	const char *last = hex + nibble_cnt - 1;
+	const struct hx_kernels *k = hx_kernels();
+	size_t done = k->dec_be ? k->dec_be(last, out + bytes, nibble_cnt / 2) : 0;
+	hex = last - done * 2;
+	out += bytes - 1 - done;
+	for (size_t i = done * 2; i < nibble_cnt; i++, hex--) {
 		uint8_t res;
 		if (hex_parse_nibble(hex, &res))
 			break;
@@ -260,3 +667,280 @@ size_t hx2b_BE(const char *hex, uint8_t *out, size_t bytes)
 
 	return nibble_cnt;
 }
+
+
+
+/*	hx_stream_init()
+ * Reset 'hs' for a new stream; 'cols' is bytes per line when encoding
+ * (0: no line breaks).
+ */
+void hx_stream_init(struct hx_stream *hs, size_t cols)
+{
+	*hs = (struct hx_stream){ .cols = cols };
+}
+
+
+/*	hx_stream_enc()
+ * Write 'len' bytes at 'bin' as hex digits to 'hex', breaking lines
+ * every 'cols' bytes (counting from the start of the stream).
+ * Writes at most hx_stream_enc_max() chars; NOT '\0'-terminated.
+ * Returns number of chars written.
+ */
+size_t hx_stream_enc(struct hx_stream *hs, const void *bin, size_t len, char *hex)
+{
+	const unsigned char *b = bin;
+	const struct hx_kernels *k = hx_kernels();
+	size_t hex_pos = 0;
+
+	while (len) {
+		size_t n = len;
+		if (hs->cols && n > hs->cols - hs->col)
+			n = hs->cols - hs->col;
+
+		size_t done = k->enc ? k->enc(b, &hex[hex_pos], n) : 0;
+		hex_pos += done * 2;
+		for (size_t i = done; i < n; i++) {
+			hex[hex_pos++] = syms[b[i] >> 4];
+			hex[hex_pos++] = syms[b[i] & 0xf];
+		}
+		b += n;
+		len -= n;
+
+		if (hs->cols && (hs->col += n) == hs->cols) {
+			hex[hex_pos++] = '\n';
+			hs->col = 0;
+		}
+	}
+	return hex_pos;
+}
+
+
+/*	hx_stream_enc_end()
+ * End the stream: terminate a partial line (if breaking lines).
+ * Returns number of chars written to 'hex' (0 or 1).
+ */
+size_t hx_stream_enc_end(struct hx_stream *hs, char *hex)
+{
+	size_t ret = 0;
+	if (hs->cols && hs->col)
+		hex[ret++] = '\n';
+	hs->col = 0;
+	return ret;
+}
+
+
+/*	hx_stream_dec()
+ * Parse 'len' chars at 'hex' into bytes at 'out' (at least (len + 1) / 2 of them).
+ * Whitespace is skipped; an odd digit is kept for the next call.
+ * Returns number of bytes written;
+ * -1 on a character which is neither hex nor whitespace:
+ * its position in the stream is then 'hs->pos'.
+ */
+ssize_t hx_stream_dec(struct hx_stream *hs, const char *hex, size_t len, uint8_t *out)
+{
+	const struct hx_kernels *k = hx_kernels();
+	size_t i = 0;
+	size_t out_pos = 0;
+
+	while (i < len) {
+		/* runs of digits: whole blocks of pairs, then the remainder */
+		if (!hs->half) {
+			size_t run = k->scan(&hex[i], len - i);
+			size_t pairs = run / 2;
+			/* no pair here: form no pointer before 'hex' */
+			if (pairs) {
+				size_t done = !k->dec_be ? 0
+					: k->dec_be(&hex[i + pairs * 2 - 1], &out[out_pos + pairs], pairs);
+				for (size_t j=0; j < pairs - done; j++) {
+					uint8_t hi = 0, lo = 0;
+					hex_parse_nibble(&hex[i + j * 2], &hi);
+					hex_parse_nibble(&hex[i + j * 2 + 1], &lo);
+					out[out_pos + j] = (hi << 4) | lo;
+				}
+				out_pos += pairs;
+				i += pairs * 2;
+				if (i == len)
+					break;
+			}
+		}
+
+		uint8_t res;
+		switch (hex[i]) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case '\v':
+		case '\f':
+			break;
+		default:
+			if (hex_parse_nibble(&hex[i], &res)) {
+				hs->pos += i;
+				return -1;
+			}
+			if (hs->half)
+				out[out_pos++] = (hs->nibble << 4) | res;
+			else
+				hs->nibble = res;
+			hs->half = !hs->half;
+		}
+		i++;
+	}
+
+	hs->pos += len;
+	return out_pos;
+}
+
+
+/*	hx_stream_dec_end()
+ * End the stream.
+ * Returns 0 on success; 1 if there is a lone digit left over.
+ */
+int hx_stream_dec_end(struct hx_stream *hs)
+{
+	int ret = hs->half;
+	hs->half = false;
+	return ret;
+}
+
+
+
+/* Nibble value of a character; 0x80 if not a hex digit.
+ * A table: tokens are parsed forward, a digit at a time, without branches.
+ */
+#define HX_NIB(c) ((c) >= '0' && (c) <= '9' ? (c) - '0'				\
+		: ((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'f' ? ((c) | 0x20) - 'a' + 10	\
+		: 0x80)
+#define HX_NIB16(i) HX_NIB((i)+0), HX_NIB((i)+1), HX_NIB((i)+2), HX_NIB((i)+3),	\
+	HX_NIB((i)+4), HX_NIB((i)+5), HX_NIB((i)+6), HX_NIB((i)+7),		\
+	HX_NIB((i)+8), HX_NIB((i)+9), HX_NIB((i)+10), HX_NIB((i)+11),		\
+	HX_NIB((i)+12), HX_NIB((i)+13), HX_NIB((i)+14), HX_NIB((i)+15)
+static const uint8_t hx_nib[256] = {
+	HX_NIB16(0), HX_NIB16(16), HX_NIB16(32), HX_NIB16(48),
+	HX_NIB16(64), HX_NIB16(80), HX_NIB16(96), HX_NIB16(112),
+	HX_NIB16(128), HX_NIB16(144), HX_NIB16(160), HX_NIB16(176),
+	HX_NIB16(192), HX_NIB16(208), HX_NIB16(224), HX_NIB16(240)
+};
+
+
+/*	hx_parse_init()
+ * Reset 'hp' to parse a new buffer from the start.
+ * The first 'err_max' token errors are recorded in 'errs' (may be NULL).
+ */
+void hx_parse_init(struct hx_parse *hp, struct hx_tok_err *errs, size_t err_max)
+{
+	*hp = (struct hx_parse){ .errs = errs, .err_max = errs ? err_max : 0 };
+}
+
+
+/*	hx_tok()
+ * Parse the token of 'len' chars at 'tok' (at 'offset' in the buffer),
+ * in one forward pass.
+ * Returns its value; 0 (and records an error) if invalid.
+ */
+static uint64_t hx_tok(struct hx_parse *hp, const char *tok, size_t len, size_t offset)
+{
+	/* prefixes as hex_burn_leading(), without reading past the token */
+	size_t i = 0;
+	if (len > 1 && tok[0] == '0' && (tok[1] == 'x' || tok[1] == 'h'))
+		i = 2;
+	else if (tok[0] == 'x' || tok[0] == 'h')
+		i = 1;
+
+	int code = i == len ? HX_TOK_EMPTY : HX_TOK_OK;
+	uint64_t v = 0;
+	uint8_t bad = 0;
+	uint64_t over = 0;
+	for (; i < len; i++) {
+		uint8_t nib = hx_nib[(uint8_t)tok[i]];
+		bad |= nib;
+		over |= v >> 60;
+		v = v << 4 | (nib & 0xf);
+	}
+	if (bad & 0x80)
+		code = HX_TOK_BAD;
+	else if (over)
+		code = HX_TOK_RANGE;
+
+	if (NLC_UNLIKELY(code != HX_TOK_OK)) {
+		if (hp->err_cnt < hp->err_max) {
+			hp->errs[hp->err_cnt] = (struct hx_tok_err){
+				.index = hp->tokens,
+				.offset = offset,
+				.code = code
+			};
+		}
+		hp->err_cnt++;
+		v = 0;
+	}
+	hp->tokens++;
+	return v;
+}
+
+
+/*	hx_parse_u64()
+ * Parse hex values separated by whitespace and/or commas
+ * (any run of delimiters is one separator) from 'len' chars at 'buf',
+ * e.g. an nmem mapping, into (at most) 'out_max' values at 'out'.
+ * Each value is a token as for hx2b_u64(): '0?[hx]?[0-9a-fA-F]+',
+ * of at most 64 significant bits.
+ *
+ * Parsing starts at 'hp->pos' and leaves it where to continue
+ * when 'out' fills up: 'hp->pos == len' when done.
+ * A bad token is written as 0 and recorded in 'hp' (see struct hx_parse).
+ *
+ * Delimiters are found a vector (64 chars) at a time;
+ * each token is then parsed in one forward pass.
+ *
+ * Returns number of values written.
+ */
+size_t hx_parse_u64(struct hx_parse *hp, const char *buf, size_t len,
+			uint64_t *out, size_t out_max)
+{
+	const struct hx_kernels *k = hx_kernels();
+	size_t p = hp->pos;
+	size_t n = 0;
+
+	while (n < out_max && p < len) {
+		uint64_t d;
+		if (len - p >= 64) {
+			d = k->delims(&buf[p]);
+		} else {
+			/* past the end counts as a delimiter */
+			d = ~0ULL << (len - p);
+			for (size_t i=0; i < len - p; i++)
+				d |= (uint64_t)hx_delim(buf[p + i]) << i;
+		}
+
+		/* all tokens ending in this window */
+		size_t i = 0;
+		while (n < out_max) {
+			uint64_t tok = ~d & (~0ULL << i);
+			if (!tok) {
+				i = 64;
+				break;
+			}
+			size_t start = __builtin_ctzll(tok);
+			uint64_t end = d & (~0ULL << start);
+			if (!end) {
+				i = start;
+				break;
+			}
+			i = __builtin_ctzll(end);
+			out[n++] = hx_tok(hp, &buf[p + start], i - start, p + start);
+		}
+
+		/* a token of 64 chars or more */
+		if (!i) {
+			size_t e = 64;
+			while (p + e < len && !hx_delim(buf[p + e]))
+				e++;
+			out[n++] = hx_tok(hp, &buf[p], e, p);
+			i = e;
+		}
+		p = len - p < i ? len : p + i;
+	}
+
+	hp->pos = p;
+	return n;
+}
@@ -0,0 +1,338 @@
+#include <bloom.h>
+#include <fnv.h>
+#include <nmath.h>
+#include <ndebug.h>
+
+#include <stdlib.h>
+
+
+/* "NLCBLOOM" when stored little-endian; a byte-swapped file will not match */
+#define BLOOM_MAGIC	0x4d4f4f4c42434c4eULL
+#define BLOOM_VERSION	1
+
+/* probes per key */
+#define BLOOM_K_MAX	16
+
+/* cells per block: bits, or (BLOOM_COUNTING) 4-bit counters */
+#define BLOOM_BITS	(BLOOM_BLOCK * 8)
+#define BLOOM_COUNTERS	(BLOOM_BLOCK * 2)
+
+
+/*	bloom_probe
+ * Where a key's cells are: 'k' cells at (h1 + i * h2) within 'block'.
+ * 'h2' is odd and cells per block a power of 2: the k cells are distinct.
+ */
+struct bloom_probe {
+	uint8_t		*block;
+	uint32_t	h1;
+	uint32_t	h2;
+};
+
+
+/*	bloom_mix()
+ * Finalize an FNV hash (murmur3 fmix64) so that all of its bits may be used:
+ * FNV's multiply only carries upwards, leaving the low bits poorly mixed.
+ */
+NLC_INLINE uint64_t bloom_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+/*	bloom_probe()
+ * Derive block and probes from one fnv_hash64() of the key:
+ * the high 32 bits pick the block (multiply-shift, no modulo),
+ * the low bits give the two hashes for double hashing within it.
+ */
+NLC_INLINE struct bloom_probe bloom_probe(const struct bloom *bf,
+						const void *key, size_t key_len)
+{
+	uint64_t h = bloom_mix(fnv_hash64(NULL, key, key_len));
+	uint64_t blk = ((h >> 32) * bf->hdr->blocks) >> 32;
+	return (struct bloom_probe){
+		.block = &bf->blocks[blk * BLOOM_BLOCK],
+		.h1 = h,
+		.h2 = (h >> 12) | 1
+	};
+}
+
+
+/*	bloom_cell_set()
+ * Set (or count up) the cells of probe 'p'.
+ */
+NLC_INLINE void bloom_cell_set(const struct bloom *bf, struct bloom_probe p)
+{
+	uint32_t k = bf->hdr->k;
+	if (bf->hdr->flags & BLOOM_COUNTING) {
+		for (uint32_t i=0; i < k; i++) {
+			uint32_t c = (p.h1 + i * p.h2) % BLOOM_COUNTERS;
+			uint32_t shift = (c & 1) * 4;
+			/* saturate */
+			if (((p.block[c >> 1] >> shift) & 0xf) != 0xf)
+				p.block[c >> 1] += 1 << shift;
+		}
+	} else {
+		for (uint32_t i=0; i < k; i++) {
+			uint32_t c = (p.h1 + i * p.h2) % BLOOM_BITS;
+			p.block[c >> 3] |= 1 << (c & 7);
+		}
+	}
+}
+
+
+/*	bloom_cell_test()
+ * Returns nonzero if all cells of probe 'p' are set (nonzero).
+ */
+NLC_INLINE int bloom_cell_test(const struct bloom *bf, struct bloom_probe p)
+{
+	uint32_t k = bf->hdr->k;
+	if (bf->hdr->flags & BLOOM_COUNTING) {
+		for (uint32_t i=0; i < k; i++) {
+			uint32_t c = (p.h1 + i * p.h2) % BLOOM_COUNTERS;
+			if (!((p.block[c >> 1] >> ((c & 1) * 4)) & 0xf))
+				return 0;
+		}
+	} else {
+		for (uint32_t i=0; i < k; i++) {
+			uint32_t c = (p.h1 + i * p.h2) % BLOOM_BITS;
+			if (!(p.block[c >> 3] & (1 << (c & 7))))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+
+
+/*	bloom_new()
+ * Create an empty filter for 'n' keys at 'bits_per_key' bits (or counters) each.
+ * 'flags' may be BLOOM_COUNTING.
+ * Returns NULL on failure.
+ */
+struct bloom	*bloom_new(size_t n, unsigned bits_per_key, uint32_t flags)
+{
+	struct bloom *ret = NULL;
+	NB_die_if(!bits_per_key, "bits_per_key 0");
+	NB_die_if(flags & ~BLOOM_COUNTING, "flags 0x%"PRIx32, flags);
+
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "calloc %zu", sizeof(*ret));
+	ret->nm.fd = -1;
+
+	/* k = ln(2) * bits per key: the optimum for an unblocked filter */
+	uint32_t k = bits_per_key * 69 / 100;
+	if (k < 1)
+		k = 1;
+	else if (k > BLOOM_K_MAX)
+		k = BLOOM_K_MAX;
+
+	size_t per_block = (flags & BLOOM_COUNTING) ? BLOOM_COUNTERS : BLOOM_BITS;
+	NB_die_if(n > SIZE_MAX / bits_per_key, "%zu keys at %u bits too large", n, bits_per_key);
+	size_t blocks = nm_div_ceil(n * bits_per_key, per_block);
+	if (!blocks)
+		blocks = 1;
+	/* bloom_probe() picks a block from 32 bits */
+	NB_die_if(blocks > UINT32_MAX, "%zu keys at %u bits too large", n, bits_per_key);
+
+	/* memory comes zeroed */
+	size_t len = sizeof(struct bloom_hdr) + blocks * BLOOM_BLOCK;
+	NB_die_if(nmem_alloc(len, NULL, &ret->nm), "");
+	ret->hdr = ret->nm.mem;
+	ret->blocks = ret->nm.mem + sizeof(struct bloom_hdr);
+	*ret->hdr = (struct bloom_hdr){
+		.magic = BLOOM_MAGIC,
+		.version = BLOOM_VERSION,
+		.flags = flags,
+		.k = k,
+		.blocks = blocks
+	};
+
+	return ret;
+die:
+	bloom_free(ret);
+	return NULL;
+}
+
+
+/*	bloom_open()
+ * Map a filter written by bloom_save(), read-only: it can be queried at once
+ * (pages are faulted in from the page cache as they are probed).
+ * Returns NULL on failure.
+ */
+struct bloom	*bloom_open(const char *path)
+{
+	struct bloom *ret = NULL;
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "calloc %zu", sizeof(*ret));
+	ret->nm.fd = -1;
+	ret->readonly = 1;
+
+	NB_die_if(nmem_file(path, &ret->nm), "");
+	NB_die_if(ret->nm.len < sizeof(struct bloom_hdr), "'%s' too short", path);
+	ret->hdr = ret->nm.mem;
+	ret->blocks = ret->nm.mem + sizeof(struct bloom_hdr);
+
+	struct bloom_hdr *hdr = ret->hdr;
+	NB_die_if(hdr->magic != BLOOM_MAGIC, "'%s' not a bloom filter (or byte-swapped)", path);
+	NB_die_if(hdr->version != BLOOM_VERSION, "'%s' version %"PRIu32, path, hdr->version);
+	NB_die_if(hdr->flags & ~BLOOM_COUNTING, "'%s' flags 0x%"PRIx32, path, hdr->flags);
+	NB_die_if(!hdr->k || hdr->k > BLOOM_K_MAX, "'%s' k %"PRIu32, path, hdr->k);
+	NB_die_if(!hdr->blocks || hdr->blocks > UINT32_MAX
+		|| hdr->blocks != (ret->nm.len - sizeof(struct bloom_hdr)) / BLOOM_BLOCK,
+		"'%s' %"PRIu64" blocks in %zu bytes", path, hdr->blocks, ret->nm.len);
+
+	return ret;
+die:
+	bloom_free(ret);
+	return NULL;
+}
+
+
+/*	bloom_save()
+ * Write the filter to 'path' (created or truncated), for bloom_open().
+ * Returns 0 on success.
+ */
+int		bloom_save(const struct bloom *bf, const char *path)
+{
+	int err_cnt = 0;
+	int fd = -1;
+
+	NB_die_if((
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, NMEM_PERMS)
+		) == -1, "open '%s'", path);
+	for (size_t done = 0; done < bf->nm.len; ) {
+		ssize_t ret = write(fd, bf->nm.mem + done, bf->nm.len - done);
+		NB_die_if(ret < 0, "write '%s'", path);
+		done += ret;
+	}
+
+die:
+	if (fd != -1) {
+		NB_err_if(close(fd), "close '%s'", path);
+	}
+	return err_cnt;
+}
+
+
+/*	bloom_free()
+ */
+void		bloom_free(struct bloom *bf)
+{
+	if (!bf)
+		return;
+	nmem_free(&bf->nm, NULL);
+	free(bf);
+}
+
+
+/*	bloom_add()
+ * Returns 0 on success.
+ */
+int		bloom_add(struct bloom *bf, const void *key, size_t key_len)
+{
+	int err_cnt = 0;
+	NB_die_if(bf->readonly, "filter is read-only");
+
+	bloom_cell_set(bf, bloom_probe(bf, key, key_len));
+	bf->hdr->count++;
+die:
+	return err_cnt;
+}
+
+
+/*	bloom_has()
+ * Returns nonzero if 'key' is (probably) present; 0 if it is definitely not.
+ */
+int		bloom_has(const struct bloom *bf, const void *key, size_t key_len)
+{
+	return bloom_cell_test(bf, bloom_probe(bf, key, key_len));
+}
+
+
+/*	bloom_del()
+ * Delete 'key' from a BLOOM_COUNTING filter.
+ * Only delete keys which were added: deleting a false positive
+ * clears cells belonging to other keys.
+ * Returns 0 on success; nonzero if 'key' is not present or the filter
+ * is not counting (or read-only).
+ */
+int		bloom_del(struct bloom *bf, const void *key, size_t key_len)
+{
+	int err_cnt = 0;
+	NB_die_if(bf->readonly, "filter is read-only");
+	NB_die_if(!(bf->hdr->flags & BLOOM_COUNTING), "filter is not counting");
+
+	struct bloom_probe p = bloom_probe(bf, key, key_len);
+	if (!bloom_cell_test(bf, p))
+		return 1;
+
+	for (uint32_t i=0; i < bf->hdr->k; i++) {
+		uint32_t c = (p.h1 + i * p.h2) % BLOOM_COUNTERS;
+		uint32_t shift = (c & 1) * 4;
+		/* a saturated counter no longer knows how many keys set it */
+		if (((p.block[c >> 1] >> shift) & 0xf) != 0xf)
+			p.block[c >> 1] -= 1 << shift;
+	}
+	bf->hdr->count--;
+die:
+	return err_cnt;
+}
+
+
+/*	bloom_add_batch()
+ * Add 'cnt' keys: BLOOM_BATCH at a time, all hashed and their blocks prefetched
+ * before any is written, so that cache misses overlap.
+ * Returns 0 on success.
+ */
+int		bloom_add_batch(struct bloom *bf, const void *const *keys,
+				const size_t *key_lens, size_t cnt)
+{
+	int err_cnt = 0;
+	NB_die_if(bf->readonly, "filter is read-only");
+
+	struct bloom_probe p[BLOOM_BATCH];
+	for (size_t done = 0; done < cnt; ) {
+		size_t run = cnt - done < BLOOM_BATCH ? cnt - done : BLOOM_BATCH;
+		for (size_t i=0; i < run; i++) {
+			p[i] = bloom_probe(bf, keys[done + i], key_lens[done + i]);
+			__builtin_prefetch(p[i].block, 1);
+		}
+		for (size_t i=0; i < run; i++)
+			bloom_cell_set(bf, p[i]);
+		done += run;
+	}
+	bf->hdr->count += cnt;
+die:
+	return err_cnt;
+}
+
+
+/*	bloom_has_batch()
+ * Query 'cnt' keys (as bloom_add_batch() above);
+ * set 'found[i]' to 1 if 'keys[i]' is (probably) present, else 0.
+ * Returns the number of keys (probably) present.
+ */
+size_t		bloom_has_batch(const struct bloom *bf, const void *const *keys,
+				const size_t *key_lens, size_t cnt, uint8_t *found)
+{
+	size_t ret = 0;
+	struct bloom_probe p[BLOOM_BATCH];
+	for (size_t done = 0; done < cnt; ) {
+		size_t run = cnt - done < BLOOM_BATCH ? cnt - done : BLOOM_BATCH;
+		for (size_t i=0; i < run; i++) {
+			p[i] = bloom_probe(bf, keys[done + i], key_lens[done + i]);
+			__builtin_prefetch(p[i].block, 0);
+		}
+		for (size_t i=0; i < run; i++)
+			ret += (found[done + i] = bloom_cell_test(bf, p[i]));
+		done += run;
+	}
+	return ret;
+}
@@ -0,0 +1,363 @@
+#include <cdc.h>
+#include <fnv.h>
+#include <ndebug.h>
+
+
+/* a cdc_next() implementation */
+typedef size_t (*cdc_scan_t)(const struct cdc *cdc, const void *data, size_t len);
+
+
+/*	cdc_gear()
+ * The value added to the hash for 'b': the role of FastCDC's random table,
+ * but computed, so that it can be computed a vector at a time.
+ */
+NLC_INLINE uint32_t cdc_gear(uint32_t b)
+{
+	uint32_t x = (b + 1) * 0x9e3779b1;
+	x ^= x >> 15;
+	return x * 0x85ebca6b;
+}
+
+
+/*	cdc_mask()
+ * The boundary mask at offset 'i' into a chunk.
+ */
+NLC_INLINE uint32_t cdc_mask(const struct cdc *cdc, size_t i)
+{
+	return i < cdc->avg ? cdc->mask_s : cdc->mask_l;
+}
+
+
+
+/*	cdc_init()
+ * Set up chunking into chunks of 'min' to 'max' bytes, 'avg' on average
+ * (rounded down to a power of 2).
+ * 'flags' may be CDC_FNV1A.
+ * Returns 0 on success.
+ */
+int		cdc_init(struct cdc *cdc, size_t min, size_t avg, size_t max,
+			uint32_t flags)
+{
+	int err_cnt = 0;
+	NB_die_if(min < CDC_MIN || min >= avg || avg >= max,
+		"need %d <= min %zu < avg %zu < max %zu", CDC_MIN, min, avg, max);
+	NB_die_if(flags & ~CDC_FNV1A, "flags 0x%"PRIx32, flags);
+
+	unsigned bits = 63 - __builtin_clzll(avg);
+	NB_die_if(bits <= CDC_NORMAL || bits + CDC_NORMAL > 31, "avg %zu", avg);
+
+	*cdc = (struct cdc){
+		.min = min,
+		.avg = avg,
+		.max = max,
+		/* top bits: those depending on the whole window */
+		.mask_s = ~0U << (32 - (bits + CDC_NORMAL)),
+		.mask_l = ~0U << (32 - (bits - CDC_NORMAL)),
+		.flags = flags
+	};
+die:
+	return err_cnt;
+}
+
+
+/*	cdc_next_scalar()
+ * As cdc_next() below, a byte at a time: the reference implementation.
+ */
+size_t		cdc_next_scalar(const struct cdc *cdc, const void *data, size_t len)
+{
+	const uint8_t *d = data;
+	size_t n = len < cdc->max ? len : cdc->max;
+	if (n <= cdc->min)
+		return n;
+
+	/* hash one full window before 'min' */
+	uint32_t h = 0;
+	for (size_t i = cdc->min - 32; i < n; i++) {
+		h = (h << 1) + cdc_gear(d[i]);
+		if (i >= cdc->min && !(h & cdc_mask(cdc, i)))
+			return i + 1;
+	}
+	return n;
+}
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+
+/* Positions hashed at once: one vector of 32-bit hashes.
+ * Without AVX2, shuffling emulated vectors costs more than it saves:
+ * cdc_next() is then the scalar scan.
+ */
+#define CDC_TARGET_AVX2		__attribute__((target("avx2")))
+#define CDC_TARGET_AVX512	__attribute__((target("avx512f")))
+
+typedef uint32_t	cdc_v8 __attribute__((vector_size(32)));
+typedef uint32_t	cdc_v16 __attribute__((vector_size(64)));
+
+
+/*	CDC_KERNEL()
+ * Define cdc_scan_<name>(), the vector cdc_next(), over its block functions:
+ *	cdc_load_<name>(d):		'L' bytes at 'd', widened to 32 bits
+ *	cdc_zeroes_<name>(v):		bitmask of lanes of 'v' which are 0
+ *	cdc_hash_<name>(t, g):		the hashes of 'L' positions whose gear
+ *					values are 'g', from the terms of the
+ *					vectors before them in 't' (updated)
+ *
+ * The hash at position p is the sum of gear(d[p - j]) << j for j in [0, 32).
+ * For 'L' positions at once, it is built by doubling the number of terms:
+ *	T2(p) = T1(p) + (T1(p-1) << 1);  T4(p) = T2(p) + (T2(p-2) << 2); ...
+ * up to T32, keeping the previous vector of each step for the terms
+ * reaching back past the current one.
+ */
+#define CDC_KERNEL(name, L, TARGET)						\
+TARGET static size_t cdc_scan_##name(const struct cdc *cdc,			\
+					const void *data, size_t len)		\
+{										\
+	const uint8_t *d = data;						\
+	size_t n = len < cdc->max ? len : cdc->max;				\
+	if (n <= cdc->min)							\
+		return n;							\
+										\
+	/* Start 48 bytes before 'min': by the first vector checked (at 'min')	\
+	 * every step has a full history, and T32 all of its 32 terms.	\
+	 */									\
+	cdc_v##L t[6] = { { 0 } };						\
+	cdc_v##L t32 = { 0 };							\
+	size_t p = cdc->min - 48;						\
+	for (; p + L <= n; p += L) {						\
+		t32 = cdc_hash_##name(t, cdc_gear_##name(cdc_load_##name(&d[p])));\
+		if (p < cdc->min)						\
+			continue;						\
+										\
+		uint32_t hits;							\
+		if (p + L <= cdc->avg) {					\
+			hits = cdc_zeroes_##name(t32 & cdc->mask_s);		\
+		} else if (p >= cdc->avg) {					\
+			hits = cdc_zeroes_##name(t32 & cdc->mask_l);		\
+		} else {							\
+			/* straddling 'avg' */					\
+			cdc_v##L mask;						\
+			for (int i=0; i < L; i++)				\
+				mask[i] = cdc_mask(cdc, p + i);			\
+			hits = cdc_zeroes_##name(t32 & mask);			\
+		}								\
+		if (hits)							\
+			return p + __builtin_ctz(hits) + 1;			\
+	}									\
+										\
+	/* tail: continue from the hash at the last position */			\
+	uint32_t h = t32[L - 1];						\
+	for (; p < n; p++) {							\
+		h = (h << 1) + cdc_gear(d[p]);					\
+		if (!(h & cdc_mask(cdc, p)))					\
+			return p + 1;						\
+	}									\
+	return n;								\
+}
+
+
+/*	AVX2: 8 positions
+ * T16 reaches back 2 vectors.
+ */
+/* Lanes of 'cur' moved up by 'k' positions, lanes of 'prev' shifted in below:
+ * the values 'k' positions earlier ('k' < 8).
+ */
+#define CDC_BEFORE_AVX2(prev, cur, k) __builtin_shuffle(prev, cur, (cdc_v8){	\
+	8-(k), 9-(k), 10-(k), 11-(k), 12-(k), 13-(k), 14-(k), 15-(k) })
+
+CDC_TARGET_AVX2 static inline cdc_v8 cdc_gear_AVX2(cdc_v8 b)
+{
+	cdc_v8 x = (b + 1) * 0x9e3779b1;
+	x ^= x >> 15;
+	return x * 0x85ebca6b;
+}
+
+CDC_TARGET_AVX2 static inline cdc_v8 cdc_load_AVX2(const uint8_t *d)
+{
+	return (cdc_v8)_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)d));
+}
+
+CDC_TARGET_AVX2 static inline uint32_t cdc_zeroes_AVX2(cdc_v8 v)
+{
+	__m256i z = _mm256_cmpeq_epi32((__m256i)v, _mm256_setzero_si256());
+	return _mm256_movemask_ps(_mm256_castsi256_ps(z));
+}
+
+/* t: T1, T2, T4, T8, T16, and T16 of 2 vectors back */
+CDC_TARGET_AVX2 static inline cdc_v8 cdc_hash_AVX2(cdc_v8 t[6], cdc_v8 g)
+{
+	cdc_v8 n2 = g + (CDC_BEFORE_AVX2(t[0], g, 1) << 1);
+	cdc_v8 n4 = n2 + (CDC_BEFORE_AVX2(t[1], n2, 2) << 2);
+	cdc_v8 n8 = n4 + (CDC_BEFORE_AVX2(t[2], n4, 4) << 4);
+	cdc_v8 n16 = n8 + (t[3] << 8);
+	cdc_v8 t32 = n16 + (t[5] << 16);
+	t[5] = t[4];
+	t[0] = g;
+	t[1] = n2;
+	t[2] = n4;
+	t[3] = n8;
+	t[4] = n16;
+	return t32;
+}
+
+CDC_KERNEL(AVX2, 8, CDC_TARGET_AVX2)
+
+
+/*	AVX-512: 16 positions
+ */
+#define CDC_BEFORE_AVX512(prev, cur, k) __builtin_shuffle(prev, cur, (cdc_v16){\
+	16-(k), 17-(k), 18-(k), 19-(k), 20-(k), 21-(k), 22-(k), 23-(k),		\
+	24-(k), 25-(k), 26-(k), 27-(k), 28-(k), 29-(k), 30-(k), 31-(k) })
+
+CDC_TARGET_AVX512 static inline cdc_v16 cdc_gear_AVX512(cdc_v16 b)
+{
+	cdc_v16 x = (b + 1) * 0x9e3779b1;
+	x ^= x >> 15;
+	return x * 0x85ebca6b;
+}
+
+CDC_TARGET_AVX512 static inline cdc_v16 cdc_load_AVX512(const uint8_t *d)
+{
+	return (cdc_v16)_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)d));
+}
+
+CDC_TARGET_AVX512 static inline uint32_t cdc_zeroes_AVX512(cdc_v16 v)
+{
+	return _mm512_cmpeq_epi32_mask((__m512i)v, _mm512_setzero_si512());
+}
+
+/* t: T1, T2, T4, T8, T16 */
+CDC_TARGET_AVX512 static inline cdc_v16 cdc_hash_AVX512(cdc_v16 t[6], cdc_v16 g)
+{
+	cdc_v16 n2 = g + (CDC_BEFORE_AVX512(t[0], g, 1) << 1);
+	cdc_v16 n4 = n2 + (CDC_BEFORE_AVX512(t[1], n2, 2) << 2);
+	cdc_v16 n8 = n4 + (CDC_BEFORE_AVX512(t[2], n4, 4) << 4);
+	cdc_v16 n16 = n8 + (CDC_BEFORE_AVX512(t[3], n8, 8) << 8);
+	cdc_v16 t32 = n16 + (t[4] << 16);
+	t[0] = g;
+	t[1] = n2;
+	t[2] = n4;
+	t[3] = n8;
+	t[4] = n16;
+	return t32;
+}
+
+CDC_KERNEL(AVX512, 16, CDC_TARGET_AVX512)
+
+
+/*	cdc_best()
+ * The best scan up to 'max' (HX_SCALAR ... HX_AVX512) this CPU supports.
+ */
+static cdc_scan_t cdc_best(unsigned max, unsigned *isa)
+{
+	__builtin_cpu_init();
+	if (max >= HX_AVX512 && __builtin_cpu_supports("avx512f")) {
+		*isa = HX_AVX512;
+		return cdc_scan_AVX512;
+	}
+	if (max >= HX_AVX2 && __builtin_cpu_supports("avx2")) {
+		*isa = HX_AVX2;
+		return cdc_scan_AVX2;
+	}
+	*isa = HX_SCALAR;
+	return cdc_next_scalar;
+}
+
+#else
+static cdc_scan_t cdc_best(unsigned max, unsigned *isa)
+{
+	*isa = HX_SCALAR;
+	return cdc_next_scalar;
+}
+#endif
+
+
+/* scan in use: resolved on first use */
+static cdc_scan_t cdc_scan = NULL;
+
+
+/*	cdc_isa()
+ * Use the best scan up to 'max' (HX_SCALAR, HX_AVX2 or HX_AVX512)
+ * this CPU supports.
+ * Returns the level in use.
+ */
+unsigned	cdc_isa(unsigned max)
+{
+	unsigned isa;
+	__atomic_store_n(&cdc_scan, cdc_best(max, &isa), __ATOMIC_RELAXED);
+	return isa;
+}
+
+
+/*	cdc_next()
+ * Returns the length of the chunk at the start of 'len' bytes at 'data':
+ * 'len' itself if that is less than a full chunk (i.e. end of data).
+ * The vector scans (see CDC_KERNEL()) give the same boundaries as
+ * cdc_next_scalar().
+ */
+size_t		cdc_next(const struct cdc *cdc, const void *data, size_t len)
+{
+	cdc_scan_t scan = __atomic_load_n(&cdc_scan, __ATOMIC_RELAXED);
+	if (NLC_UNLIKELY(!scan)) {
+		unsigned isa;
+		scan = cdc_best(HX_AVX512, &isa);
+		__atomic_store_n(&cdc_scan, scan, __ATOMIC_RELAXED);
+	}
+	return scan(cdc, data, len);
+}
+
+
+/*	cdc_digest()
+ */
+NLC_INLINE uint64_t cdc_digest(const struct cdc *cdc, const void *data, size_t len)
+{
+	if (cdc->flags & CDC_FNV1A)
+		return fnv_hash64(NULL, data, len);
+	return fnv_fast64(data, len);
+}
+
+
+/*	cdc_chunks()
+ * Chunk 'len' bytes at 'data' into (at most) 'out_max' chunks at 'out'.
+ * Returns the number of chunks written: if 'out' fills up, the last chunk
+ * ends where to continue from.
+ */
+size_t		cdc_chunks(const struct cdc *cdc, const void *data, size_t len,
+				struct cdc_chunk *out, size_t out_max)
+{
+	const uint8_t *d = data;
+	size_t cnt = 0;
+	for (size_t off = 0; off < len && cnt < out_max; cnt++) {
+		size_t chunk = cdc_next(cdc, &d[off], len - off);
+		out[cnt] = (struct cdc_chunk){
+			.offset = off,
+			.len = chunk,
+			.digest = cdc_digest(cdc, &d[off], chunk)
+		};
+		off += chunk;
+	}
+	return cnt;
+}
+
+
+/*	cdc_nmem()
+ * Chunk all of 'nm', calling 'emit' for each chunk in order.
+ * Returns 0 when done; or the nonzero value 'emit' returned to stop.
+ */
+int		cdc_nmem(const struct cdc *cdc, const struct nmem *nm,
+			cdc_emit_t emit, void *ctx)
+{
+	const uint8_t *d = nm->mem;
+	for (size_t off = 0; off < nm->len; ) {
+		struct cdc_chunk chunk = {
+			.offset = off,
+			.len = cdc_next(cdc, &d[off], nm->len - off)
+		};
+		chunk.digest = cdc_digest(cdc, &d[off], chunk.len);
+		int ret = emit(&chunk, ctx);
+		if (ret)
+			return ret;
+		off += chunk.len;
+	}
+	return 0;
+}
@@ -0,0 +1,285 @@
+/*	IEEE floats
+Scores must come out bit-identical whatever the build flags (release builds
+	use -Ofast; -march=native may bring FMA): a key must map to the same node
+	on every machine. Only correctly-rounded float operations are used below,
+	and this file is compiled without fast-math and without FMA contraction.
+*/
+#if defined(__clang__)
+	#pragma float_control(precise, on)
+	#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+	#pragma GCC optimize ("no-fast-math", "fp-contract=off")
+#endif
+
+#include <chash.h>
+#include <fnv.h>
+#include <ndebug.h>
+
+#include <float.h> /* FLT_MAX */
+#include <stdbool.h>
+#include <stdlib.h>
+
+
+/* nodes scored together: one vector of floats.
+ * The result does not depend on it (ties go to the lowest index).
+ */
+#if defined(__AVX__)
+	#define CHASH_LANES 8
+#else
+	#define CHASH_LANES 4
+#endif
+
+typedef uint32_t	chash_vu __attribute__((vector_size(CHASH_LANES * 4)));
+typedef int32_t		chash_vi __attribute__((vector_size(CHASH_LANES * 4)));
+typedef float		chash_vf __attribute__((vector_size(CHASH_LANES * 4)));
+
+/* arrays are aligned for vector loads */
+#define CHASH_ALIGN	sizeof(chash_vf)
+
+
+
+/*	chash_jump()
+ * Jump consistent hash: the bucket in [0, buckets) for 'key_hash'.
+ * Going from n to n+1 buckets moves 1/(n+1) of keys, all of them to bucket n.
+ * Returns -1 if 'buckets' < 1.
+ */
+int32_t		chash_jump(uint64_t key_hash, int32_t buckets)
+{
+	int64_t b = -1;
+	int64_t j = 0;
+	while (j < buckets) {
+		b = j;
+		key_hash = key_hash * 2862933555777941757ULL + 1;
+		j = (b + 1) * ((double)(1LL << 31) / (double)((key_hash >> 33) + 1));
+	}
+	return b;
+}
+
+
+
+/*	chash_score()
+ * Score CHASH_LANES nodes for 'key' (lower is better):
+ * -log2(u) / weight, where 'u' in (0,1) is a hash of node seed and key.
+ * This is the "logarithmic method" for weighted rendezvous hashing:
+ * -log(u) is exponentially distributed, so each node wins with a probability
+ * proportional to its weight. A node of weight 0 scores +inf: it never wins.
+ * Dividing is done by multiplying with (precomputed) 1/weight.
+ */
+NLC_INLINE chash_vf chash_score(chash_vu seed, chash_vf inv_weight, uint32_t key)
+{
+	/* mix (lowbias32) */
+	chash_vu x = seed ^ key;
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+
+	/* u = f / 2^24, 'f' odd (never 0): exactly representable */
+	chash_vf f = __builtin_convertvector((chash_vi)((x >> 8) | 1), chash_vf);
+
+	/* log2(f): exponent plus a rational approximation over the mantissa
+	 * (P. Mineiro's "fastlog2"; max error ~1e-4: any monotonic-enough
+	 * approximation does, as long as every build computes the same one)
+	 */
+	chash_vi bits = (chash_vi)f;
+	chash_vf m = (chash_vf)((bits & 0x007fffff) | 0x3f000000);
+	chash_vf lg = __builtin_convertvector(bits, chash_vf) * 1.1920928955078125e-7f
+		- 124.22551499f - 1.498030302f * m - 1.72587999f / (0.3520887068f + m);
+
+	/* -log2(u), kept positive despite approximation error near u == 1 */
+	const chash_vf eps = (chash_vf){ 0 } + 1e-6f;
+	chash_vf e = 24.0f - lg;
+	chash_vi small = e < eps;
+	e = (chash_vf)(((chash_vi)e & ~small) | ((chash_vi)eps & small));
+
+	return e * inv_weight;
+}
+
+
+/*	chash_best()
+ * The node with the lowest score for 'key'; lowest index on a tie.
+ * Returns -1 if no node has a nonzero weight.
+ */
+static ssize_t chash_best(const struct chash *ch, uint32_t key)
+{
+	chash_vf best = { 0 };
+	best += __builtin_inff();
+	chash_vi best_idx = { 0 };
+	best_idx -= 1;
+	chash_vi idx;
+	for (int i=0; i < CHASH_LANES; i++)
+		idx[i] = i;
+
+	/* per lane: the first (lowest index) of equal scores is kept */
+	for (size_t i=0; i < ch->cap; i += CHASH_LANES) {
+		chash_vu seed = *(const chash_vu *)&ch->seed[i];
+		chash_vf inv = *(const chash_vf *)&ch->inv_weight[i];
+		chash_vf score = chash_score(seed, inv, key);
+
+		chash_vi better = score < best;
+		best = (chash_vf)(((chash_vi)score & better) | ((chash_vi)best & ~better));
+		best_idx = (idx & better) | (best_idx & ~better);
+		idx += CHASH_LANES;
+	}
+
+	/* across lanes */
+	float min = best[0];
+	int32_t ret = best_idx[0];
+	for (int i=1; i < CHASH_LANES; i++) {
+		if (best[i] < min || (best[i] == min && (uint32_t)best_idx[i] < (uint32_t)ret)) {
+			min = best[i];
+			ret = best_idx[i];
+		}
+	}
+	if (min == __builtin_inff())
+		return -1;
+	return ret;
+}
+
+
+
+/*	chash_new()
+ * Returns an empty set of nodes, or NULL on failure.
+ */
+struct chash	*chash_new(void)
+{
+	struct chash *ret = NULL;
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "calloc %zu", sizeof(*ret));
+die:
+	return ret;
+}
+
+
+/*	chash_free()
+ */
+void		chash_free(struct chash *ch)
+{
+	if (!ch)
+		return;
+	free(ch->seed);
+	free(ch->weight);
+	free(ch->inv_weight);
+	free(ch->table);
+	free(ch);
+}
+
+
+/*	chash_weight_bad()
+ * Weights are finite, >= 0, and (unless 0) large enough that 1/weight is finite:
+ * an infinite 'inv_weight' is how chash_best() skips a removed node.
+ */
+NLC_INLINE bool chash_weight_bad(float weight)
+{
+	return !(weight >= 0 && weight <= FLT_MAX)
+		|| (weight && !(1.0f / weight <= FLT_MAX));
+}
+
+
+/*	chash_add()
+ * Add a node named by 'id', of 'weight' (relative to other nodes; may be 0).
+ * Nodes with the same ID hash the same: only the first can ever be picked.
+ * Returns the index of the new node, or -1 on failure.
+ */
+ssize_t		chash_add(struct chash *ch, const void *id, size_t id_len, float weight)
+{
+	int err_cnt = 0;
+	uint32_t *seed = NULL;
+	float *wt = NULL;
+	float *inv = NULL;
+	NB_die_if(chash_weight_bad(weight), "weight %g", weight);
+
+	/* grow: padding is weight 0 */
+	if (ch->cnt == ch->cap) {
+		size_t cap = ch->cap ? ch->cap * 2 : CHASH_LANES;
+		NB_die_if(posix_memalign((void **)&seed, CHASH_ALIGN, cap * sizeof(*seed))
+			|| posix_memalign((void **)&wt, CHASH_ALIGN, cap * sizeof(*wt))
+			|| posix_memalign((void **)&inv, CHASH_ALIGN, cap * sizeof(*inv)),
+			"alloc %zu nodes", cap);
+		for (size_t i=0; i < cap; i++) {
+			seed[i] = i < ch->cnt ? ch->seed[i] : 0;
+			wt[i] = i < ch->cnt ? ch->weight[i] : 0;
+			inv[i] = i < ch->cnt ? ch->inv_weight[i] : __builtin_inff();
+		}
+		free(ch->seed);
+		free(ch->weight);
+		free(ch->inv_weight);
+		ch->seed = seed;
+		ch->weight = wt;
+		ch->inv_weight = inv;
+		ch->cap = cap;
+	}
+
+	ch->seed[ch->cnt] = fnv_hash64(NULL, id, id_len) >> 32;
+	ch->weight[ch->cnt] = weight;
+	ch->inv_weight[ch->cnt] = 1.0f / weight;
+	return ch->cnt++;
+die:
+	free(seed);
+	free(wt);
+	free(inv);
+	return -1;
+}
+
+
+/*	chash_weight()
+ * Change the weight of 'node'; 0 removes it (its index stays valid).
+ * Only keys moving to (weight up) or away from (weight down) 'node' change node.
+ * Returns 0 on success.
+ */
+int		chash_weight(struct chash *ch, size_t node, float weight)
+{
+	int err_cnt = 0;
+	NB_die_if(node >= ch->cnt, "node %zu of %zu", node, ch->cnt);
+	NB_die_if(chash_weight_bad(weight), "weight %g", weight);
+	ch->weight[node] = weight;
+	ch->inv_weight[node] = 1.0f / weight;
+die:
+	return err_cnt;
+}
+
+
+/*	chash_hrw()
+ * The node for 'key_hash' by weighted rendezvous hashing.
+ * Returns -1 if no node has a nonzero weight.
+ */
+ssize_t		chash_hrw(const struct chash *ch, uint64_t key_hash)
+{
+	/* FNV's high bits are its best mixed */
+	return chash_best(ch, key_hash >> 32);
+}
+
+
+/*	chash_table()
+ * (Re)build the routing table for chash_route(), of 2^bits slots:
+ * for an even spread, make 'bits' such that there are a few hundred slots per node.
+ * After a membership change, only slots whose rendezvous winner changed
+ * (i.e. moving to or away from the changed nodes) get a different node.
+ * Returns 0 on success; fails if no node has a nonzero weight.
+ */
+int		chash_table(struct chash *ch, unsigned bits)
+{
+	int err_cnt = 0;
+	uint32_t *table = NULL;
+	NB_die_if(bits < 1 || bits > CHASH_BITS_MAX, "bits %u", bits);
+
+	size_t slots = (size_t)1 << bits;
+	NB_die_if(!(
+		table = malloc(slots * sizeof(*table))
+		), "malloc %zu slots", slots);
+	for (size_t i=0; i < slots; i++) {
+		ssize_t node = chash_best(ch, i);
+		NB_die_if(node < 0, "no node with nonzero weight");
+		table[i] = node;
+	}
+
+	free(ch->table);
+	ch->table = table;
+	ch->bits = bits;
+	return 0;
+die:
+	free(table);
+	return err_cnt;
+}
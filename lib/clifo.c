@@ -0,0 +1,151 @@
+#include <clifo.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+
+
+/*	clifo_seg()
+The segment holding node 'idx', and the offset of the node in it:
+	segment 's' holds CLIFO_SEG_BASE << s nodes,
+	starting at index CLIFO_SEG_BASE * (2^s - 1).
+*/
+NLC_INLINE unsigned clifo_seg(uint32_t idx, size_t *offt)
+{
+	uint64_t k = (uint64_t)idx / CLIFO_SEG_BASE + 1;
+	unsigned s = 63 - __builtin_clzll(k);
+	*offt = idx - (uint64_t)CLIFO_SEG_BASE * ((1ULL << s) - 1);
+	return s;
+}
+
+/*	clifo_node()
+*/
+NLC_INLINE struct clifo_node *clifo_node(struct clifo *cl, uint32_t idx)
+{
+	size_t offt;
+	unsigned s = clifo_seg(idx, &offt);
+	return &__atomic_load_n(&cl->seg[s], __ATOMIC_ACQUIRE)[offt];
+}
+
+
+/*	clifo_put()
+Push node 'idx' onto the stack at 'head'.
+*/
+static void clifo_put(struct clifo *cl, uint64_t *head, uint32_t idx)
+{
+	struct clifo_node *n = clifo_node(cl, idx);
+	uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+	uint64_t new;
+	do {
+		__atomic_store_n(&n->next, (uint32_t)old, __ATOMIC_RELAXED);
+		new = ((old >> 32) + 1) << 32 | ((uint64_t)idx + 1);
+	} while (!__atomic_compare_exchange_n(head, &old, new, true,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*	clifo_take()
+Pop a node off the stack at 'head' into 'idx'.
+Returns false if the stack is empty.
+*/
+static bool clifo_take(struct clifo *cl, uint64_t *head, uint32_t *idx)
+{
+	uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+	uint64_t new;
+	do {
+		uint32_t top = (uint32_t)old;
+		if (!top)
+			return false;
+		/* 'top' may be popped (even reused) under us: then the CAS fails */
+		uint32_t next = __atomic_load_n(&clifo_node(cl, top - 1)->next, __ATOMIC_RELAXED);
+		new = ((old >> 32) + 1) << 32 | next;
+	} while (!__atomic_compare_exchange_n(head, &old, new, true,
+					__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+	*idx = (uint32_t)old - 1;
+	return true;
+}
+
+
+/*	clifo_grab()
+Get an unused node: off the free stack, else a new one.
+Returns 0 on success.
+*/
+static int clifo_grab(struct clifo *cl, uint32_t *idx)
+{
+	int err_cnt = 0;
+	if (clifo_take(cl, &cl->free, idx))
+		return 0;
+
+	uint64_t i = __atomic_fetch_add(&cl->alloc, 1, __ATOMIC_RELAXED);
+	NB_die_if(i >= UINT32_MAX, "clifo full: %"PRIu32" nodes", UINT32_MAX);
+
+	/* first node of a segment may not be the first to need it: all check */
+	size_t offt;
+	unsigned s = clifo_seg(i, &offt);
+	if (!__atomic_load_n(&cl->seg[s], __ATOMIC_ACQUIRE)) {
+		struct clifo_node *seg = NULL, *none = NULL;
+		NB_die_if(!(
+			seg = malloc(sizeof(*seg) * ((size_t)CLIFO_SEG_BASE << s))
+			), "malloc segment %u", s);
+		if (!__atomic_compare_exchange_n(&cl->seg[s], &none, seg, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			free(seg);
+	}
+	*idx = i;
+die:
+	return err_cnt;
+}
+
+
+
+/*	clifo_new()
+*/
+struct clifo	*clifo_new()
+{
+	struct clifo *ret = NULL;
+	NB_die_if(!(
+		ret = aligned_alloc(NLC_CACHE_LINE, sizeof(*ret))
+		), "alloc %zu", sizeof(*ret));
+	*ret = (struct clifo){ .top = 0 };
+die:
+	return ret;
+}
+
+
+/*	clifo_free()
+Not thread-safe: nobody else may be using 'cl'.
+*/
+void		clifo_free(struct clifo *cl)
+{
+	if (!cl)
+		return;
+	for (unsigned i=0; i < CLIFO_SEGS; i++)
+		free(cl->seg[i]);
+	free(cl);
+}
+
+
+/*	clifo_push()
+Returns 0 on success; nonzero if out of memory.
+*/
+int		clifo_push(struct clifo *cl, LIFO_MEM_TYPE push_this)
+{
+	uint32_t idx;
+	if (clifo_grab(cl, &idx))
+		return 1;
+	clifo_node(cl, idx)->val = push_this;
+	clifo_put(cl, &cl->top, idx);
+	return 0;
+}
+
+
+/*	clifo_pop()
+Returns 0 on success; nonzero if the stack is empty.
+*/
+int		clifo_pop(struct clifo *cl, LIFO_MEM_TYPE *pop_here)
+{
+	uint32_t idx;
+	if (!clifo_take(cl, &cl->top, &idx))
+		return 1;
+	*pop_here = clifo_node(cl, idx)->val;
+	clifo_put(cl, &cl->free, idx);
+	return 0;
+}
@@ -1,4 +1,6 @@
 #include "fnv.h"
+#include <nlc_endian.h>
+#include <string.h> /* memcpy() */
 
 /*	fnv_hash64()
 Perform, or continue, a 64-bit FNV1A hash.
@@ -14,14 +16,14 @@ If called with NO data to hash, simply returns the initializer ;)
 */
 uint64_t	fnv_hash64(uint64_t *hash, const void *data, size_t data_len)
 {
-	static const uint64_t prime = 1099511628211u;
+	static const uint64_t prime = FNV64_PRIME;
 
 	/* get start state, if NULL then initialize */
 	uint64_t h;
 	if (hash)
 		h = *hash;
 	else
-		h = 14695981039346656037u;
+		h = FNV64_BASIS;
 
 	if (data) {
 		const uint8_t *d = data;
@@ -36,14 +38,14 @@ uint64_t	fnv_hash64(uint64_t *hash, const void *data, size_t data_len)
 
 uint32_t	fnv_hash32(uint32_t *hash, const void *data, size_t data_len)
 {
-	static const uint32_t prime = 16777619u;
+	static const uint32_t prime = FNV32_PRIME;
 
 	/* get start state, if NULL then initialize */
 	uint32_t h;
 	if (hash)
 		h = *hash;
 	else
-		h = 2166136261u;
+		h = FNV32_BASIS;
 
 	if (data) {
 		const uint8_t *d = data;
@@ -62,14 +64,14 @@ uint32_t	fnv_hash32(uint32_t *hash, const void *data, size_t data_len)
  */
 uint16_t	fnv_hash16(uint16_t *hash, const void *data, size_t data_len)
 {
-	static const uint32_t prime = 16777619u;
+	static const uint32_t prime = FNV32_PRIME;
 
 	/* get start state, if NULL then initialize */
 	uint32_t h;
 	if (hash)
 		h = *hash;
 	else
-		h = 2166136261u;
+		h = FNV32_BASIS;
 
 	if (data) {
 		const uint8_t *d = data;
@@ -83,3 +85,397 @@ uint16_t	fnv_hash16(uint16_t *hash, const void *data, size_t data_len)
 	h = (h >> 16) ^ (h & 0xffff);
 	return h;
 }
+
+
+#ifdef __SIZEOF_INT128__
+/*	fnv_hash128()
+ * Perform, or continue, a 128-bit FNV1a hash; exactly as fnv_hash64() above.
+ *
+ * A general 128x128-bit multiply is 3 64-bit multiplies plus adds.
+ * The prime however is 2^88 + FNV128_PRIME_LO, so:
+ *	h * prime == (h << 88) + h * FNV128_PRIME_LO
+ * where (h << 88) only involves the low 40 bits of 'h' (shifted into the high word)
+ * and the second term is one widening multiply of the low word
+ * plus one plain multiply of the high word (independent of each other).
+ * This keeps the per-byte dependency chain to a single multiply, as for 64-bit.
+ */
+fnv128_t	fnv_hash128(fnv128_t *hash, const void *data, size_t data_len)
+{
+	/* get start state, if NULL then initialize */
+	uint64_t lo, hi;
+	if (hash) {
+		lo = *hash;
+		hi = *hash >> 64;
+	} else {
+		lo = FNV128_BASIS_LO;
+		hi = FNV128_BASIS_HI;
+	}
+
+	/* Keep the multiplier opaque to the compiler: otherwise 'hi * 0x13b'
+	 * is strength-reduced into a lea/shl/sub sequence,
+	 * which costs more uops than one imul and is measurably slower.
+	 */
+	uint64_t prime_lo = FNV128_PRIME_LO;
+#ifdef __GNUC__
+	__asm__("" : "+r"(prime_lo));
+#endif
+
+	if (data) {
+		const uint8_t *d = data;
+
+		/* hash the things! */
+		#pragma GCC unroll 4
+		for (size_t i=0; i < data_len; i++) {
+			lo ^= d[i];
+			fnv128_t low = (fnv128_t)lo * prime_lo;
+			/* sum the terms derived from 'lo' first: only the last add
+			 * sits on the high word's loop-carried chain
+			 */
+			hi = hi * prime_lo + ((uint64_t)(low >> 64) + (lo << 24));
+			lo = low;
+		}
+	}
+
+	return (fnv128_t)hi << 64 | lo;
+}
+#endif
+
+
+
+
+/*	NO_SLP
+ * The lane loops below are deliberately scalar: each lane is an independent
+ * multiply chain, and scalar multiplies (3 cycles latency, 1/cycle throughput)
+ * keep FNV_BATCH_LANES chains in flight.
+ * Vector multiplies are a poor fit: AVX2 has no 64-bit multiply at all and
+ * AVX-512 'vpmullq'/'vpmulld' cost 10-15 cycles latency;
+ * measured, both are slower than interleaved scalar lanes.
+ * Keep GCC from SLP-vectorizing the lanes back into vector multiplies.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+	#define NO_SLP __attribute__((optimize("no-tree-slp-vectorize")))
+#else
+	#define NO_SLP
+#endif
+
+
+/*	fnv64_lanes()
+ * Hash FNV_BATCH_LANES keys 'd[l]' of 'len[l]' bytes in lock-step, into 'h[l]'.
+ * 'min' and 'max' are the shortest and longest of 'len'.
+ *
+ * All lanes are hashed together up to 'min';
+ * from there until 'max' lanes which have run out of bytes are masked off
+ * (branch-free, so that key lengths don't cause mispredictions).
+ */
+static NO_SLP void fnv64_lanes(uint64_t *h, const void *const *d, const size_t *len,
+				size_t min, size_t max)
+{
+	static const uint64_t prime = FNV64_PRIME;
+	static const uint8_t pad = 0;
+
+	/* NOTE: work on local copies:
+	 * a byte load may alias anything, including the caller's arrays,
+	 * which would otherwise force a store and reload on every byte.
+	 */
+	uint64_t x[FNV_BATCH_LANES];
+	const uint8_t *p[FNV_BATCH_LANES];
+	size_t n[FNV_BATCH_LANES];
+	for (int l=0; l < FNV_BATCH_LANES; l++) {
+		x[l] = FNV64_BASIS;
+		p[l] = d[l];
+		n[l] = len[l];
+	}
+
+	size_t j = 0;
+	for (; j < min; j++) {
+		#pragma GCC unroll 8
+		for (int l=0; l < FNV_BATCH_LANES; l++)
+			x[l] = (p[l][j] ^ x[l]) * prime;
+	}
+	for (; j < max; j++) {
+		#pragma GCC unroll 8
+		for (int l=0; l < FNV_BATCH_LANES; l++) {
+			int in = j < n[l];
+			const uint8_t *b = in ? &p[l][j] : &pad;
+			uint64_t next = (*b ^ x[l]) * prime;
+			x[l] = in ? next : x[l];
+		}
+	}
+
+	for (int l=0; l < FNV_BATCH_LANES; l++)
+		h[l] = x[l];
+}
+
+
+/*	fnv_hash64_batch()
+ * Hash each of 'cnt' keys from basis into 'hash[i]'.
+ *
+ * Keys are taken in groups of FNV_BATCH_LANES and hashed in lock-step;
+ * less than a full group left over is hashed one key at a time.
+ * Batching pays off most when the keys in a group have similar lengths:
+ * the work for a group is proportional to its longest key.
+ */
+void		fnv_hash64_batch(uint64_t *hash, const void *const *data,
+				const size_t *data_len, size_t cnt)
+{
+	size_t i = 0;
+	for (; i + FNV_BATCH_LANES <= cnt; i += FNV_BATCH_LANES) {
+		size_t min = data_len[i];
+		size_t max = data_len[i];
+		for (int l=1; l < FNV_BATCH_LANES; l++) {
+			if (data_len[i+l] < min)
+				min = data_len[i+l];
+			if (data_len[i+l] > max)
+				max = data_len[i+l];
+		}
+		fnv64_lanes(&hash[i], &data[i], &data_len[i], min, max);
+	}
+
+	for (; i < cnt; i++)
+		hash[i] = fnv_hash64(NULL, data[i], data_len[i]);
+}
+
+
+/*	fnv32_lanes()
+ * 32-bit analogue of fnv64_lanes() above.
+ */
+static NO_SLP void fnv32_lanes(uint32_t *h, const void *const *d, const size_t *len,
+				size_t min, size_t max)
+{
+	static const uint32_t prime = FNV32_PRIME;
+	static const uint8_t pad = 0;
+
+	uint32_t x[FNV_BATCH_LANES];
+	const uint8_t *p[FNV_BATCH_LANES];
+	size_t n[FNV_BATCH_LANES];
+	for (int l=0; l < FNV_BATCH_LANES; l++) {
+		x[l] = FNV32_BASIS;
+		p[l] = d[l];
+		n[l] = len[l];
+	}
+
+	size_t j = 0;
+	for (; j < min; j++) {
+		#pragma GCC unroll 8
+		for (int l=0; l < FNV_BATCH_LANES; l++)
+			x[l] = (p[l][j] ^ x[l]) * prime;
+	}
+	for (; j < max; j++) {
+		#pragma GCC unroll 8
+		for (int l=0; l < FNV_BATCH_LANES; l++) {
+			int in = j < n[l];
+			const uint8_t *b = in ? &p[l][j] : &pad;
+			uint32_t next = (*b ^ x[l]) * prime;
+			x[l] = in ? next : x[l];
+		}
+	}
+
+	for (int l=0; l < FNV_BATCH_LANES; l++)
+		h[l] = x[l];
+}
+
+
+/*	fnv_hash32_batch()
+ * 32-bit analogue of fnv_hash64_batch() above.
+ */
+void		fnv_hash32_batch(uint32_t *hash, const void *const *data,
+				const size_t *data_len, size_t cnt)
+{
+	size_t i = 0;
+	for (; i + FNV_BATCH_LANES <= cnt; i += FNV_BATCH_LANES) {
+		size_t min = data_len[i];
+		size_t max = data_len[i];
+		for (int l=1; l < FNV_BATCH_LANES; l++) {
+			if (data_len[i+l] < min)
+				min = data_len[i+l];
+			if (data_len[i+l] > max)
+				max = data_len[i+l];
+		}
+		fnv32_lanes(&hash[i], &data[i], &data_len[i], min, max);
+	}
+
+	for (; i < cnt; i++)
+		hash[i] = fnv_hash32(NULL, data[i], data_len[i]);
+}
+
+
+
+/*	fnv_tree_leaves()
+ * Returns the number of leaves of 'leaf_len' bytes which make up 'data_len' bytes
+ * (never 0: empty input is a single, empty leaf).
+ *
+ * In all fnv_tree_ functions, a 'leaf_len' of 0 means FNV_TREE_LEAF.
+ */
+size_t		fnv_tree_leaves(size_t data_len, size_t leaf_len)
+{
+	if (!leaf_len)
+		leaf_len = FNV_TREE_LEAF;
+	if (!data_len)
+		return 1;
+	return (data_len + leaf_len - 1) / leaf_len;
+}
+
+
+/*	fnv_tree_leaf64()
+ * Hash 'cnt' leaves starting from leaf index 'first', writing each digest to
+ * 'digests[leaf_index - first]'.
+ * 'data', 'data_len' and 'leaf_len' are always those of the WHOLE input:
+ * a caller working in parallel hands each worker a different 'first' and 'cnt'.
+ */
+void		fnv_tree_leaf64(const void *data, size_t data_len, size_t leaf_len,
+				size_t first, size_t cnt, uint64_t *digests)
+{
+	const uint8_t *d = data;
+	if (!leaf_len)
+		leaf_len = FNV_TREE_LEAF;
+
+	for (size_t i=0; i < cnt; i++) {
+		size_t offt = (first + i) * leaf_len;
+		/* past the last leaf: an empty one */
+		if (offt >= data_len) {
+			digests[i] = fnv_hash64(NULL, NULL, 0);
+			continue;
+		}
+		size_t len = data_len - offt < leaf_len ? data_len - offt : leaf_len;
+		digests[i] = fnv_hash64(NULL, d + offt, len);
+	}
+}
+
+
+/*	fnv_tree_root64()
+ * Fold 'cnt' leaf digests into the root of a tree hash.
+ * As with fnv_hash64(): if 'root' is NULL start from basis,
+ * otherwise continue from '*root' (digests may be folded in as they arrive).
+ */
+uint64_t	fnv_tree_root64(uint64_t *root, const uint64_t *digests, size_t cnt)
+{
+	uint64_t h = fnv_hash64(root, NULL, 0);
+	for (size_t i=0; i < cnt; i++) {
+		uint64_t le = h64tole(digests[i]);
+		h = fnv_hash64(&h, &le, sizeof(le));
+	}
+	return h;
+}
+
+
+/*	fnv_tree_hash64()
+ * Single-threaded tree hash of 'data'.
+ *
+ * Leaves are hashed and folded into the root one at a time,
+ * so no memory is allocated.
+ */
+uint64_t	fnv_tree_hash64(const void *data, size_t data_len, size_t leaf_len)
+{
+	uint64_t h = fnv_hash64(NULL, NULL, 0);
+	size_t leaves = fnv_tree_leaves(data_len, leaf_len);
+	for (size_t i=0; i < leaves; i++) {
+		uint64_t digest;
+		fnv_tree_leaf64(data, data_len, leaf_len, i, 1, &digest);
+		h = fnv_tree_root64(&h, &digest, 1);
+	}
+	return h;
+}
+
+
+
+/*	fnv_fast64_stripes()
+ * Hash 'cnt' whole stripes at 'data' into 'lane'.
+ * Lanes are kept in locals so that loads cannot alias them.
+ */
+static NO_SLP void fnv_fast64_stripes(uint64_t *lane, const uint8_t *data, size_t cnt)
+{
+	uint64_t h[FNV_FAST_LANES];
+	for (int i=0; i < FNV_FAST_LANES; i++)
+		h[i] = lane[i];
+
+	for (size_t j=0; j < cnt; j++, data += FNV_FAST_STRIPE) {
+		#pragma GCC unroll 8
+		for (int i=0; i < FNV_FAST_LANES; i++) {
+			uint64_t w;
+			memcpy(&w, &data[i * sizeof(w)], sizeof(w));
+			h[i] = (h[i] ^ le64toh(w)) * FNV64_PRIME;
+			h[i] = (h[i] << FNV_FAST_ROT) | (h[i] >> (64 - FNV_FAST_ROT));
+		}
+	}
+
+	for (int i=0; i < FNV_FAST_LANES; i++)
+		lane[i] = h[i];
+}
+
+
+/*	fnv_fast64_init()
+ */
+void		fnv_fast64_init(struct fnv_fast64_state *state)
+{
+	for (int i=0; i < FNV_FAST_LANES; i++)
+		state->lane[i] = FNV64_BASIS ^ i;
+	state->buf_len = 0;
+	state->total = 0;
+}
+
+
+/*	fnv_fast64_update()
+ * Hash 'data_len' more bytes at 'data'.
+ * Only bytes short of a whole stripe are buffered.
+ */
+void		fnv_fast64_update(struct fnv_fast64_state *state,
+				const void *data, size_t data_len)
+{
+	/* nothing to do: 'data' may be NULL */
+	if (!data_len)
+		return;
+	const uint8_t *d = data;
+	state->total += data_len;
+
+	/* top up a partial stripe */
+	if (state->buf_len) {
+		size_t take = FNV_FAST_STRIPE - state->buf_len;
+		if (take > data_len)
+			take = data_len;
+		memcpy(&state->buf[state->buf_len], d, take);
+		state->buf_len += take;
+		d += take;
+		data_len -= take;
+		if (state->buf_len < FNV_FAST_STRIPE)
+			return;
+		fnv_fast64_stripes(state->lane, state->buf, 1);
+		state->buf_len = 0;
+	}
+
+	size_t cnt = data_len / FNV_FAST_STRIPE;
+	fnv_fast64_stripes(state->lane, d, cnt);
+	d += cnt * FNV_FAST_STRIPE;
+	data_len -= cnt * FNV_FAST_STRIPE;
+
+	memcpy(state->buf, d, data_len);
+	state->buf_len = data_len;
+}
+
+
+/*	fnv_fast64_final()
+ * Return the hash of everything fed so far.
+ * Does not modify 'state': more data may still be fed afterwards.
+ */
+uint64_t	fnv_fast64_final(const struct fnv_fast64_state *state)
+{
+	uint64_t h = fnv_hash64(NULL, NULL, 0);
+	for (int i=0; i < FNV_FAST_LANES; i++) {
+		uint64_t le = h64tole(state->lane[i]);
+		h = fnv_hash64(&h, &le, sizeof(le));
+	}
+	h = fnv_hash64(&h, state->buf, state->buf_len);
+	uint64_t len = h64tole(state->total);
+	return fnv_hash64(&h, &len, sizeof(len));
+}
+
+
+/*	fnv_fast64()
+ * One-shot fnv_fast64_*() over 'data'.
+ */
+uint64_t	fnv_fast64(const void *data, size_t data_len)
+{
+	struct fnv_fast64_state state;
+	fnv_fast64_init(&state);
+	fnv_fast64_update(&state, data, data_len);
+	return fnv_fast64_final(&state);
+}
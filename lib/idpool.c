@@ -0,0 +1,144 @@
+#include <idpool.h>
+#include <stdlib.h>
+
+
+
+/*	idpool_new()
+IDs are [0, max): 'max' may be at most 2^32.
+*/
+struct idpool	*idpool_new(size_t max)
+{
+	struct idpool *ret = NULL;
+	NB_die_if(!max || max > (size_t)UINT32_MAX + 1, "idpool of %zu IDs", max);
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "alloc %zu", sizeof(*ret));
+
+	ret->max = max;
+	ret->words = (max + 63) >> 6;
+	size_t words1 = (ret->words + 63) >> 6;
+	size_t words2 = (words1 + 63) >> 6;
+	NB_die_if(!(ret->list = idpool_list_new()), "");
+	NB_die_if(!(ret->used = calloc(ret->words, sizeof(uint64_t)))
+		|| !(ret->nonempty = calloc(words1, sizeof(uint64_t)))
+		|| !(ret->nonfull = calloc(words1, sizeof(uint64_t)))
+		|| !(ret->nonfull2 = calloc(words2, sizeof(uint64_t))),
+		"bitmap for %zu IDs", max);
+
+	/* every word has a free ID */
+	for (size_t i=0; i < ret->words; i++)
+		ret->nonfull[i >> 6] |= 1ULL << (i & 63);
+	for (size_t i=0; i < words1; i++)
+		ret->nonfull2[i >> 6] |= 1ULL << (i & 63);
+
+	/* bits past 'max' are allocated forever: never found free */
+	if (max & 63) {
+		size_t w = ret->words - 1;
+		ret->used[w] = UINT64_MAX << (max & 63);
+		ret->nonempty[w >> 6] |= 1ULL << (w & 63);
+	}
+	return ret;
+die:
+	idpool_free(ret);
+	return NULL;
+}
+
+
+/*	idpool_free()
+*/
+void		idpool_free(struct idpool *ip)
+{
+	if (!ip)
+		return;
+	idpool_list_free(ip->list);
+	free(ip->used);
+	free(ip->nonempty);
+	free(ip->nonfull);
+	free(ip->nonfull2);
+	free(ip);
+}
+
+
+/*	idpool_alloc_low()
+Allocate the lowest free ID.
+Empties the free-list (which may hold that ID): idpool_alloc() will then
+	also hand out lowest IDs, until some are released.
+Returns 0 on success; nonzero if all IDs are allocated.
+*/
+int		idpool_alloc_low(struct idpool *ip, uint32_t *id)
+{
+	ip->list->next = 0;
+
+	size_t words2 = (((ip->words + 63) >> 6) + 63) >> 6;
+	for (size_t i=ip->hint2; i < words2; i++) {
+		if (!ip->nonfull2[i])
+			continue;
+		ip->hint2 = i;
+		size_t w1 = (i << 6) + __builtin_ctzll(ip->nonfull2[i]);
+		size_t w = (w1 << 6) + __builtin_ctzll(ip->nonfull[w1]);
+		*id = (w << 6) + __builtin_ctzll(~ip->used[w]);
+		idpool_mark(ip, *id);
+		return 0;
+	}
+	ip->hint2 = words2;
+	return 1;
+}
+
+
+/*	idpool_release()
+Returns 0 on success; nonzero if 'id' is not allocated (e.g. released twice).
+*/
+int		idpool_release(struct idpool *ip, uint32_t id)
+{
+	int err_cnt = 0;
+	NB_die_if(!idpool_is_alloc(ip, id), "ID %"PRIu32" not allocated", id);
+
+	size_t w = id >> 6;
+	if (ip->used[w] == UINT64_MAX) {
+		ip->nonfull[w >> 6] |= 1ULL << (w & 63);
+		ip->nonfull2[w >> 12] |= 1ULL << ((w >> 6) & 63);
+		if (ip->hint2 > w >> 12)
+			ip->hint2 = w >> 12;
+	}
+	ip->used[w] &= ~(1ULL << (id & 63));
+	if (!ip->used[w])
+		ip->nonempty[w >> 6] &= ~(1ULL << (w & 63));
+	ip->count--;
+
+	/* past IDPOOL_LIST_MAX (or out of memory) the bitmap alone has it */
+	if (ip->list->next < IDPOOL_LIST_MAX)
+		idpool_list_push(&ip->list, id);
+die:
+	return err_cnt;
+}
+
+
+/*	idpool_next()
+The first allocated ID >= 'from'; IDPOOL_NONE if none.
+*/
+size_t		idpool_next(const struct idpool *ip, size_t from)
+{
+	if (from >= ip->max)
+		return IDPOOL_NONE;
+
+	size_t w = from >> 6;
+	uint64_t m = ip->used[w] & (UINT64_MAX << (from & 63));
+	if (!m) {
+		/* next word with anything allocated */
+		size_t words1 = (ip->words + 63) >> 6;
+		size_t w1 = (w + 1) >> 6;
+		if (w1 >= words1)
+			return IDPOOL_NONE;
+		uint64_t n = ip->nonempty[w1] & (UINT64_MAX << ((w + 1) & 63));
+		while (!n) {
+			if (++w1 >= words1)
+				return IDPOOL_NONE;
+			n = ip->nonempty[w1];
+		}
+		w = (w1 << 6) + __builtin_ctzll(n);
+		m = ip->used[w];
+	}
+
+	size_t id = (w << 6) + __builtin_ctzll(m);
+	return id < ip->max ? id : IDPOOL_NONE;
+}
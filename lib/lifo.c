@@ -2,6 +2,16 @@
 
 
 
+/*	lifo_step()
+How much 'stk' grows by: a reserved stack commits whole pages.
+*/
+static inline size_t lifo_step(const struct lifo *stk)
+{
+	return stk->mem_max ? LIFO_RESERVE_GROW : LIFO_GROW;
+}
+
+
+
 /*	lifo_new()
 */
 struct lifo	*lifo_new()
@@ -19,9 +29,44 @@ struct lifo	*lifo_new()
 
 	ret->next = 0;
 	ret->mem_len = LIFO_GROW - sizeof(struct lifo);
-
+	ret->mem_max = 0;
+	return ret;
 die:
+	return NULL;
+}
+
+
+/*	lifo_new_reserved()
+A stack which never moves, and never holds more than 'max' Bytes of IDs
+	(rounded up to whole LIFO_RESERVE_GROW steps): see "mmap" in lifo.h.
+Where address space cannot be reserved, the same as lifo_new().
+*/
+struct lifo	*lifo_new_reserved(size_t max)
+{
+#ifdef LIFO_HAVE_RESERVE
+	struct lifo *ret = NULL;
+	NB_die_if(!max || max > SIZE_MAX / 2, "reserve %zu", max);
+	size_t len = (max + sizeof(struct lifo) + LIFO_RESERVE_GROW - 1)
+		/ LIFO_RESERVE_GROW * LIFO_RESERVE_GROW;
+
+	NB_die_if((
+		ret = mmap(NULL, len, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)
+		) == MAP_FAILED, "reserve %zu fail", len);
+	if (mprotect(ret, LIFO_RESERVE_GROW, PROT_READ | PROT_WRITE)) {
+		munmap(ret, len);
+		NB_die("mprotect %d fail", LIFO_RESERVE_GROW);
+	}
+
+	ret->next = 0;
+	ret->mem_len = LIFO_RESERVE_GROW - sizeof(struct lifo);
+	ret->mem_max = len - sizeof(struct lifo);
 	return ret;
+die:
+	return NULL;
+#else
+	return lifo_new();
+#endif
 }
 
 
@@ -30,9 +75,16 @@ die:
 */
 void		lifo_free(struct lifo *stk)
 {
+	if (!stk)
+		return;
+#ifdef LIFO_HAVE_RESERVE
+	if (stk->mem_max) {
+		munmap(stk, stk->mem_max + sizeof(struct lifo));
+		return;
+	}
+#endif
 #ifdef LIFO_MMAP_FLAGS
-	if (stk && stk != MAP_FAILED)
-		munmap(stk, stk->mem_len + sizeof(stk));
+	munmap(stk, stk->mem_len + sizeof(struct lifo));
 #else
 	free(stk);
 #endif
@@ -41,23 +93,181 @@ void		lifo_free(struct lifo *stk)
 
 
 /*	lifo_extend()
+A reserved stack commits the next LIFO_RESERVE_GROW bytes of its range:
+	'stk' does not move.
+Returns the (possibly moved) stack, or NULL if it cannot grow:
+	'stk' is then still valid, and unchanged.
 */
 struct lifo	*lifo_extend(struct lifo *stk)
 {
-	stk->mem_len += LIFO_GROW;
+	struct lifo *ret = NULL;
+	size_t total = stk->mem_len + sizeof(struct lifo);
+
+#ifdef LIFO_HAVE_RESERVE
+	if (stk->mem_max) {
+		NB_die_if(stk->mem_len + LIFO_RESERVE_GROW > stk->mem_max,
+			"lifo reserve of %zu exhausted", stk->mem_max);
+		NB_die_if(mprotect((char *)stk + total, LIFO_RESERVE_GROW,
+				PROT_READ | PROT_WRITE),
+			"mprotect to %zu", total + LIFO_RESERVE_GROW);
+		stk->mem_len += LIFO_RESERVE_GROW;
+		return stk;
+	}
+#endif
+
+#ifdef LIFO_MMAP_FLAGS
+	NB_die_if((
+		ret = mremap(stk, total, total + LIFO_GROW, MREMAP_MAYMOVE)
+		) == MAP_FAILED, "mremap to %zu", total + LIFO_GROW);
+#else
+	NB_die_if(!(
+		ret = realloc(stk, total + LIFO_GROW)
+		), "realloc to %zu", total + LIFO_GROW);
+#endif
+	ret->mem_len += LIFO_GROW;
+	return ret;
+die:
+	return NULL;
+}
+
+
+
+/*	lifo_reserve_sz()
+Make room for at least 'cnt' more IDs of 'size' Bytes each, growing (at most)
+	once: to the first multiple of LIFO_GROW that fits them.
+May move the stack, unless it is reserved (see lifo_new_reserved()).
+Returns 0 on success.
+*/
+int		lifo_reserve_sz(struct lifo **stk, size_t cnt, size_t size)
+{
+	int err_cnt = 0;
+	struct lifo *sk = *stk;
+	size_t step = lifo_step(sk);
+	NB_die_if(cnt > (SIZE_MAX - sizeof(struct lifo) - step) / size - sk->next,
+		"lifo_reserve %zu overflows", cnt);
+
+	size_t need = (sk->next + cnt) * size;
+	if (need <= sk->mem_len)
+		return 0;
 
+	size_t total = sk->mem_len + sizeof(struct lifo);
+	size_t want = (need + sizeof(struct lifo) + step - 1) / step * step;
+
+#ifdef LIFO_HAVE_RESERVE
+	if (sk->mem_max) {
+		NB_die_if(want - sizeof(struct lifo) > sk->mem_max,
+			"lifo reserve of %zu exhausted", sk->mem_max);
+		NB_die_if(mprotect((char *)sk + total, want - total, PROT_READ | PROT_WRITE),
+			"mprotect to %zu", want);
+		sk->mem_len = want - sizeof(struct lifo);
+		return 0;
+	}
+#endif
 #ifdef LIFO_MMAP_FLAGS
 	NB_die_if((
-		stk = mremap(stk, stk->mem_len - LIFO_GROW + sizeof(struct lifo),
-				stk->mem_len + sizeof(struct lifo),
-				MREMAP_MAYMOVE)
-		) == MAP_FAILED,
-		"mremap to %zu", stk->mem_len + sizeof(struct lifo));
+		sk = mremap(sk, total, want, MREMAP_MAYMOVE)
+		) == MAP_FAILED, "mremap to %zu", want);
 #else
-	NB_die_if(!(stk = realloc(stk, stk->mem_len + sizeof(struct lifo))),
-		"realloc to %zu", stk->mem_len + sizeof(struct lifo));
+	NB_die_if(!(
+		sk = realloc(sk, want)
+		), "realloc to %zu", want);
 #endif
+	sk->mem_len = want - sizeof(struct lifo);
+	*stk = sk;
+die:
+	return err_cnt;
+}
+
+
+
+/*	lifo_reserve()
+*/
+int		lifo_reserve(struct lifo **stk, size_t cnt)
+{
+	return lifo_reserve_sz(stk, cnt, sizeof(LIFO_MEM_TYPE));
+}
+
+
+
+/*	lifo_trim_sz()
+Opt-in memory return: call now and then (never called by push/pop).
+If the stack is below 1/LIFO_TRIM_RATIO of its high-water mark,
+	give back everything beyond twice what is in use (whole growth steps):
+	madvise() the tail of a reserved range; otherwise shrink the mapping
+	(or allocation), which may move it.
+Returns number of bytes given back (0 if none).
+*/
+size_t		lifo_trim_sz(struct lifo **stk, size_t size)
+{
+	struct lifo *sk = *stk;
+	size_t used = sk->next * size;
+	if (used >= sk->mem_len / LIFO_TRIM_RATIO)
+		return 0;
 
+	size_t total = sk->mem_len + sizeof(struct lifo);
+	size_t step = lifo_step(sk);
+	size_t keep = (used * 2 + sizeof(struct lifo) + step - 1) / step * step;
+	if (keep >= total)
+		return 0;
+
+#ifdef LIFO_HAVE_RESERVE
+	if (sk->mem_max) {
+		/* still committed: lifo_extend() will only have to mprotect() again */
+		NB_die_if(madvise((char *)sk + keep, total - keep, LIFO_MADVISE),
+			"madvise %zu", total - keep);
+		sk->mem_len = keep - sizeof(struct lifo);
+		return total - keep;
+	}
+#endif
+#ifdef LIFO_MMAP_FLAGS
+	NB_die_if((
+		sk = mremap(sk, total, keep, 0)
+		) == MAP_FAILED, "mremap to %zu", keep);
+#else
+	NB_die_if(!(
+		sk = realloc(sk, keep)
+		), "realloc to %zu", keep);
+#endif
+	sk->mem_len = keep - sizeof(struct lifo);
+	*stk = sk;
+	return total - keep;
 die:
-	return stk;
+	return 0;
+}
+
+/*	lifo_trim()
+*/
+size_t		lifo_trim(struct lifo **stk)
+{
+	return lifo_trim_sz(stk, sizeof(LIFO_MEM_TYPE));
+}
+
+
+/*	lifo_rss()
+Bytes of the stack resident in memory, for monitoring.
+Where mincore() cannot tell, the memory held.
+*/
+size_t		lifo_rss(const struct lifo *stk)
+{
+	size_t total = stk->mem_len + sizeof(struct lifo);
+#ifdef LIFO_HAVE_RESERVE
+#ifndef LIFO_MMAP_FLAGS
+	/* malloc()ed: not page-aligned */
+	if (!stk->mem_max)
+		return total;
+#endif
+	size_t page = sysconf(_SC_PAGESIZE);
+	unsigned char vec[1024];
+	size_t rss = 0;
+	for (size_t off = 0; off < total; off += page * sizeof(vec)) {
+		size_t len = total - off < page * sizeof(vec) ? total - off : page * sizeof(vec);
+		if (mincore((char *)stk + off, len, (void *)vec))
+			return total;
+		for (size_t i=0; i < (len + page - 1) / page; i++)
+			rss += (vec[i] & 0x1) * page;
+	}
+	return rss;
+#else
+	return total;
+#endif
 }
@@ -0,0 +1,194 @@
+#include <mag.h>
+#include <stdlib.h>
+
+/* the depot keeps magazines (pointers) on clifo stacks */
+NLC_ASSERT(mag_ptr_fits, sizeof(LIFO_MEM_TYPE) >= sizeof(struct lifo *));
+
+
+
+/*	mag_new()
+An empty magazine: a struct lifo which is never extended.
+'mem_max' marks it full-size: a lifo_push() onto a full magazine returns
+	LIFO_ERR instead of growing (mremap()) memory from malloc().
+*/
+static struct lifo *mag_new()
+{
+	struct lifo *ret = NULL;
+	NB_die_if(!(
+		ret = malloc(sizeof(*ret) + MAG_SIZE * sizeof(LIFO_MEM_TYPE))
+		), "malloc magazine");
+	ret->next = 0;
+	ret->mem_len = MAG_SIZE * sizeof(LIFO_MEM_TYPE);
+	ret->mem_max = ret->mem_len;
+die:
+	return ret;
+}
+
+
+/*	mag_take()
+A magazine off 'stk'; NULL if none.
+*/
+static struct lifo *mag_take(struct clifo *stk)
+{
+	LIFO_MEM_TYPE m;
+	if (clifo_pop(stk, &m))
+		return NULL;
+	return (struct lifo *)m;
+}
+
+
+/*	mag_get_empty()
+An empty magazine from the depot; or a new one.
+*/
+static struct lifo *mag_get_empty(struct mag_depot *dp)
+{
+	struct lifo *m = mag_take(dp->empty);
+	if (!m)
+		return mag_new();
+	__atomic_sub_fetch(&dp->empty_cnt, 1, __ATOMIC_RELAXED);
+	return m;
+}
+
+/*	mag_put_empty()
+Give an empty magazine to the depot; free it if the depot has enough.
+*/
+static void mag_put_empty(struct mag_depot *dp, struct lifo *m)
+{
+	if (__atomic_fetch_add(&dp->empty_cnt, 1, __ATOMIC_RELAXED) >= dp->empty_max
+		|| clifo_push(dp->empty, (LIFO_MEM_TYPE)m))
+	{
+		__atomic_sub_fetch(&dp->empty_cnt, 1, __ATOMIC_RELAXED);
+		free(m);
+	}
+}
+
+
+
+/*	mag_depot_new()
+A depot keeping at most 'empty_max' empty magazines.
+*/
+struct mag_depot	*mag_depot_new(size_t empty_max)
+{
+	struct mag_depot *ret = NULL;
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "");
+	ret->empty_max = empty_max;
+	NB_die_if(!(ret->full = clifo_new()), "");
+	NB_die_if(!(ret->empty = clifo_new()), "");
+	return ret;
+die:
+	mag_depot_free(ret);
+	return NULL;
+}
+
+
+/*	mag_depot_free()
+Frees all magazines in the depot, with the IDs in them.
+Not thread-safe: all caches must be flushed (and no longer used) first.
+*/
+void			mag_depot_free(struct mag_depot *dp)
+{
+	if (!dp)
+		return;
+	struct lifo *m;
+	if (dp->full) {
+		while ((m = mag_take(dp->full)))
+			free(m);
+	}
+	if (dp->empty) {
+		while ((m = mag_take(dp->empty)))
+			free(m);
+	}
+	clifo_free(dp->full);
+	clifo_free(dp->empty);
+	free(dp);
+}
+
+
+/*	mag_cache_init()
+*/
+void			mag_cache_init(struct mag_cache *mc, struct mag_depot *dp)
+{
+	*mc = (struct mag_cache){ .depot = dp };
+}
+
+
+/*	mag_cache_flush()
+Give all of this thread's magazines back to the depot.
+Returns 0 on success.
+*/
+int			mag_cache_flush(struct mag_cache *mc)
+{
+	int err_cnt = 0;
+	struct lifo **mags[] = { &mc->loaded, &mc->prev };
+	for (size_t i=0; i < NLC_ARRAY_LEN(mags); i++) {
+		struct lifo *m = *mags[i];
+		if (!m)
+			continue;
+		if (!m->next) {
+			mag_put_empty(mc->depot, m);
+		} else {
+			NB_die_if(clifo_push(mc->depot->full, (LIFO_MEM_TYPE)m), "");
+		}
+		*mags[i] = NULL;
+	}
+die:
+	return err_cnt;
+}
+
+
+/*	mag_push_slow()
+The loaded magazine is full (or missing):
+	swap with 'prev' if that has room; else send 'prev' (full) to the depot
+	and load an empty magazine.
+Returns 0 on success.
+*/
+int			mag_push_slow(struct mag_cache *mc, LIFO_MEM_TYPE push_this)
+{
+	int err_cnt = 0;
+	struct lifo *prev = mc->prev;
+
+	if (prev && prev->next < MAG_SIZE) {
+		mc->prev = mc->loaded;
+		mc->loaded = prev;
+	} else {
+		if (prev) {
+			NB_die_if(clifo_push(mc->depot->full, (LIFO_MEM_TYPE)prev), "");
+		}
+		mc->prev = mc->loaded;
+		NB_die_if(!(
+			mc->loaded = mag_get_empty(mc->depot)
+			), "");
+	}
+	lifo_push(&mc->loaded, push_this);
+die:
+	return err_cnt;
+}
+
+
+/*	mag_pop_slow()
+The loaded magazine is empty (or missing):
+	swap with 'prev' if that has IDs; else send 'prev' (empty) to the depot
+	and load a full magazine.
+Returns 0 on success; nonzero if the depot has no IDs either.
+*/
+int			mag_pop_slow(struct mag_cache *mc, LIFO_MEM_TYPE *pop_here)
+{
+	struct lifo *prev = mc->prev;
+
+	if (prev && prev->next) {
+		mc->prev = mc->loaded;
+		mc->loaded = prev;
+	} else {
+		struct lifo *full = mag_take(mc->depot->full);
+		if (!full)
+			return 1;
+		if (prev)
+			mag_put_empty(mc->depot, prev);
+		mc->prev = mc->loaded;
+		mc->loaded = full;
+	}
+	lifo_pop(mc->loaded, pop_here);
+	return 0;
+}
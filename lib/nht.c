@@ -0,0 +1,468 @@
+/*	mmap
+On linux, tables are mmap()ed: zeroed (all EMPTY) by the kernel, page by page
+	as first touched; and optionally advised for huge pages (see NHT_HUGEPAGE).
+*/
+#ifdef __linux__
+	#define _GNU_SOURCE
+	#include <sys/mman.h>
+	#define NHT_MMAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+#endif
+
+#include <nht.h>
+#include <fnv.h>
+#include <nmath.h>
+#include <ndebug.h>
+
+#include <stdlib.h>
+#include <string.h> /* memcpy(), memcmp() */
+#include <sys/types.h> /* ssize_t */
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+
+/*	control bytes
+ * EMPTY is 0 so that a freshly calloc()ed table is all empty:
+ * no memset() of the control bytes when (re)sizing.
+ * A full slot has the high bit set, plus 7 bits of hash.
+ */
+#define NHT_EMPTY	0x00
+#define NHT_DELETED	0x01
+#define NHT_FULL	0x80
+
+
+/*	nht_slot
+ * 32B: two slots per cache line.
+ * 'hash' is the high 32 bits of the key hash;
+ * it is kept so that migrating never calls the hash function again.
+ */
+struct nht_slot {
+	union {
+		uint8_t		inl[NHT_INLINE];
+		const void	*ptr;
+	}		key;
+	uint32_t	key_len;
+	uint32_t	hash;
+	nht_val_t	val;
+};
+
+/*	nht_tbl
+ * One table: (mask + 1) groups of control bytes, followed by as many groups of slots.
+ */
+struct nht_tbl {
+	uint8_t		*ctrl;
+	struct nht_slot	*slots;
+	size_t		mask;		/* groups - 1 */
+	size_t		used;		/* full slots */
+	size_t		growth;		/* EMPTY slots which may still be filled */
+};
+
+/*	nht
+ * While resizing, 'old' is being moved into 'cur' and both must be searched.
+ */
+struct nht {
+	struct nht_tbl	cur;
+	struct nht_tbl	old;		/* 'old.ctrl' is NULL unless resizing */
+	size_t		migrated;	/* groups of 'old' already moved */
+	nht_hash_t	hash;
+};
+
+
+
+/*	group matching
+ * Each returns a bitmask with bit 'i' set if slot 'i' of the group
+ * (at 'ctrl', which is NHT_GROUP-aligned) matches.
+ */
+#ifdef __SSE2__
+NLC_INLINE uint32_t nht_match(const uint8_t *ctrl, uint8_t h2)
+{
+	__m128i c = _mm_load_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(NHT_FULL | h2)));
+}
+NLC_INLINE uint32_t nht_match_empty(const uint8_t *ctrl)
+{
+	__m128i c = _mm_load_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_setzero_si128()));
+}
+/* EMPTY or DELETED: high bit clear */
+NLC_INLINE uint32_t nht_match_free(const uint8_t *ctrl)
+{
+	__m128i c = _mm_load_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(c) ^ 0xffff;
+}
+
+#else
+NLC_INLINE uint32_t nht_match(const uint8_t *ctrl, uint8_t h2)
+{
+	uint32_t ret = 0;
+	for (int i=0; i < NHT_GROUP; i++)
+		ret |= (uint32_t)(ctrl[i] == (NHT_FULL | h2)) << i;
+	return ret;
+}
+NLC_INLINE uint32_t nht_match_empty(const uint8_t *ctrl)
+{
+	uint32_t ret = 0;
+	for (int i=0; i < NHT_GROUP; i++)
+		ret |= (uint32_t)(ctrl[i] == NHT_EMPTY) << i;
+	return ret;
+}
+NLC_INLINE uint32_t nht_match_free(const uint8_t *ctrl)
+{
+	uint32_t ret = 0;
+	for (int i=0; i < NHT_GROUP; i++)
+		ret |= (uint32_t)!(ctrl[i] & NHT_FULL) << i;
+	return ret;
+}
+#endif
+
+
+/*	nht_h2()
+ * The 7 bits of hash in a control byte: the top ones.
+ * Groups are picked with the bits below (see NHT_GROUPS_MAX).
+ */
+NLC_INLINE uint8_t nht_h2(uint32_t hash)
+{
+	return hash >> 25;
+}
+
+
+/*	nht_tbl_len()
+ * Bytes of memory for a table of 'groups' groups.
+ */
+NLC_INLINE size_t nht_tbl_len(size_t groups)
+{
+	return groups * NHT_GROUP * (1 + sizeof(struct nht_slot));
+}
+
+
+/*	nht_tbl_alloc()
+ * Returns 0 on success.
+ */
+static int nht_tbl_alloc(struct nht_tbl *tbl, size_t groups)
+{
+	int err_cnt = 0;
+	NB_die_if(groups > NHT_GROUPS_MAX, "%zu groups > max %lu", groups, NHT_GROUPS_MAX);
+
+	/* both are zeroed, and aligned enough for (16B) group loads */
+	size_t len = nht_tbl_len(groups);
+#ifdef NHT_MMAP_FLAGS
+	NB_die_if((
+		tbl->ctrl = mmap(NULL, len, PROT_READ | PROT_WRITE, NHT_MMAP_FLAGS, -1, 0)
+		) == MAP_FAILED, "mmap %zu", len);
+	#if NHT_HUGEPAGE && defined(MADV_HUGEPAGE)
+	madvise(tbl->ctrl, len, MADV_HUGEPAGE); /* advice only: ignore failure */
+	#endif
+#else
+	NB_die_if(!(
+		tbl->ctrl = calloc(1, len)
+		), "calloc %zu", len);
+#endif
+	tbl->slots = (struct nht_slot *)&tbl->ctrl[groups * NHT_GROUP];
+	tbl->mask = groups - 1;
+	tbl->used = 0;
+	/* max load 7/8 */
+	tbl->growth = groups * NHT_GROUP - groups * NHT_GROUP / 8;
+
+	return 0;
+die:
+	tbl->ctrl = NULL;
+	return err_cnt;
+}
+
+
+/*	nht_tbl_free()
+ */
+static void nht_tbl_free(struct nht_tbl *tbl)
+{
+	if (!tbl->ctrl)
+		return;
+#ifdef NHT_MMAP_FLAGS
+	munmap(tbl->ctrl, nht_tbl_len(tbl->mask + 1));
+#else
+	free(tbl->ctrl);
+#endif
+	*tbl = (struct nht_tbl){ 0 };
+}
+
+
+/*	nht_tbl_find()
+ * Returns the index of the slot holding 'key', or -1.
+ */
+static ssize_t nht_tbl_find(const struct nht_tbl *tbl, uint32_t hash,
+				const void *key, size_t key_len)
+{
+	uint8_t h2 = nht_h2(hash);
+	size_t g = hash & tbl->mask;
+
+	/* Triangular probing over a power-of-2 number of groups visits every group;
+	 * and there is always an EMPTY slot somewhere (max load): this terminates.
+	 */
+	for (size_t i=1; ; i++) {
+		const uint8_t *ctrl = &tbl->ctrl[g * NHT_GROUP];
+		for (uint32_t m = nht_match(ctrl, h2); m; m &= m - 1) {
+			size_t idx = g * NHT_GROUP + __builtin_ctz(m);
+			const struct nht_slot *s = &tbl->slots[idx];
+			if (s->hash != hash || s->key_len != key_len)
+				continue;
+			const void *k = key_len <= NHT_INLINE ? s->key.inl : s->key.ptr;
+			if (!memcmp(k, key, key_len))
+				return idx;
+		}
+		/* the key would have been placed in an EMPTY slot of this group */
+		if (nht_match_empty(ctrl))
+			return -1;
+		g = (g + i) & tbl->mask;
+	}
+}
+
+
+/*	nht_tbl_insert()
+ * Place 'src' (whose key is known not to be in 'tbl') in the first free slot
+ * along its probe sequence.
+ */
+static void nht_tbl_insert(struct nht_tbl *tbl, const struct nht_slot *src)
+{
+	size_t g = src->hash & tbl->mask;
+	uint32_t m;
+	for (size_t i=1; !(m = nht_match_free(&tbl->ctrl[g * NHT_GROUP])); i++)
+		g = (g + i) & tbl->mask;
+
+	size_t idx = g * NHT_GROUP + __builtin_ctz(m);
+	if (tbl->ctrl[idx] == NHT_EMPTY && tbl->growth)
+		tbl->growth--;
+	tbl->ctrl[idx] = NHT_FULL | nht_h2(src->hash);
+	tbl->slots[idx] = *src;
+	tbl->used++;
+}
+
+
+/*	nht_tbl_erase()
+ * A slot may go back to EMPTY only if its group already has an EMPTY slot:
+ * then no probe sequence ever continued past this group.
+ * Otherwise it becomes a tombstone (DELETED) until the next resize.
+ */
+static void nht_tbl_erase(struct nht_tbl *tbl, size_t idx)
+{
+	uint8_t *group = &tbl->ctrl[idx & ~(size_t)(NHT_GROUP - 1)];
+	if (nht_match_empty(group)) {
+		tbl->ctrl[idx] = NHT_EMPTY;
+		tbl->growth++;
+	} else {
+		tbl->ctrl[idx] = NHT_DELETED;
+	}
+	tbl->used--;
+}
+
+
+/*	nht_migrate()
+ * Move (up to) 'groups' groups from 'old' into 'cur'; free 'old' once empty.
+ * Moved slots become tombstones in 'old': probe sequences through them
+ * must continue, but their (stale) keys must never be found there again.
+ */
+static void nht_migrate(struct nht *nht, size_t groups)
+{
+	struct nht_tbl *old = &nht->old;
+
+	for (; groups && nht->migrated <= old->mask; groups--, nht->migrated++) {
+		size_t base = nht->migrated * NHT_GROUP;
+		for (uint32_t m = nht_match_free(&old->ctrl[base]) ^ 0xffff; m; m &= m - 1) {
+			size_t idx = base + __builtin_ctz(m);
+			nht_tbl_insert(&nht->cur, &old->slots[idx]);
+			old->ctrl[idx] = NHT_DELETED;
+			old->used--;
+		}
+	}
+
+	if (nht->migrated > old->mask)
+		nht_tbl_free(old);
+}
+
+
+/*	nht_grow()
+ * 'cur' is full: make it 'old' and allocate a new 'cur'.
+ * The new table is twice the size; or the same size if mostly tombstones.
+ * Returns 0 on success.
+ */
+static int nht_grow(struct nht *nht)
+{
+	int err_cnt = 0;
+
+	/* a previous resize still in progress: finish it */
+	if (nht->old.ctrl)
+		nht_migrate(nht, SIZE_MAX);
+
+	size_t groups = nht->cur.mask + 1;
+	if (nht->cur.used > groups * NHT_GROUP * 7 / 16)
+		groups *= 2;
+
+	struct nht_tbl next;
+	NB_die_if(nht_tbl_alloc(&next, groups), "");
+	nht->old = nht->cur;
+	nht->cur = next;
+	nht->migrated = 0;
+
+die:
+	return err_cnt;
+}
+
+
+
+/*	nht_fnv64()
+ * The default hash: fnv_hash64() from basis.
+ */
+uint64_t	nht_fnv64(const void *key, size_t key_len)
+{
+	return fnv_hash64(NULL, key, key_len);
+}
+
+
+/*	nht_new()
+ * Create a table sized for (at least) 'hint' entries without resizing.
+ * If 'hash' is NULL, use nht_fnv64().
+ * Returns NULL on failure.
+ */
+struct nht	*nht_new(size_t hint, nht_hash_t hash)
+{
+	struct nht *ret = NULL;
+	/* hint * 8 would wrap */
+	NB_die_if(hint > SIZE_MAX / 8, "hint %zu too large", hint);
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "calloc %zu", sizeof(*ret));
+	ret->hash = hash ? hash : nht_fnv64;
+
+	size_t groups = nm_next_pow2_64(nm_div_ceil(hint * 8 / 7 + 1, NHT_GROUP));
+	NB_die_if(nht_tbl_alloc(&ret->cur, groups), "");
+
+	return ret;
+die:
+	nht_free(ret);
+	return NULL;
+}
+
+
+/*	nht_free()
+ * Keys referenced by pointer (longer than NHT_INLINE) belong to the caller.
+ */
+void		nht_free(struct nht *nht)
+{
+	if (!nht)
+		return;
+	nht_tbl_free(&nht->cur);
+	nht_tbl_free(&nht->old);
+	free(nht);
+}
+
+
+/*	nht_count()
+ */
+size_t		nht_count(const struct nht *nht)
+{
+	return nht->cur.used + nht->old.used;
+}
+
+
+/*	nht_get()
+ * Look up 'key'; if found and 'val' is not NULL, write its value to 'val'.
+ * Returns 0 if found.
+ */
+int		nht_get(const struct nht *nht, const void *key, size_t key_len,
+			nht_val_t *val)
+{
+	uint32_t hash = nht->hash(key, key_len) >> 32;
+
+	const struct nht_tbl *tbl = &nht->cur;
+	ssize_t idx = nht_tbl_find(tbl, hash, key, key_len);
+	if (idx < 0 && nht->old.ctrl) {
+		tbl = &nht->old;
+		idx = nht_tbl_find(tbl, hash, key, key_len);
+	}
+	if (idx < 0)
+		return 1;
+
+	if (val)
+		*val = tbl->slots[idx].val;
+	return 0;
+}
+
+
+/*	nht_set()
+ * Map 'key' to 'val', replacing any previous value.
+ * A key longer than NHT_INLINE is stored by reference: it must stay valid
+ * (and unchanged) until deleted, replaced or the table is freed.
+ * Returns 0 on success.
+ */
+int		nht_set(struct nht *nht, const void *key, size_t key_len,
+			nht_val_t val)
+{
+	int err_cnt = 0;
+	NB_die_if(key_len > UINT32_MAX, "key_len %zu", key_len);
+
+	if (nht->old.ctrl)
+		nht_migrate(nht, NHT_MIGRATE);
+
+	uint32_t hash = nht->hash(key, key_len) >> 32;
+
+	/* replace; an old entry still to be migrated will carry the new value */
+	struct nht_tbl *tbl = &nht->cur;
+	ssize_t idx = nht_tbl_find(tbl, hash, key, key_len);
+	if (idx < 0 && nht->old.ctrl) {
+		tbl = &nht->old;
+		idx = nht_tbl_find(tbl, hash, key, key_len);
+	}
+	if (idx >= 0) {
+		/* from now on, reference the key given last */
+		if (key_len > NHT_INLINE)
+			tbl->slots[idx].key.ptr = key;
+		tbl->slots[idx].val = val;
+		goto die;
+	}
+
+	/* insert */
+	if (!nht->cur.growth) {
+		NB_die_if(nht_grow(nht), "");
+	}
+
+	struct nht_slot slot = {
+		.key_len = key_len,
+		.hash = hash,
+		.val = val
+	};
+	if (key_len <= NHT_INLINE)
+		memcpy(slot.key.inl, key, key_len);
+	else
+		slot.key.ptr = key;
+	nht_tbl_insert(&nht->cur, &slot);
+
+die:
+	return err_cnt;
+}
+
+
+/*	nht_del()
+ * Remove 'key'; if 'val' is not NULL, write its value there.
+ * Returns 0 if 'key' was found (and removed).
+ */
+int		nht_del(struct nht *nht, const void *key, size_t key_len,
+			nht_val_t *val)
+{
+	if (nht->old.ctrl)
+		nht_migrate(nht, NHT_MIGRATE);
+
+	uint32_t hash = nht->hash(key, key_len) >> 32;
+
+	struct nht_tbl *tbl = &nht->cur;
+	ssize_t idx = nht_tbl_find(tbl, hash, key, key_len);
+	if (idx < 0 && nht->old.ctrl) {
+		tbl = &nht->old;
+		idx = nht_tbl_find(tbl, hash, key, key_len);
+	}
+	if (idx < 0)
+		return 1;
+
+	if (val)
+		*val = tbl->slots[idx].val;
+	nht_tbl_erase(tbl, idx);
+	return 0;
+}
@@ -39,3 +39,64 @@ die:
 	return err_cnt;
 }
 
+
+
+/*	nmem_file_rw()
+Map a file at 'path' read-write and shared: changes go to the file.
+Populate '*out'.
+Returns 0 on success.
+*/
+int		nmem_file_rw(const char *path, struct nmem *out)
+{
+	int err_cnt = 0;
+	NB_die_if(!path || !out, "args");
+
+	out->o_flags = O_RDWR;
+	NB_die_if((
+		out->fd = open(path, out->o_flags)
+		) == -1, "fd %d; open %s", out->fd, path);
+
+	off_t len;
+	NB_die_if((
+		len = lseek(out->fd, 0, SEEK_END)
+		) <= 0, "SEEK_END of '%s' gives %jd", path, (intmax_t)len);
+	out->len = len;
+
+	NB_die_if((
+		out->mem = mmap(NULL, out->len, PROT_READ | PROT_WRITE, MAP_SHARED, out->fd, 0)
+		) == MAP_FAILED, "map %s sz %zu fd %"PRId32, path, out->len, out->fd);
+
+	return 0;
+die:
+	nmem_free(out, NULL);
+	return err_cnt;
+}
+
+
+/*	nmem_resize()
+Resize the file behind a shared mapping (nmem_alloc(), nmem_file_rw()) to 'len',
+	and map all of it: 'nm->mem' may move.
+Returns 0 on success; on failure 'nm' is unchanged.
+*/
+int		nmem_resize(struct nmem *nm, size_t len)
+{
+	int err_cnt = 0;
+	void *mem;
+	NB_die_if(!nm || !len, "args");
+	NB_die_if(ftruncate(nm->fd, len), "len=%zu", len);
+
+#ifdef MREMAP_MAYMOVE
+	NB_die_if((
+		mem = mremap(nm->mem, nm->len, len, MREMAP_MAYMOVE)
+		) == MAP_FAILED, "mremap %zu -> %zu", nm->len, len);
+#else
+	NB_die_if((
+		mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, nm->fd, 0)
+		) == MAP_FAILED, "map sz %zu fd %"PRId32, len, nm->fd);
+	munmap(nm->mem, nm->len);
+#endif
+	nm->mem = mem;
+	nm->len = len;
+die:
+	return err_cnt;
+}
@@ -50,7 +50,34 @@ die:
 }
 
 
+/*	nmem_deliver()
+Link the temp file behind 'nm' (see nmem_alloc()) at 'deliver_path',
+	which must not exist: an existing file is never replaced
+	(link() and unlink() rather than rename(), as on Linux).
+'nm' stays mapped and open; nmem_free() it after.
+Returns 0 on success.
+*/
+int nmem_deliver(struct nmem *nm, const char *deliver_path)
+{
+	int err_cnt = 0;
+	char path[MAXPATHLEN];
+	NB_die_if(!nm || !deliver_path, "args");
+	NB_die_if((
+		fcntl(nm->fd, F_GETPATH, path)
+		) == -1, "");
+	NB_die_if((
+		link(path, deliver_path)
+		) == -1, "%s -> %s", path, deliver_path);
+	NB_err_if((
+		unlink(path)
+		) == -1, "unlink %s", path);
+die:
+	return err_cnt;
+}
+
+
 /*	nmem_free()
+If 'deliver_path', first nmem_deliver() the file there (errors only logged).
 */
 void nmem_free(struct nmem *nm, const char *deliver_path)
 {
@@ -63,17 +90,9 @@ void nmem_free(struct nmem *nm, const char *deliver_path)
 	nm->mem = NULL;
 
 	/* deliver if requested */
-	if (deliver_path) {
-		char path[MAXPATHLEN];
-		NB_die_if((
-			fcntl(nm->fd, F_GETPATH, path)
-			) == -1, "");
-		NB_die_if((
-			rename(path, deliver_path)
-			) == -1, "%s -> %s", path, deliver_path);
-	}
+	if (deliver_path)
+		nmem_deliver(nm, deliver_path);
 
-die:
 	/* close */
 	if (nm->fd != -1)
 		close(nm->fd);
@@ -89,7 +108,7 @@ ssize_t nmem_in_splice(struct nmem	*nm,
      			int		fd_pipe_from)
 {
 	ssize_t ret = -1;
-	NB_die_if(!nm || fd_pipe_from < 1, "args");
+	NB_die_if(!nm || fd_pipe_from < 0, "args");
 
 	ret = read(fd_pipe_from, nm->mem + offset, len);
 	NB_die_if(ret < 0, "len %zu", len);
@@ -106,7 +125,7 @@ ssize_t nmem_out_splice(struct nmem	*nm,
 			int		fd_pipe_to)
 {
 	ssize_t ret = -1;
-	NB_die_if(!nm || fd_pipe_to < 1, "args");
+	NB_die_if(!nm || fd_pipe_to < 0, "args");
 
 	/* Owing to DARWIN's inevitable, demoralizing behavior of BLOCKING when
 		write()ing to a pipe,
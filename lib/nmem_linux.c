@@ -32,11 +32,14 @@ int nmem_alloc(size_t len, const char *tmp_dir, struct nmem *out)
 		If not available, we fall back on a plain mmap()ed file in "/tmp".
 		*/
 		#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
-		out->o_flags = O_NONBLOCK;
+		/* memfd_create() takes MFD_* flags, not open() flags:
+		 * it always yields an O_RDWR fd.
+		 */
+		out->o_flags = O_RDWR;
 		char name[16];
 		snprintf(name, 16, "nmem_%zu", out->len);
 		NB_die_if((
-			out->fd = syscall(__NR_memfd_create, name, out->o_flags)
+			out->fd = syscall(__NR_memfd_create, name, MFD_CLOEXEC)
 			) == -1, "");
 		/* fallback: create a temp file on disk */
 		#else
@@ -88,8 +91,41 @@ die:
 }
 
 
+/*	nmem_deliver()
+Link the temp file behind 'nm' (see nmem_alloc()) at 'deliver_path',
+	which must not exist: an existing file is never replaced.
+'nm' stays mapped and open; nmem_free() it after.
+Returns 0 on success.
+*/
+int nmem_deliver(struct nmem *nm, const char *deliver_path)
+{
+	int err_cnt = 0;
+	NB_die_if(!nm || !deliver_path, "args");
+
+	#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,11,0)
+	NB_die_if(!(nm->o_flags & O_TMPFILE), "no file to deliver at '%s'", deliver_path);
+	char src[32];
+	snprintf(src, 32, "/proc/self/fd/%d", nm->fd);
+	NB_die_if(
+		linkat(AT_FDCWD, src, AT_FDCWD, deliver_path, AT_SYMLINK_FOLLOW)
+		, "%s -> %s", src, deliver_path);
+	#else
+	NB_die_if(!nm->tempfile, "no file to deliver at '%s'", deliver_path);
+	NB_die_if(
+		link(nm->tempfile, deliver_path)
+		, "failed to link '%s' -> '%s'", nm->tempfile, deliver_path);
+	NB_err_if(
+		unlink(nm->tempfile)
+		, "failed to unlink tempfile '%s'", nm->tempfile);
+	#endif
+die:
+	return err_cnt;
+}
+
+
 /*	nmem_free()
 Free the memory pointed to by '*nm'; clear '*nm'
+If 'deliver_path', first nmem_deliver() the file there (errors only logged).
 */
 void nmem_free(struct nmem *nm, const char *deliver_path)
 {
@@ -102,24 +138,8 @@ void nmem_free(struct nmem *nm, const char *deliver_path)
 	nm->mem = NULL;
 
 	/* deliver if requested */
-	#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,11,0)
-	if (deliver_path && (nm->o_flags & O_TMPFILE)) {
-		char src[32];
-		snprintf(src, 32, "/proc/self/fd/%d", nm->fd);
-		NB_err_if(
-			linkat(AT_FDCWD, src, AT_FDCWD, deliver_path, AT_SYMLINK_FOLLOW)
-			, "%s -> %s", src, deliver_path);
-	}
-	#else
-	if (deliver_path) {
-		NB_err_if(
-			link(nm->tempfile, deliver_path)
-			, "failed to link '%s' -> '%s'", nm->tempfile, deliver_path);
-		NB_err_if(
-			unlink(nm->tempfile)
-			, "failed to unlink tempfile '%s'", nm->tempfile);
-	}
-	#endif
+	if (deliver_path)
+		nmem_deliver(nm, deliver_path);
 
 	/* close */
 	if (nm->fd != -1)
@@ -143,7 +163,7 @@ ssize_t	nmem_in_splice(struct nmem	*nm,
 			int		fd_pipe_from)
 {
 	ssize_t ret = -1;
-	NB_die_if(!nm || fd_pipe_from < 1, "args");
+	NB_die_if(!nm || fd_pipe_from < 0, "args");
 
 	ret = splice(fd_pipe_from, NULL, nm->fd, (loff_t*)&offset,
 				len, NMEM_SPLICE_FLAGS);
@@ -172,7 +192,7 @@ ssize_t nmem_out_splice(struct nmem	*nm,
 			int		fd_pipe_to)
 {
 	ssize_t ret = -1;
-	NB_die_if(!nm || fd_pipe_to < 1, "args");
+	NB_die_if(!nm || fd_pipe_to < 0, "args");
 
 	ret = splice(nm->fd, (loff_t*)&offset, fd_pipe_to, NULL,
 				len, NMEM_SPLICE_FLAGS);
@@ -0,0 +1,199 @@
+#include <plifo.h>
+#include <fnv.h>
+#include <npath.h>
+#include <stdlib.h>
+#include <stddef.h> /* offsetof() */
+
+
+
+/*	plifo_hdr_sum()
+*/
+static uint64_t plifo_hdr_sum(const struct plifo_hdr *hdr)
+{
+	return fnv_fast64(hdr, offsetof(struct plifo_hdr, hdr_sum));
+}
+
+/*	plifo_map()
+Point 'hdr' and 'stk' into the mapping; 'mem_len' follows from the file size.
+*/
+static void plifo_map(struct plifo *pl)
+{
+	pl->hdr = pl->nm.mem;
+	pl->stk = (struct lifo *)((char *)pl->nm.mem + PLIFO_HDR_LEN);
+	pl->stk->mem_len = pl->nm.len - PLIFO_HDR_LEN - sizeof(struct lifo);
+	pl->stk->mem_max = 0;
+}
+
+/*	plifo_mark()
+Write the header with 'state'; flush it to disk.
+*/
+static int plifo_mark(struct plifo *pl, uint64_t state)
+{
+	int err_cnt = 0;
+	pl->hdr->state = state;
+	pl->hdr->hdr_sum = plifo_hdr_sum(pl->hdr);
+	NB_die_if(msync(pl->nm.mem, sizeof(struct plifo_hdr), MS_SYNC),
+		"msync header");
+die:
+	return err_cnt;
+}
+
+
+
+/*	plifo_new()
+Create a stack in a new file at 'path', which must not exist.
+The file is built in a temp file next to 'path' and only linked at 'path'
+	once complete: a half-written file is never found there.
+Linking fails if anything is at 'path' by then: only our own file is opened.
+*/
+struct plifo	*plifo_new(const char *path)
+{
+	struct plifo *ret = NULL;
+	char *dir = NULL;
+	struct nmem nm = { .fd = -1 };
+
+	NB_die_if(!path, "args");
+	NB_die_if(!access(path, F_OK), "'%s' exists", path);
+	NB_die_if(!(dir = n_dirname(path)), "");
+
+	NB_die_if(nmem_alloc(LIFO_GROW, dir, &nm), "temp file in '%s'", dir);
+	struct lifo *stk = (struct lifo *)((char *)nm.mem + PLIFO_HDR_LEN);
+	stk->next = 0;
+	stk->mem_len = nm.len - PLIFO_HDR_LEN - sizeof(struct lifo);
+	stk->mem_max = 0;
+	struct plifo_hdr *hdr = nm.mem;
+	*hdr = (struct plifo_hdr){
+		.magic = PLIFO_MAGIC,
+		.version = PLIFO_VERSION,
+		.mem_size = sizeof(LIFO_MEM_TYPE),
+		.state = PLIFO_CLEAN,
+		.sync_next = 0,
+		.sync_sum = fnv_fast64(stk->mem, 0)
+	};
+	hdr->hdr_sum = plifo_hdr_sum(hdr);
+	NB_die_if(msync(nm.mem, nm.len, MS_SYNC), "msync");
+
+	NB_die_if(nmem_deliver(&nm, path), "");
+	nmem_free(&nm, NULL);
+	NB_die_if(!(ret = plifo_open(path)), "");
+
+die:
+	if (!ret)
+		nmem_free(&nm, NULL);
+	free(dir);
+	return ret;
+}
+
+
+/*	plifo_open()
+Map the stack at 'path' back in.
+Returns NULL if the file is not a stack, is corrupt, or was modified
+	beyond recovery after the last plifo_sync() (see plifo.h).
+*/
+struct plifo	*plifo_open(const char *path)
+{
+	struct plifo *ret = NULL;
+	NB_die_if(!(
+		ret = calloc(1, sizeof(*ret))
+		), "alloc %zu", sizeof(*ret));
+	ret->nm.fd = -1;
+	NB_die_if(nmem_file_rw(path, &ret->nm), "");
+	NB_die_if(ret->nm.len < PLIFO_HDR_LEN + sizeof(struct lifo),
+		"'%s': %zu Bytes is too short", path, ret->nm.len);
+
+	struct plifo_hdr *hdr = ret->nm.mem;
+	NB_die_if(hdr->magic != PLIFO_MAGIC || hdr->version != PLIFO_VERSION,
+		"'%s' is not a plifo v%d", path, PLIFO_VERSION);
+	NB_die_if(hdr->mem_size != sizeof(LIFO_MEM_TYPE),
+		"'%s': entries of %"PRIu32" Bytes, not %zu", path,
+		hdr->mem_size, sizeof(LIFO_MEM_TYPE));
+	NB_die_if(hdr->hdr_sum != plifo_hdr_sum(hdr), "'%s': bad header checksum", path);
+
+	plifo_map(ret);
+	struct lifo *stk = ret->stk;
+	NB_die_if(hdr->sync_next > stk->mem_len / sizeof(LIFO_MEM_TYPE),
+		"'%s': %"PRIu64" entries synced, file holds %zu", path,
+		hdr->sync_next, stk->mem_len / sizeof(LIFO_MEM_TYPE));
+
+	if (hdr->state == PLIFO_CLEAN) {
+		NB_die_if(stk->next != hdr->sync_next,
+			"'%s': %zu entries, %"PRIu64" at close", path,
+			stk->next, hdr->sync_next);
+	} else {
+		/* not closed: back to the last sync, if that is still intact */
+		NB_die_if(fnv_fast64(stk->mem, hdr->sync_next * sizeof(LIFO_MEM_TYPE))
+			!= hdr->sync_sum,
+			"'%s': modified since last sync", path);
+		NB_wrn("'%s' was not closed: %"PRIu64" entries at last sync (%zu since)",
+			path, hdr->sync_next, stk->next);
+		stk->next = hdr->sync_next;
+	}
+
+	NB_die_if(plifo_mark(ret, PLIFO_OPEN), "");
+	return ret;
+die:
+	if (ret)
+		nmem_free(&ret->nm, NULL);
+	free(ret);
+	return NULL;
+}
+
+
+/*	plifo_sync()
+Make the stack as it is now what plifo_open() recovers after a crash.
+The entries are flushed before the header which vouches for them.
+O(n): checksums all entries.
+*/
+int		plifo_sync(struct plifo *pl)
+{
+	int err_cnt = 0;
+	NB_die_if(msync(pl->nm.mem, pl->nm.len, MS_SYNC), "msync");
+	pl->hdr->sync_next = pl->stk->next;
+	pl->hdr->sync_sum = fnv_fast64(pl->stk->mem, pl->stk->next * sizeof(LIFO_MEM_TYPE));
+	NB_die_if(plifo_mark(pl, PLIFO_OPEN), "");
+die:
+	return err_cnt;
+}
+
+
+/*	plifo_close()
+Sync, mark clean and unmap; 'pl' is freed even on error.
+*/
+int		plifo_close(struct plifo *pl)
+{
+	int err_cnt = 0;
+	if (!pl)
+		return 0;
+	NB_die_if(plifo_sync(pl), "");
+	NB_die_if(plifo_mark(pl, PLIFO_CLEAN), "");
+die:
+	nmem_free(&pl->nm, NULL);
+	free(pl);
+	return err_cnt;
+}
+
+
+/*	plifo_reserve()
+Make room for at least 'cnt' more entries, growing the file
+	(in LIFO_GROW steps); the mapping may move.
+Returns 0 on success.
+*/
+int		plifo_reserve(struct plifo *pl, size_t cnt)
+{
+	int err_cnt = 0;
+	struct lifo *stk = pl->stk;
+	NB_die_if(cnt > (SIZE_MAX - PLIFO_HDR_LEN - sizeof(struct lifo) - LIFO_GROW)
+			/ sizeof(LIFO_MEM_TYPE) - stk->next,
+		"plifo_reserve %zu overflows", cnt);
+
+	size_t need = (stk->next + cnt) * sizeof(LIFO_MEM_TYPE);
+	if (need <= stk->mem_len)
+		return 0;
+	size_t len = PLIFO_HDR_LEN + sizeof(struct lifo) + need;
+	len = (len + LIFO_GROW - 1) / LIFO_GROW * LIFO_GROW;
+
+	NB_die_if(nmem_resize(&pl->nm, len), "");
+	plifo_map(pl);
+die:
+	return err_cnt;
+}
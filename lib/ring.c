@@ -0,0 +1,198 @@
+#include <ring.h>
+#include <nmath.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sched.h> /* sched_yield() */
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/eventfd.h>
+#endif
+
+
+
+/*	ring_claim()
+Claim up to 'cnt' slots at 'me', given 'other' end's 'tail':
+	'off' is what 'me' may run ahead of 'other' (size for producers, 0 for consumers).
+Returns number of slots claimed, starting at '*head'.
+*/
+NLC_INLINE size_t ring_claim(struct ring_end *me, struct ring_end *other,
+				uint64_t off, bool multi, size_t cnt, uint64_t *head)
+{
+	uint64_t h, n;
+	if (!multi) {
+		h = __atomic_load_n(&me->head, __ATOMIC_RELAXED);
+		n = me->cache + off - h;
+		if (n < cnt) {
+			me->cache = __atomic_load_n(&other->tail, __ATOMIC_ACQUIRE);
+			n = me->cache + off - h;
+		}
+		if (n > cnt)
+			n = cnt;
+		__atomic_store_n(&me->head, h + n, __ATOMIC_RELAXED);
+		*head = h;
+		return n;
+	}
+
+	/* 'head' before 'tail': a stale 'head' may only overstate 'n', and fail the CAS */
+	h = __atomic_load_n(&me->head, __ATOMIC_ACQUIRE);
+	do {
+		n = __atomic_load_n(&other->tail, __ATOMIC_ACQUIRE) + off - h;
+		if (n > cnt)
+			n = cnt;
+		if (!n)
+			break;
+	} while (!__atomic_compare_exchange_n(&me->head, &h, h + n, true,
+					__ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+	*head = h;
+	return n;
+}
+
+
+/*	ring_publish()
+Hand slots [head, head + n) to the other end;
+	after whoever claimed the slots before ours.
+Waiting on their 'tail' is an acquire: our release then covers their slots too.
+*/
+NLC_INLINE void ring_publish(struct ring_end *me, bool multi, uint64_t head, uint64_t n)
+{
+	if (multi) {
+		for (unsigned spin=0; __atomic_load_n(&me->tail, __ATOMIC_ACQUIRE) != head; spin++) {
+			if (spin >= RING_SPIN)
+				sched_yield();
+		}
+	}
+	__atomic_store_n(&me->tail, head + n, __ATOMIC_RELEASE);
+}
+
+
+/*	ring_signal()
+A producer which found the ring empty wakes the consumer.
+The fence pairs with the one in ring_dequeue_n(): either the consumer
+	sees what we published, or we see it done with everything before it.
+*/
+static void ring_signal(struct ring *rg, uint64_t head)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&rg->cons.tail, __ATOMIC_RELAXED) != head)
+		return;
+#ifdef __linux__
+	eventfd_write(rg->fd, 1);
+#endif
+}
+
+
+
+/*	ring_new()
+'size' is rounded up to a power of 2.
+'flags' is RING_SPSC, RING_MPSC or RING_MPMC; optionally | RING_EVENTFD.
+*/
+struct ring	*ring_new(size_t size, unsigned flags)
+{
+	struct ring *ret = NULL;
+	size = nm_next_pow2_64(size);
+	NB_die_if(!size || size > (SIZE_MAX - sizeof(*ret)) / sizeof(RING_MEM_TYPE) / 2,
+		"ring size %zu", size);
+
+	size_t len = sizeof(*ret) + size * sizeof(RING_MEM_TYPE);
+	len = (len + NLC_CACHE_LINE - 1) & ~(size_t)(NLC_CACHE_LINE - 1);
+	NB_die_if(!(
+		ret = aligned_alloc(NLC_CACHE_LINE, len)
+		), "alloc %zu", len);
+	*ret = (struct ring){ .size = size, .mask = size - 1, .flags = flags, .fd = -1 };
+
+	if (flags & RING_EVENTFD) {
+#ifdef __linux__
+		NB_die_if((
+			ret->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)
+			) < 0, "eventfd");
+#else
+		NB_die("RING_EVENTFD: no eventfd on this platform");
+#endif
+	}
+	return ret;
+die:
+	ring_free(ret);
+	return NULL;
+}
+
+
+/*	ring_free()
+*/
+void		ring_free(struct ring *rg)
+{
+	if (!rg)
+		return;
+	if (rg->fd >= 0)
+		close(rg->fd);
+	free(rg);
+}
+
+
+/*	ring_enqueue_n()
+Enqueue up to 'cnt' IDs from 'src', in order.
+Returns number enqueued: fewer than 'cnt' (or 0) if the ring is (nearly) full.
+*/
+size_t		ring_enqueue_n(struct ring *rg, const RING_MEM_TYPE *src, size_t cnt)
+{
+	bool multi = rg->flags & RING_MP;
+	uint64_t head;
+	size_t n = ring_claim(&rg->prod, &rg->cons, rg->size, multi, cnt, &head);
+	if (!n)
+		return 0;
+
+	size_t idx = head & rg->mask;
+	size_t first = rg->size - idx < n ? rg->size - idx : n;
+	memcpy(&rg->slots[idx], src, first * sizeof(RING_MEM_TYPE));
+	memcpy(rg->slots, &src[first], (n - first) * sizeof(RING_MEM_TYPE));
+
+	ring_publish(&rg->prod, multi, head, n);
+	if (NLC_UNLIKELY(rg->fd >= 0))
+		ring_signal(rg, head);
+	return n;
+}
+
+
+/*	ring_dequeue_n()
+Dequeue up to 'cnt' IDs into 'dst', in the order they were enqueued.
+Returns number dequeued: 0 if the ring is empty.
+*/
+size_t		ring_dequeue_n(struct ring *rg, RING_MEM_TYPE *dst, size_t cnt)
+{
+	bool multi = rg->flags & RING_MC;
+	uint64_t head;
+	size_t n = ring_claim(&rg->cons, &rg->prod, 0, multi, cnt, &head);
+	if (!n)
+		return 0;
+
+	size_t idx = head & rg->mask;
+	size_t first = rg->size - idx < n ? rg->size - idx : n;
+	memcpy(dst, &rg->slots[idx], first * sizeof(RING_MEM_TYPE));
+	memcpy(&dst[first], rg->slots, (n - first) * sizeof(RING_MEM_TYPE));
+
+	ring_publish(&rg->cons, multi, head, n);
+	if (NLC_UNLIKELY(rg->fd >= 0))
+		__atomic_thread_fence(__ATOMIC_SEQ_CST); /* see ring_signal() */
+	return n;
+}
+
+
+/*	ring_fd()
+The eventfd signalled when an enqueue finds the ring empty; -1 if none.
+*/
+int		ring_fd(const struct ring *rg)
+{
+	return rg->fd;
+}
+
+/*	ring_fd_clear()
+Consume pending wakeups: call before draining the ring.
+*/
+void		ring_fd_clear(struct ring *rg)
+{
+#ifdef __linux__
+	eventfd_t val;
+	if (rg->fd >= 0)
+		eventfd_read(rg->fd, &val);
+#endif
+}
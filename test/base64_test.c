@@ -0,0 +1,355 @@
+/*	base64_test.c
+
+Test series for the base64 and base32 codecs:
+	RFC 4648 test vectors, SIMD against scalar, streaming and bad input;
+	and throughput of each.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#include <base64.h>
+#include <ndebug.h>
+#include <pcg_rand.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define SIMD_MAX 4096	/* bytes */
+#define BENCH_LEN 65536	/* bytes */
+#define BENCH_ITER 2000
+
+
+/*	test_rfc()
+
+RFC 4648 section 10 vectors, both ways; URL-safe alphabet and no padding.
+returns 0 on success
+*/
+int test_rfc()
+{
+	int err_cnt = 0;
+	const char *bin[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar" };
+	const char *b64[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+	const char *b32[] = { "", "MY======", "MZXQ====", "MZXW6===", "MZXW6YQ=",
+				"MZXW6YTB", "MZXW6YTBOI======" };
+	char out[32];
+	uint8_t dec[32];
+
+	for (size_t i=0; i < NLC_ARRAY_LEN(bin); i++) {
+		size_t len = strlen(bin[i]);
+		size_t b64_len = strlen(b64[i]), b32_len = strlen(b32[i]);
+
+		NB_err_if(b2b64((const unsigned char *)bin[i], out, len, 0) != b64_len + 1
+			|| strcmp(out, b64[i]), "b2b64 '%s' -> '%s'", bin[i], out);
+		NB_err_if(b642b(b64[i], b64_len, dec, 0) != len || memcmp(dec, bin[i], len),
+			"b642b '%s'", b64[i]);
+		NB_err_if(b2b32((const unsigned char *)bin[i], out, len, 0) != b32_len + 1
+			|| strcmp(out, b32[i]), "b2b32 '%s' -> '%s'", bin[i], out);
+		NB_err_if(b322b(b32[i], b32_len, dec, 0) != len || memcmp(dec, bin[i], len),
+			"b322b '%s'", b32[i]);
+
+		/* unpadded */
+		b2b64((const unsigned char *)bin[i], out, len, B64_NOPAD);
+		NB_err_if(strncmp(out, b64[i], strlen(out)) || strchr(out, '='),
+			"b2b64 nopad '%s' -> '%s'", bin[i], out);
+		NB_err_if(b642b(out, strlen(out), dec, 0) != len || memcmp(dec, bin[i], len),
+			"b642b nopad '%s'", out);
+		b2b32((const unsigned char *)bin[i], out, len, B64_NOPAD);
+		NB_err_if(b322b(out, strlen(out), dec, 0) != len || memcmp(dec, bin[i], len),
+			"b322b nopad '%s'", out);
+	}
+
+	/* alphabets */
+	const unsigned char high[] = { 0xfb, 0xff, 0xbf };
+	b2b64(high, out, sizeof(high), 0);
+	NB_err_if(strcmp(out, "+/+/"), "std alphabet: '%s'", out);
+	b2b64(high, out, sizeof(high), B64_URL);
+	NB_err_if(strcmp(out, "-_-_"), "URL alphabet: '%s'", out);
+	NB_err_if(b642b("-_-_", 4, dec, 0) != -1, "URL chars in std alphabet");
+	NB_err_if(b642b("+/+/", 4, dec, B64_URL) != -1, "std chars in URL alphabet");
+	NB_err_if(b322b("mzxw6ytb", 8, dec, 0) != 5 || memcmp(dec, "fooba", 5),
+		"base32 lower case");
+
+	return err_cnt;
+}
+
+
+/*	test_bad()
+
+Invalid characters, misplaced or incomplete padding and truncated groups
+	are all rejected; whitespace is not.
+returns 0 on success
+*/
+int test_bad()
+{
+	int err_cnt = 0;
+	uint8_t out[64];
+
+	const char *b64_bad[] = { "Z", "Zm9vY", "Zg=", "Z===", "=Zg=", "Zg==Zg==",
+				"Zg=a", "Zm9*", "Zm9v\x80", "Zm9vYmFyZm9vYmFyZm9vYmFyZm9vYmF!" };
+	for (size_t i=0; i < NLC_ARRAY_LEN(b64_bad); i++) {
+		NB_err_if(b642b(b64_bad[i], strlen(b64_bad[i]), out, 0) != -1,
+			"accepted '%s'", b64_bad[i]);
+	}
+	const char *b32_bad[] = { "M", "MZX", "MZXW6Y", "MY=====", "MY=======",
+				"MZXW6YT1", "MZXW6YTB0" };
+	for (size_t i=0; i < NLC_ARRAY_LEN(b32_bad); i++) {
+		NB_err_if(b322b(b32_bad[i], strlen(b32_bad[i]), out, 0) != -1,
+			"accepted '%s'", b32_bad[i]);
+	}
+
+	const char *ws = " Zm9v\r\nYmFy\tZg =\n=\n";
+	NB_err_if(b642b(ws, strlen(ws), out, 0) != 7 || memcmp(out, "foobarf", 7),
+		"whitespace");
+
+	/* position of a bad character, past a SIMD block */
+	struct base_stream bs;
+	base_stream_init(&bs, 0, 0);
+	const char *bad = "Zm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9v YmFy.mFy";
+	NB_err_if(b64_stream_dec(&bs, bad, strlen(bad), out) != -1 || bs.pos != 49,
+		"bad character at %zu", bs.pos);
+
+	return err_cnt;
+}
+
+
+/*	test_simd()
+
+Every SIMD level available on this CPU gives the same results as scalar code,
+	for all lengths up to a few blocks and some long ones, at all alignments,
+	with a bad character anywhere in the input.
+returns 0 on success
+*/
+int test_simd()
+{
+	int err_cnt = 0;
+	unsigned char *bin = malloc(SIMD_MAX + 64);
+	char *enc = malloc(SIMD_MAX * 2 + 128);
+	char *ref = malloc(SIMD_MAX * 2 + 128);
+	uint8_t *out = malloc(SIMD_MAX + 64);
+	uint8_t *out_ref = malloc(SIMD_MAX + 64);
+	NB_die_if(!bin || !enc || !ref || !out || !out_ref, "");
+	pcg_randset(bin, SIMD_MAX + 64, PCG_RAND_S1, PCG_RAND_S2);
+
+	size_t lens[300];
+	for (size_t i=0; i < 290; i++)
+		lens[i] = i;
+	for (size_t i=290; i < NLC_ARRAY_LEN(lens); i++)
+		lens[i] = SIMD_MAX - (i - 290) * 37;
+
+	for (unsigned isa = HX_SSE2; isa <= HX_AVX512; isa++) {
+		if (b64_isa(isa) != isa)
+			continue;
+		NB_inf("SIMD level %u", isa);
+
+		for (size_t i=0; i < NLC_ARRAY_LEN(lens); i++) {
+			size_t len = lens[i];
+			const unsigned char *b = &bin[i % 64];
+			unsigned flags = i & (B64_URL | B64_NOPAD);
+
+			/* base64 */
+			b64_isa(HX_SCALAR);
+			size_t ref_cnt = b2b64(b, ref, len, flags);
+			b64_isa(isa);
+			NB_die_if(b2b64(b, enc, len, flags) != ref_cnt
+				|| memcmp(enc, ref, ref_cnt), "b2b64 len %zu", len);
+			if (len && i % 5 == 0)
+				ref[(i * 7919) % (ref_cnt - 1)] = '#';
+
+			b64_isa(HX_SCALAR);
+			ssize_t n_ref = b642b(ref, ref_cnt - 1, out_ref, flags);
+			b64_isa(isa);
+			NB_die_if(b642b(ref, ref_cnt - 1, out, flags) != n_ref
+				|| (n_ref > 0 && memcmp(out, out_ref, n_ref)),
+				"b642b len %zu", len);
+			NB_die_if(n_ref != (i % 5 || !len ? len : -1) || memcmp(out, b, len * (n_ref > 0)),
+				"b642b len %zu: %zd", len, n_ref);
+
+			/* base32 */
+			b64_isa(HX_SCALAR);
+			ref_cnt = b2b32(b, ref, len, flags);
+			b64_isa(isa);
+			NB_die_if(b2b32(b, enc, len, flags) != ref_cnt
+				|| memcmp(enc, ref, ref_cnt), "b2b32 len %zu", len);
+			if (len && i % 5 == 0)
+				ref[(i * 7919) % (ref_cnt - 1)] = '1';
+
+			b64_isa(HX_SCALAR);
+			n_ref = b322b(ref, ref_cnt - 1, out_ref, flags);
+			b64_isa(isa);
+			NB_die_if(b322b(ref, ref_cnt - 1, out, flags) != n_ref
+				|| (n_ref > 0 && memcmp(out, out_ref, n_ref)),
+				"b322b len %zu", len);
+			NB_die_if(n_ref != (i % 5 || !len ? len : -1) || memcmp(out, b, len * (n_ref > 0)),
+				"b322b len %zu: %zd", len, n_ref);
+		}
+	}
+
+die:
+	b64_isa(HX_AVX512);
+	free(out_ref);
+	free(out);
+	free(ref);
+	free(enc);
+	free(bin);
+	return err_cnt;
+}
+
+
+/*	test_stream()
+
+Encode random data in random-sized chunks, with and without line breaks:
+	the output is the same as b2b64() (b2b32()) on the whole, split into lines.
+Decode it back in random-sized chunks at every SIMD level.
+returns 0 on success
+*/
+int test_stream()
+{
+	int err_cnt = 0;
+	const size_t len = 100000;
+	unsigned char *bin = malloc(len);
+	char *ref = malloc(len * 2 + 1);
+	char *enc = malloc(len * 3 + 2);
+	uint8_t *out = malloc(len + 8);
+	uint32_t sizes[64];
+	NB_die_if(!bin || !ref || !enc || !out, "");
+	pcg_randset(bin, len, PCG_RAND_S1, PCG_RAND_S2);
+	pcg_randset(sizes, sizeof(sizes), PCG_RAND_S2, PCG_RAND_S1);
+
+	size_t cols[] = { 0, 76, 64, 3, 10 };
+	for (int b32 = 0; b32 < 2; b32++) {
+		size_t ref_len = (b32 ? b2b32 : b2b64)(bin, ref, len, 0) - 1;
+		unsigned group = b32 ? 8 : 4;
+
+		for (size_t c=0; c < NLC_ARRAY_LEN(cols); c++) {
+			struct base_stream bs;
+			base_stream_init(&bs, 0, cols[c]);
+
+			/* encode */
+			size_t enc_len = 0;
+			for (size_t off=0, i=0; off < len; i++) {
+				size_t n = sizes[i % 64] % 300;
+				if (n > len - off)
+					n = len - off;
+				size_t max = b32 ? b32_stream_enc_max(&bs, n) : b64_stream_enc_max(&bs, n);
+				size_t ret = (b32 ? b32_stream_enc : b64_stream_enc)(&bs, &bin[off], n,
+											&enc[enc_len]);
+				NB_die_if(ret > max, "wrote %zu > max %zu", ret, max);
+				enc_len += ret;
+				off += n;
+			}
+			enc_len += (b32 ? b32_stream_enc_end : b64_stream_enc_end)(&bs, &enc[enc_len]);
+
+			size_t line = cols[c] / group * group;
+			line = line ? line + 1 : ref_len;
+			for (size_t i=0, r=0; i < enc_len; i++) {
+				if (line != ref_len && (i % line == line - 1 || i == enc_len - 1)) {
+					NB_die_if(enc[i] != '\n', "cols %zu: no newline @%zu", cols[c], i);
+				} else {
+					NB_die_if(enc[i] != ref[r++], "cols %zu: '%c' @%zu",
+						cols[c], enc[i], i);
+				}
+			}
+
+			/* decode */
+			for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+				if (b64_isa(isa) != isa)
+					continue;
+				base_stream_init(&bs, 0, 0);
+				size_t out_len = 0;
+				for (size_t off=0, i=0; off < enc_len; i++) {
+					size_t n = sizes[(i + isa) % 64] % 200;
+					if (n > enc_len - off)
+						n = enc_len - off;
+					ssize_t ret = (b32 ? b32_stream_dec : b64_stream_dec)(&bs,
+								&enc[off], n, &out[out_len]);
+					NB_die_if(ret < 0 || ret > (b32 ? B32_DEC_MAX(n) : B64_DEC_MAX(n)),
+						"decode @%zu: %zd", off, ret);
+					out_len += ret;
+					off += n;
+				}
+				ssize_t ret = (b32 ? b32_stream_dec_end : b64_stream_dec_end)(&bs,
+										&out[out_len]);
+				NB_die_if(ret < 0, "stream ended badly");
+				out_len += ret;
+				NB_die_if(out_len != len || memcmp(out, bin, len),
+					"b32 %d cols %zu level %u: decoded %zu != %zu",
+					b32, cols[c], isa, out_len, len);
+			}
+		}
+	}
+
+die:
+	b64_isa(HX_AVX512);
+	free(out);
+	free(enc);
+	free(ref);
+	free(bin);
+	return err_cnt;
+}
+
+
+/*	bench()
+
+Encode and decode throughput at each level available.
+*/
+int bench()
+{
+	int err_cnt = 0;
+	unsigned char *bin = malloc(BENCH_LEN);
+	char *enc = malloc(B32_ENC_LEN(BENCH_LEN) + 1);
+	NB_die_if(!bin || !enc, "");
+	pcg_randset(bin, BENCH_LEN, PCG_RAND_S1, PCG_RAND_S2);
+
+	for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+		if (b64_isa(isa) != isa)
+			continue;
+
+		nlc_timing_start(enc64);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			b2b64(bin, enc, BENCH_LEN, 0);
+		nlc_timing_stop(enc64);
+
+		nlc_timing_start(dec64);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			NB_die_if(b642b(enc, B64_ENC_LEN(BENCH_LEN), bin, 0) != BENCH_LEN, "");
+		nlc_timing_stop(dec64);
+
+		nlc_timing_start(enc32);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			b2b32(bin, enc, BENCH_LEN, 0);
+		nlc_timing_stop(enc32);
+
+		nlc_timing_start(dec32);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			NB_die_if(b322b(enc, B32_ENC_LEN(BENCH_LEN), bin, 0) != BENCH_LEN, "");
+		nlc_timing_stop(dec32);
+
+		double mib = (double)BENCH_LEN * BENCH_ITER / (1024 * 1024);
+		NB_prn("level %u: MiB/s (binary) base64 encode %.0f, decode %.0f;"
+			" base32 encode %.0f, decode %.0f", isa,
+			mib / nlc_timing_wall(enc64), mib / nlc_timing_wall(dec64),
+			mib / nlc_timing_wall(enc32), mib / nlc_timing_wall(dec32));
+	}
+
+die:
+	b64_isa(HX_AVX512);
+	free(enc);
+	free(bin);
+	return err_cnt;
+}
+
+
+/*	main()
+returns 0 on success
+*/
+int main()
+{
+	int err_cnt = 0;
+	err_cnt += test_rfc();
+	err_cnt += test_bad();
+	err_cnt += test_simd();
+	err_cnt += test_stream();
+	err_cnt += bench();
+	return err_cnt;
+}
@@ -9,6 +9,15 @@ These functions can be used to parse and generate hexadecimal strings,
 
 #include <binhex.h>
 #include "ndebug.h"
+#include <pcg_rand.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define SIMD_MAX 4096	/* bytes */
+#define BENCH_LEN 65536	/* bytes */
+#define BENCH_ITER 2000
 
 
 /*	test_union_behavior()
@@ -162,6 +171,383 @@ int test_b2hx()
 }
 
 
+/*	test_simd()
+
+Every SIMD level available on this CPU gives the same results as scalar code:
+	for all lengths up to a few blocks and some long ones, at all alignments,
+	and with a non-hex character anywhere in the input.
+returns 0 on success
+*/
+int test_simd()
+{
+	int err_cnt = 0;
+	unsigned char *bin = malloc(SIMD_MAX + 64);
+	char *hex = malloc(SIMD_MAX * 2 + 128);
+	char *ref = malloc(SIMD_MAX * 2 + 128);
+	uint8_t *out = malloc(SIMD_MAX + 64);
+	uint8_t *out_ref = malloc(SIMD_MAX + 64);
+	NB_die_if(!bin || !hex || !ref || !out || !out_ref, "");
+	pcg_randset(bin, SIMD_MAX + 64, PCG_RAND_S1, PCG_RAND_S2);
+
+	size_t lens[300];
+	for (size_t i=0; i < 290; i++)
+		lens[i] = i;
+	for (size_t i=290; i < NLC_ARRAY_LEN(lens); i++)
+		lens[i] = SIMD_MAX - (i - 290) * 37;
+
+	for (unsigned isa = HX_SSE2; isa <= HX_AVX512; isa++) {
+		if (hx_isa(isa) != isa)
+			continue;
+		NB_inf("SIMD level %u", isa);
+
+		for (size_t i=0; i < NLC_ARRAY_LEN(lens); i++) {
+			size_t len = lens[i];
+			const unsigned char *b = &bin[i % 64];
+
+			/* encode */
+			hx_isa(HX_SCALAR);
+			size_t ref_cnt = b2hx(b, ref, len);
+			hx_isa(isa);
+			NB_die_if(b2hx(b, hex, len) != ref_cnt
+				|| (len && memcmp(hex, ref, len * 2 + 1)),
+				"b2hx len %zu", len);
+
+			hx_isa(HX_SCALAR);
+			ref_cnt = b2hx_BE(b, ref, len);
+			hx_isa(isa);
+			NB_die_if(b2hx_BE(b, hex, len) != ref_cnt
+				|| (len && memcmp(hex, ref, len * 2 + 1)),
+				"b2hx_BE len %zu", len);
+			if (!len)
+				continue;
+
+			/* decode at an unaligned start, from a shorter or longer string,
+			 * maybe with a bad character
+			 */
+			char *h = &ref[1 + i % 3];
+			memmove(h, ref, len * 2 + 1);
+			if (i % 5 == 0)
+				h[(i * 7919) % (len * 2)] = 'g' + i % 3;
+			size_t bytes = len - (i % 4 == 1) + (i % 4 == 2);
+
+			hx_isa(HX_SCALAR);
+			size_t n_ref = hx2b(h, out_ref, bytes);
+			hx_isa(isa);
+			NB_die_if(hx2b(h, out, bytes) != n_ref || memcmp(out, out_ref, bytes),
+				"hx2b len %zu bytes %zu", len, bytes);
+
+			hx_isa(HX_SCALAR);
+			n_ref = hx2b_BE(h, out_ref, bytes);
+			hx_isa(isa);
+			NB_die_if(hx2b_BE(h, out, bytes) != n_ref || memcmp(out, out_ref, bytes),
+				"hx2b_BE len %zu bytes %zu", len, bytes);
+		}
+	}
+
+die:
+	hx_isa(HX_AVX512);
+	free(out_ref);
+	free(out);
+	free(ref);
+	free(hex);
+	free(bin);
+	return err_cnt;
+}
+
+
+/*	test_stream()
+
+Encode random data in random-sized chunks, with and without line breaks:
+	the output is the same as b2hx_BE() on the whole, split into lines.
+Decode it back in random-sized chunks (splitting digit pairs, whitespace
+	and all) at every SIMD level; a bad character is reported where it is.
+returns 0 on success
+*/
+int test_stream()
+{
+	int err_cnt = 0;
+	const size_t len = 100000;
+	unsigned char *bin = malloc(len);
+	char *ref = malloc(len * 2 + 1);
+	char *hex = malloc(len * 3 + 2);
+	uint8_t *out = malloc(len + 1);
+	uint32_t sizes[64];
+	NB_die_if(!bin || !ref || !hex || !out, "");
+	pcg_randset(bin, len, PCG_RAND_S1, PCG_RAND_S2);
+	pcg_randset(sizes, sizeof(sizes), PCG_RAND_S2, PCG_RAND_S1);
+	b2hx_BE(bin, ref, len);
+
+	size_t cols[] = { 0, 30, 1, 7, 64 };
+	for (size_t c=0; c < NLC_ARRAY_LEN(cols); c++) {
+		struct hx_stream hs;
+		hx_stream_init(&hs, cols[c]);
+
+		/* encode */
+		size_t hex_len = 0;
+		for (size_t off=0, i=0; off < len; i++) {
+			size_t n = sizes[i % 64] % 300;
+			if (n > len - off)
+				n = len - off;
+			size_t max = hx_stream_enc_max(&hs, n);
+			size_t ret = hx_stream_enc(&hs, &bin[off], n, &hex[hex_len]);
+			NB_die_if(ret > max, "wrote %zu > max %zu", ret, max);
+			hex_len += ret;
+			off += n;
+		}
+		hex_len += hx_stream_enc_end(&hs, &hex[hex_len]);
+
+		size_t line = cols[c] ? cols[c] * 2 + 1 : len * 2;
+		for (size_t i=0, r=0; i < hex_len; i++) {
+			if (cols[c] && (i % line == line - 1 || i == hex_len - 1)) {
+				NB_die_if(hex[i] != '\n', "cols %zu: no newline @%zu", cols[c], i);
+			} else {
+				NB_die_if(hex[i] != ref[r++], "cols %zu: '%c' @%zu", cols[c], hex[i], i);
+			}
+		}
+
+		/* decode */
+		for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+			if (hx_isa(isa) != isa)
+				continue;
+			hx_stream_init(&hs, 0);
+			size_t out_len = 0;
+			for (size_t off=0, i=0; off < hex_len; i++) {
+				size_t n = sizes[(i + isa) % 64] % 200;
+				if (n > hex_len - off)
+					n = hex_len - off;
+				ssize_t ret = hx_stream_dec(&hs, &hex[off], n, &out[out_len]);
+				NB_die_if(ret < 0 || ret > (n + 1) / 2, "decode @%zu: %zd", off, ret);
+				out_len += ret;
+				off += n;
+			}
+			NB_die_if(hx_stream_dec_end(&hs), "lone digit left");
+			NB_die_if(out_len != len || memcmp(out, bin, len),
+				"cols %zu level %u: decoded %zu != %zu", cols[c], isa, out_len, len);
+		}
+	}
+
+	/* odd digits, whitespace and a bad character */
+	struct hx_stream hs;
+	hx_stream_init(&hs, 0);
+	const char *chunks[] = { "a", "b c", "\td\r\n", "e", "  f0", "1", "2", "x" };
+	ssize_t expect[] = { 0, 1, 1, 0, 1, 1, 0, -1 };
+	for (size_t i=0; i < NLC_ARRAY_LEN(chunks); i++) {
+		NB_die_if(hx_stream_dec(&hs, chunks[i], strlen(chunks[i]), out) != expect[i],
+			"chunk %zu '%s'", i, chunks[i]);
+	}
+	NB_die_if(hs.pos != 15, "bad character at %zu", hs.pos);
+	NB_die_if(hx_stream_dec_end(&hs) != 1, "lone '2' not reported");
+
+die:
+	hx_isa(HX_AVX512);
+	free(out);
+	free(hex);
+	free(ref);
+	free(bin);
+	return err_cnt;
+}
+
+
+/*	test_parse()
+
+Bulk parsing of delimited tokens gives the values hx2b_u64() gives for each
+	token, at every SIMD level and however small the output array;
+	bad tokens are reported at the right index and offset.
+returns 0 on success
+*/
+#define PARSE_TOKENS 100000
+
+struct parse_ref {
+	uint64_t	val;
+	size_t		offset;
+	int		code;
+	bool		zeroes;	/* leading zeroes beyond 16 digits */
+};
+
+/* Generate PARSE_TOKENS random tokens into 'text', their values into 'ref'.
+ * Returns length of 'text'.
+ */
+static size_t parse_gen(char *text, struct parse_ref *ref)
+{
+	const char *prefix[] = { "", "0x", "x", "h", "0h" };
+	const char *delim = " ,\t\n\r";
+	uint32_t rnd[6];
+	size_t pos = 0;
+	for (size_t i=0; i < PARSE_TOKENS; i++) {
+		pcg_randset(rnd, sizeof(rnd), PCG_RAND_S1 + i, PCG_RAND_S2);
+		ref[i] = (struct parse_ref){ .code = HX_TOK_OK };
+		size_t digits = 1 + rnd[0] % 16;
+		uint64_t val = ((uint64_t)rnd[1] << 32 | rnd[2]) >> (64 - digits * 4);
+
+		pos += sprintf(&text[pos], "%s", prefix[rnd[3] % NLC_ARRAY_LEN(prefix)]);
+		ref[i].offset = pos - strlen(prefix[rnd[3] % NLC_ARRAY_LEN(prefix)]);
+		switch (rnd[4] % 64) {
+		case 0:
+			ref[i].code = HX_TOK_BAD;
+			pos += sprintf(&text[pos], "%"PRIx64"g1", val);
+			break;
+		case 1:
+			ref[i].code = HX_TOK_RANGE;
+			pos += sprintf(&text[pos], "1%016"PRIx64, val);
+			break;
+		case 2:
+			ref[i].code = HX_TOK_EMPTY;
+			if (!(rnd[3] % NLC_ARRAY_LEN(prefix)))
+				pos += sprintf(&text[pos], "0x");
+			break;
+		case 3:
+			/* valid, longer than a vector */
+			memset(&text[pos], '0', 80);
+			pos += 80;
+			ref[i].zeroes = true;
+			/* fall through */
+		default:
+			ref[i].val = val;
+			pos += sprintf(&text[pos], rnd[4] & 0x100 ? "%"PRIX64 : "%"PRIx64, val);
+		}
+		for (size_t j = 0; j <= rnd[5] % 3; j++)
+			text[pos++] = delim[(rnd[5] >> (8 + j * 4)) % 5];
+	}
+	text[pos] = '\0';
+	return pos;
+}
+
+int test_parse()
+{
+	int err_cnt = 0;
+	char *text = malloc(PARSE_TOKENS * 120);
+	struct parse_ref *ref = malloc(PARSE_TOKENS * sizeof(*ref));
+	uint64_t *out = malloc(PARSE_TOKENS * sizeof(*out));
+	struct hx_tok_err *errs = malloc(PARSE_TOKENS * sizeof(*errs));
+	NB_die_if(!text || !ref || !out || !errs, "");
+	size_t len = parse_gen(text, ref);
+
+	/* per token: the values of hx2b_u64() (which only looks at 16 digits) */
+	for (size_t i=0; i < PARSE_TOKENS; i++) {
+		if (ref[i].code == HX_TOK_OK && !ref[i].zeroes) {
+			NB_die_if(hx2b_u64(&text[ref[i].offset]) != ref[i].val,
+				"token %zu: hx2b_u64 0x%"PRIx64, i, ref[i].val);
+		}
+	}
+
+	size_t out_max[] = { PARSE_TOKENS, 1, 7, 1000 };
+	for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+		if (hx_isa(isa) != isa)
+			continue;
+		for (size_t m=0; m < NLC_ARRAY_LEN(out_max); m++) {
+			struct hx_parse hp;
+			hx_parse_init(&hp, errs, PARSE_TOKENS / 2);
+			size_t n = 0;
+			while (hp.pos < len) {
+				size_t ret = hx_parse_u64(&hp, text, len, &out[n], out_max[m]);
+				NB_die_if(ret > out_max[m], "");
+				n += ret;
+			}
+			NB_die_if(n != PARSE_TOKENS || hp.tokens != n,
+				"level %u: %zu tokens of %d", isa, n, PARSE_TOKENS);
+
+			size_t e = 0;
+			for (size_t i=0; i < n; i++) {
+				NB_die_if(out[i] != ref[i].val, "level %u token %zu: 0x%"PRIx64
+					" != 0x%"PRIx64, isa, i, out[i], ref[i].val);
+				if (ref[i].code == HX_TOK_OK)
+					continue;
+				NB_die_if(e >= hp.err_cnt || errs[e].index != i
+					|| errs[e].offset != ref[i].offset || errs[e].code != ref[i].code,
+					"level %u token %zu: error not reported", isa, i);
+				e++;
+			}
+			NB_die_if(e != hp.err_cnt, "%zu errors reported, %zu expected",
+				hp.err_cnt, e);
+		}
+	}
+
+	/* edge cases */
+	struct hx_parse hp;
+	hx_parse_init(&hp, NULL, 0);
+	NB_die_if(hx_parse_u64(&hp, " ,\n", 3, out, 1) || hp.pos != 3, "delimiters only");
+	hx_parse_init(&hp, NULL, 0);
+	NB_die_if(hx_parse_u64(&hp, "ffffffffffffffff", 16, out, 1) != 1
+		|| out[0] != UINT64_MAX || hp.err_cnt, "UINT64_MAX");
+	hx_parse_init(&hp, NULL, 0);
+	NB_die_if(hx_parse_u64(&hp, "x", 1, out, 1) != 1 || hp.err_cnt != 1, "lone 'x'");
+
+die:
+	hx_isa(HX_AVX512);
+	free(errs);
+	free(out);
+	free(ref);
+	free(text);
+	return err_cnt;
+}
+
+
+/*	bench()
+
+Encode and decode throughput at each level available.
+*/
+int bench()
+{
+	int err_cnt = 0;
+	unsigned char *bin = malloc(BENCH_LEN);
+	char *hex = malloc(BENCH_LEN * 2 + 1);
+	char *text = malloc(PARSE_TOKENS * 120);
+	struct parse_ref *ref = malloc(PARSE_TOKENS * sizeof(*ref));
+	uint64_t *out = malloc(PARSE_TOKENS * sizeof(*out));
+	NB_die_if(!bin || !hex || !text || !ref || !out, "");
+	pcg_randset(bin, BENCH_LEN, PCG_RAND_S1, PCG_RAND_S2);
+
+	for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+		if (hx_isa(isa) != isa)
+			continue;
+
+		nlc_timing_start(enc);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			b2hx(bin, hex, BENCH_LEN);
+		nlc_timing_stop(enc);
+
+		nlc_timing_start(dec);
+		for (size_t i=0; i < BENCH_ITER; i++)
+			NB_die_if(hx2b(hex, bin, BENCH_LEN) != BENCH_LEN * 2, "");
+		nlc_timing_stop(dec);
+
+		double mib = (double)BENCH_LEN * BENCH_ITER / (1024 * 1024);
+		NB_prn("level %u: MiB/s (binary) encode %.0f, decode %.0f", isa,
+			mib / nlc_timing_wall(enc), mib / nlc_timing_wall(dec));
+	}
+
+	/* token parsing: bulk, against hx2b_u64() on each token */
+	size_t len = parse_gen(text, ref);
+
+	nlc_timing_start(single);
+	for (size_t i=0; i < PARSE_TOKENS; i++)
+		out[i] = hx2b_u64(&text[ref[i].offset]);
+	nlc_timing_stop(single);
+
+	for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+		if (hx_isa(isa) != isa)
+			continue;
+		struct hx_parse hp;
+		hx_parse_init(&hp, NULL, 0);
+		nlc_timing_start(bulk);
+		NB_die_if(hx_parse_u64(&hp, text, len, out, PARSE_TOKENS) != PARSE_TOKENS, "");
+		nlc_timing_stop(bulk);
+		NB_prn("level %u: Mtokens/s bulk %.1f; hx2b_u64() per token %.1f", isa,
+			PARSE_TOKENS / nlc_timing_wall(bulk) / 1e6,
+			PARSE_TOKENS / nlc_timing_wall(single) / 1e6);
+	}
+
+die:
+	hx_isa(HX_AVX512);
+	free(out);
+	free(ref);
+	free(text);
+	free(hex);
+	free(bin);
+	return err_cnt;
+}
+
+
 /*	main()
 returns 0 on success
 */
@@ -173,6 +559,10 @@ int main()
 		"Broken on this platform! Don't use!");
 	err_cnt += test_hx2b();
 	err_cnt += test_b2hx();
+	err_cnt += test_simd();
+	err_cnt += test_stream();
+	err_cnt += test_parse();
+	err_cnt += bench();
 
 die:
 	return err_cnt;
@@ -0,0 +1,196 @@
+/*	bloom_test.c
+Correctness of the bloom filter: no false negatives, false-positive rate
+	near what sizing promises, batch vs. single operations, deletes
+	(counting filter), save and re-open from a file;
+	and a benchmark of single vs. batch queries.
+*/
+
+#include <bloom.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+#include <pcg_rand.h>
+
+#include <stdlib.h>
+#include <unistd.h> /* unlink() */
+
+
+#define FILE_PATH "./bloom_test.bin"
+
+
+
+/*	fp_rate()
+Query 'cnt' keys (none of which were added) at 'keys';
+	return the fraction found.
+*/
+static double fp_rate(const struct bloom *bf, const uint64_t *keys, size_t cnt)
+{
+	size_t fp = 0;
+	for (size_t i=0; i < cnt; i++)
+		fp += !!bloom_has(bf, &keys[i], sizeof(keys[i]));
+	return (double)fp / cnt;
+}
+
+
+
+/*	check()
+Add 'n' random keys to a filter of 'bits' bits per key (half singly, half in batch);
+	query them back, and 'n' others for false positives.
+If 'flags' is BLOOM_COUNTING, delete a second set of keys
+	and verify the first is unaffected.
+
+returns 0 on success
+*/
+static int check(size_t n, unsigned bits, uint32_t flags, double max_fp)
+{
+	int err_cnt = 0;
+	struct bloom *bf = NULL;
+	struct bloom *rd = NULL;
+	uint64_t *keys = NULL;
+	const void **ptrs = NULL;
+	size_t *lens = NULL;
+	uint8_t *found = NULL;
+
+	/* 'n' members, 'n' non-members, 'n' to be deleted */
+	NB_die_if(!(keys = malloc(3 * n * sizeof(*keys))), "");
+	NB_die_if(!(ptrs = malloc(3 * n * sizeof(*ptrs))), "");
+	NB_die_if(!(lens = malloc(3 * n * sizeof(*lens))), "");
+	NB_die_if(!(found = malloc(3 * n)), "");
+	pcg_randset(keys, 3 * n * sizeof(*keys), PCG_RAND_S1, PCG_RAND_S2);
+	for (size_t i=0; i < 3 * n; i++) {
+		ptrs[i] = &keys[i];
+		lens[i] = sizeof(keys[i]);
+	}
+
+	NB_die_if(!(bf = bloom_new(n, bits, flags)), "");
+	for (size_t i=0; i < n / 2; i++)
+		NB_die_if(bloom_add(bf, &keys[i], sizeof(keys[i])), "");
+	NB_die_if(bloom_add_batch(bf, &ptrs[n / 2], &lens[n / 2], n - n / 2), "");
+
+	/* no false negatives; batch agrees */
+	for (size_t i=0; i < n; i++)
+		NB_die_if(!bloom_has(bf, &keys[i], sizeof(keys[i])), "false negative %zu", i);
+	NB_die_if(bloom_has_batch(bf, ptrs, lens, n, found) != n, "batch false negative");
+	size_t fp = bloom_has_batch(bf, &ptrs[n], &lens[n], n, found);
+	for (size_t i=0; i < n; i++)
+		NB_die_if(found[i] != !!bloom_has(bf, &keys[n + i], sizeof(keys[0])),
+			"batch disagrees on %zu", n + i);
+
+	double rate = fp_rate(bf, &keys[n], n);
+	NB_die_if(rate != (double)fp / n, "");
+	NB_inf("%zu keys, %u bits/key%s: false positives %.3f%%",
+		n, bits, flags & BLOOM_COUNTING ? " (counting)" : "", rate * 100);
+	NB_die_if(rate > max_fp, "false positive rate %f > %f", rate, max_fp);
+
+	if (flags & BLOOM_COUNTING) {
+		NB_die_if(bloom_add_batch(bf, &ptrs[2 * n], &lens[2 * n], n), "");
+		NB_die_if(bf->hdr->count != 2 * n, "count %"PRIu64, bf->hdr->count);
+		for (size_t i=2 * n; i < 3 * n; i++)
+			NB_die_if(bloom_del(bf, &keys[i], sizeof(keys[i])), "del %zu", i);
+		NB_die_if(bf->hdr->count != n, "count %"PRIu64, bf->hdr->count);
+		NB_die_if(bloom_has_batch(bf, ptrs, lens, n, found) != n,
+			"false negative after deletes");
+		/* deleted keys are back to the rate of keys never added */
+		rate = fp_rate(bf, &keys[2 * n], n);
+		NB_die_if(rate > max_fp, "deleted keys: false positive rate %f", rate);
+	} else {
+		NB_die_if(!bloom_del(bf, &keys[0], sizeof(keys[0])), "delete from non-counting");
+	}
+
+	/* save, re-open: same answers; read-only */
+	NB_die_if(bloom_save(bf, FILE_PATH), "");
+	NB_die_if(!(rd = bloom_open(FILE_PATH)), "");
+	for (size_t i=0; i < 2 * n; i++)
+		NB_die_if(!bloom_has(rd, &keys[i], sizeof(keys[0]))
+			!= !bloom_has(bf, &keys[i], sizeof(keys[0])), "reopened disagrees %zu", i);
+	NB_die_if(!bloom_add(rd, &keys[0], sizeof(keys[0])), "add to read-only");
+
+die:
+	unlink(FILE_PATH);
+	bloom_free(rd);
+	bloom_free(bf);
+	free(found);
+	free(lens);
+	free(ptrs);
+	free(keys);
+	return err_cnt;
+}
+
+
+
+/*	bench()
+Time queries of 'n' keys (half present) against a filter of 'n' keys,
+	one by one and in batches.
+
+returns 0 on success
+*/
+static int bench(size_t n)
+{
+	int err_cnt = 0;
+	struct bloom *bf = NULL;
+	uint64_t *keys = NULL;
+	const void **ptrs = NULL;
+	size_t *lens = NULL;
+	uint8_t *found = NULL;
+
+	NB_die_if(!(keys = malloc(2 * n * sizeof(*keys))), "");
+	NB_die_if(!(ptrs = malloc(2 * n * sizeof(*ptrs))), "");
+	NB_die_if(!(lens = malloc(2 * n * sizeof(*lens))), "");
+	NB_die_if(!(found = malloc(n)), "");
+	pcg_randset(keys, 2 * n * sizeof(*keys), PCG_RAND_S1, PCG_RAND_S2);
+	for (size_t i=0; i < 2 * n; i++) {
+		ptrs[i] = &keys[i];
+		lens[i] = sizeof(keys[i]);
+	}
+
+	NB_die_if(!(bf = bloom_new(n, 10, 0)), "");
+	nlc_timing_start(add);
+	NB_die_if(bloom_add_batch(bf, ptrs, lens, n), "");
+	nlc_timing_stop(add);
+
+	size_t single = 0;
+	nlc_timing_start(has);
+	for (size_t i=n / 2; i < n / 2 + n; i++)
+		single += !!bloom_has(bf, &keys[i], sizeof(keys[i]));
+	nlc_timing_stop(has);
+
+	nlc_timing_start(batch);
+	size_t batch = bloom_has_batch(bf, &ptrs[n / 2], &lens[n / 2], n, found);
+	nlc_timing_stop(batch);
+	NB_die_if(single != batch, "single %zu != batch %zu", single, batch);
+
+	NB_prn("%zu keys (%zu MiB): add batch %.3fs; query %.3fs, batch %.3fs",
+		n, bf->nm.len >> 20, nlc_timing_wall(add),
+		nlc_timing_wall(has), nlc_timing_wall(batch));
+
+die:
+	bloom_free(bf);
+	free(found);
+	free(lens);
+	free(ptrs);
+	free(keys);
+	return err_cnt;
+}
+
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	err_cnt += check(100000, 8, 0, 0.035);
+	err_cnt += check(100000, 10, 0, 0.015);
+	err_cnt += check(100000, 16, 0, 0.003);
+	err_cnt += check(100000, 10, BLOOM_COUNTING, 0.025);
+	err_cnt += check(10, 10, 0, 0.5);
+
+	/* n * bits_per_key wraps to 16 bits: refused, not a tiny filter */
+	struct bloom *wrap = bloom_new(SIZE_MAX / 16 + 2, 16, 0);
+	NB_err_if(wrap != NULL, "%zu keys accepted", SIZE_MAX / 16 + 2);
+	bloom_free(wrap);
+
+	err_cnt += bench(10000000);
+
+	return err_cnt;
+}
@@ -0,0 +1,198 @@
+/*	cdc_test.c
+Content-defined chunking: vector scans (at each level available) and the
+	scalar scan agree; chunk sizes stay
+	within bounds and average near 'avg'; an insertion near the start of the
+	data leaves (almost) all other chunks unchanged;
+	and throughput of the scan, with and without digests.
+*/
+
+#include <cdc.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+#include <pcg_rand.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DATA_LEN (64 * 1024 * 1024)
+
+
+
+/*	check()
+Chunk 'data' with 'cdc'; verify bounds and vector/scalar agreement;
+	if 'random', that the mean chunk size is near 'avg'.
+
+returns 0 on success
+*/
+static int check(const struct cdc *cdc, const uint8_t *data, size_t len, bool random)
+{
+	int err_cnt = 0;
+	size_t chunks = 0;
+
+	for (size_t off = 0; off < len; chunks++) {
+		size_t chunk = cdc_next(cdc, &data[off], len - off);
+		size_t ref = cdc_next_scalar(cdc, &data[off], len - off);
+		NB_die_if(chunk != ref, "@%zu: vector %zu != scalar %zu", off, chunk, ref);
+		NB_die_if(chunk > cdc->max || (chunk < cdc->min && off + chunk != len),
+			"@%zu: chunk %zu out of [%zu, %zu]", off, chunk, cdc->min, cdc->max);
+		off += chunk;
+	}
+
+	size_t mean = len / chunks;
+	NB_inf("min %zu avg %zu max %zu: %zu chunks, mean %zu",
+		cdc->min, cdc->avg, cdc->max, chunks, mean);
+	NB_die_if(random && (mean < cdc->avg / 2 || mean > cdc->avg * 2),
+		"mean chunk %zu", mean);
+
+die:
+	return err_cnt;
+}
+
+
+/*	dedup()
+Insert a few bytes near the start of 'data'; verify that the chunks of the
+	original and modified data are the same but for those around the insertion.
+
+returns 0 on success
+*/
+static int dedup(const struct cdc *cdc, const uint8_t *data, size_t len)
+{
+	int err_cnt = 0;
+	struct cdc_chunk *a = NULL, *b = NULL;
+	uint8_t *mod = NULL;
+	size_t max = len / cdc->min + 1;
+
+	NB_die_if(!(mod = malloc(len + 7)), "");
+	memcpy(mod, data, 1000);
+	memcpy(&mod[1000], "inserted", 7);
+	memcpy(&mod[1007], &data[1000], len - 1000);
+
+	NB_die_if(!(a = malloc(max * sizeof(*a))), "");
+	NB_die_if(!(b = malloc(max * sizeof(*b))), "");
+	size_t na = cdc_chunks(cdc, data, len, a, max);
+	size_t nb = cdc_chunks(cdc, mod, len + 7, b, max);
+	NB_die_if(a[na-1].offset + a[na-1].len != len, "chunks do not cover data");
+
+	/* chunks before the insertion are the same; after it, chunk lists
+	 * re-synchronize: compare heads and tails
+	 */
+	size_t head = 0;
+	for (; head < na && a[head].offset + a[head].len <= 1000; head++) {
+		NB_die_if(a[head].digest != b[head].digest, "chunk %zu before insertion", head);
+	}
+	size_t same = head;
+	for (size_t i=1; i <= na - head && i <= nb - head; i++) {
+		if (a[na - i].digest != b[nb - i].digest)
+			break;
+		NB_die_if(a[na - i].len != b[nb - i].len, "digest equal, length not");
+		same++;
+	}
+	NB_inf("after a 7B insertion: %zu of %zu chunks unchanged", same, na);
+	NB_die_if(same + 3 < na, "insertion changed %zu chunks", na - same);
+
+die:
+	free(b);
+	free(a);
+	free(mod);
+	return err_cnt;
+}
+
+
+/*	bench()
+*/
+static int bench(const uint8_t *data, size_t len)
+{
+	int err_cnt = 0;
+	struct cdc cdc;
+	struct cdc_chunk *out = NULL;
+	size_t sum = 0;
+
+	NB_die_if(cdc_init(&cdc, 2048, 8192, 65536, 0), "");
+	size_t max = len / cdc.min + 1;
+	NB_die_if(!(out = malloc(max * sizeof(*out))), "");
+
+	nlc_timing_start(scalar);
+	for (size_t off = 0; off < len; )
+		off += cdc_next_scalar(&cdc, &data[off], len - off);
+	nlc_timing_stop(scalar);
+
+	double vector[HX_AVX512 + 1] = { 0 };
+	for (unsigned isa = HX_AVX2; isa <= HX_AVX512; isa++) {
+		if (cdc_isa(isa) != isa)
+			continue;
+		nlc_timing_start(t_vector);
+		for (size_t off = 0; off < len; )
+			off += cdc_next(&cdc, &data[off], len - off);
+		nlc_timing_stop(t_vector);
+		vector[isa] = nlc_timing_wall(t_vector);
+	}
+
+	nlc_timing_start(fast);
+	sum += cdc_chunks(&cdc, data, len, out, max);
+	nlc_timing_stop(fast);
+
+	NB_die_if(cdc_init(&cdc, 2048, 8192, 65536, CDC_FNV1A), "");
+	nlc_timing_start(fnv1a);
+	sum -= cdc_chunks(&cdc, data, len, out, max);
+	nlc_timing_stop(fnv1a);
+	NB_die_if(sum, "");
+
+	double mib = (double)len / (1024 * 1024);
+	NB_prn("MiB/s: scan scalar %.0f, AVX2 %.0f, AVX-512 %.0f; chunk+digest fast %.0f, fnv1a %.0f",
+		mib / nlc_timing_wall(scalar),
+		vector[HX_AVX2] ? mib / vector[HX_AVX2] : 0,
+		vector[HX_AVX512] ? mib / vector[HX_AVX512] : 0,
+		mib / nlc_timing_wall(fast), mib / nlc_timing_wall(fnv1a));
+
+die:
+	free(out);
+	return err_cnt;
+}
+
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	struct cdc cdc;
+	uint8_t *data = malloc(DATA_LEN);
+	NB_die_if(!data, "");
+	pcg_randset(data, DATA_LEN, PCG_RAND_S1, PCG_RAND_S2);
+
+	NB_die_if(cdc_init(&cdc, 63, 128, 256, 0) == 0, "min below CDC_MIN");
+	NB_die_if(cdc_init(&cdc, 4096, 2048, 8192, 0) == 0, "min above avg");
+
+	size_t params[][3] = {
+		{ 64, 256, 1024 },
+		{ 2048, 8192, 65536 },
+		{ 16384, 65536, 262144 },
+		{ 100, 1000, 1500 }
+	};
+	for (unsigned isa = HX_SCALAR; isa <= HX_AVX512; isa++) {
+		if (cdc_isa(isa) != isa)
+			continue;
+		for (size_t i=0; i < NLC_ARRAY_LEN(params); i++) {
+			NB_die_if(cdc_init(&cdc, params[i][0], params[i][1], params[i][2], 0), "");
+			err_cnt += check(&cdc, data, DATA_LEN / 8, true);
+			/* short and constant data */
+			err_cnt += check(&cdc, data, params[i][0] + 17, false);
+			memset(data, 0xaa, params[i][2] * 3);
+			err_cnt += check(&cdc, data, params[i][2] * 3, false);
+			pcg_randset(data, params[i][2] * 3, PCG_RAND_S1, PCG_RAND_S2);
+		}
+	}
+	for (size_t i=0; i < NLC_ARRAY_LEN(params); i++) {
+		NB_die_if(cdc_init(&cdc, params[i][0], params[i][1], params[i][2], 0), "");
+		err_cnt += dedup(&cdc, data, DATA_LEN / 8);
+	}
+
+	err_cnt += bench(data, DATA_LEN);
+
+die:
+	free(data);
+	return err_cnt;
+}
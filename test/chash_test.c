@@ -0,0 +1,231 @@
+/*	chash_test.c
+Consistent hashing: balance (by weight) and minimal movement on membership
+	changes, for jump hashing, rendezvous hashing and the routing table;
+	and a benchmark of lookup cost against node count.
+*/
+
+#include <chash.h>
+#include <fnv.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <stdlib.h>
+#include <stdio.h> /* snprintf() */
+#include <string.h> /* memcpy() */
+
+
+#define KEYS 200000
+
+
+
+/*	key_hash()
+The fnv_hash64() of the 'i'th test key.
+*/
+static uint64_t key_hash(size_t i)
+{
+	char key[32];
+	int len = snprintf(key, sizeof(key), "cache/key/%zu", i);
+	return fnv_hash64(NULL, key, len);
+}
+
+
+/*	add_nodes()
+Add 'n' nodes named "node-<i>" of weight 1.
+*/
+static int add_nodes(struct chash *ch, size_t n)
+{
+	int err_cnt = 0;
+	for (size_t i=0; i < n; i++) {
+		char id[32];
+		int len = snprintf(id, sizeof(id), "node-%zu", ch->cnt);
+		NB_die_if(chash_add(ch, id, len, 1) < 0, "");
+	}
+die:
+	return err_cnt;
+}
+
+
+/*	balanced()
+Verify counts of keys per node are within 'tol' of 'keys * weight[i] / total weight'.
+*/
+static int balanced(const size_t *cnt, const float *weight, size_t nodes, double tol)
+{
+	int err_cnt = 0;
+	double total = 0;
+	for (size_t i=0; i < nodes; i++)
+		total += weight[i];
+	for (size_t i=0; i < nodes; i++) {
+		double expect = KEYS * weight[i] / total;
+		NB_die_if(cnt[i] < expect * (1 - tol) || cnt[i] > expect * (1 + tol),
+			"node %zu: %zu keys, expected %.0f", i, cnt[i], expect);
+	}
+die:
+	return err_cnt;
+}
+
+
+
+/*	test_jump()
+*/
+static int test_jump()
+{
+	int err_cnt = 0;
+	size_t cnt[65] = { 0 };
+	float weight[65];
+	for (size_t i=0; i < 65; i++)
+		weight[i] = 1;
+
+	NB_die_if(chash_jump(1, 0) != -1, "");
+	for (size_t i=0; i < KEYS; i++) {
+		uint64_t h = key_hash(i);
+		int32_t b64 = chash_jump(h, 64);
+		int32_t b65 = chash_jump(h, 65);
+		NB_die_if(b64 < 0 || b64 >= 64, "bucket %d", b64);
+		/* a key moves only to the new bucket */
+		NB_die_if(b65 != b64 && b65 != 64, "key %zu: %d -> %d", i, b64, b65);
+		cnt[b65]++;
+	}
+	NB_die_if(balanced(cnt, weight, 65, 0.15), "");
+
+die:
+	return err_cnt;
+}
+
+
+/*	test_hrw()
+Balance with equal and unequal weights; only keys of a removed node move,
+	only keys to an added node move; the table agrees with its own slots.
+*/
+static int test_hrw()
+{
+	int err_cnt = 0;
+	struct chash *ch = NULL;
+	ssize_t *before = NULL;
+	size_t cnt[100] = { 0 };
+
+	NB_die_if(!(ch = chash_new()), "");
+	NB_die_if(chash_hrw(ch, 1) != -1, "no nodes");
+	NB_die_if(!chash_table(ch, 8), "table of no nodes");
+	NB_die_if(add_nodes(ch, 99), "");
+	NB_die_if(!(before = malloc(KEYS * sizeof(*before))), "");
+
+	/* weights whose inverse is not finite */
+	NB_die_if(chash_weight(ch, 0, 1e-39f) == 0, "weight 1e-39 accepted");
+	NB_die_if(chash_weight(ch, 0, -1) == 0, "weight -1 accepted");
+	NB_die_if(chash_add(ch, "tiny", 4, 1e-39f) != -1, "node of weight 1e-39 added");
+	NB_die_if(ch->weight[0] != 1, "");
+
+	/* node 0 weighs 4 */
+	NB_die_if(chash_weight(ch, 0, 4), "");
+	for (size_t i=0; i < KEYS; i++) {
+		NB_die_if((before[i] = chash_hrw(ch, key_hash(i))) < 0, "");
+		cnt[before[i]]++;
+	}
+	NB_die_if(balanced(cnt, ch->weight, 99, 0.2), "");
+
+	/* remove node 7: only its keys move */
+	NB_die_if(chash_weight(ch, 7, 0), "");
+	for (size_t i=0; i < KEYS; i++) {
+		ssize_t node = chash_hrw(ch, key_hash(i));
+		NB_die_if(node == 7, "removed node picked");
+		NB_die_if(node != before[i] && before[i] != 7, "key %zu moved needlessly", i);
+		before[i] = node;
+	}
+
+	/* add node 99: only keys to it move */
+	NB_die_if(add_nodes(ch, 1), "");
+	size_t moved = 0;
+	for (size_t i=0; i < KEYS; i++) {
+		ssize_t node = chash_hrw(ch, key_hash(i));
+		NB_die_if(node != before[i] && node != 99, "key %zu moved needlessly", i);
+		moved += (node != before[i]);
+	}
+	NB_inf("adding 1 node to 98 (weights 101) moved %.2f%% of keys",
+		(double)moved * 100 / KEYS);
+
+	/* table */
+	NB_die_if(chash_table(ch, 16), "");
+	uint32_t *table = malloc(sizeof(uint32_t) << 16);
+	NB_die_if(!table, "");
+	memcpy(table, ch->table, sizeof(uint32_t) << 16);
+	for (size_t i=0; i < KEYS; i++) {
+		uint64_t h = key_hash(i);
+		NB_die_if(chash_route(ch, h) != ch->table[h >> 48], "");
+	}
+	NB_die_if(chash_weight(ch, 3, 0) || chash_table(ch, 16), "");
+	for (size_t i=0; i < (1 << 16); i++) {
+		NB_die_if(ch->table[i] == 3, "removed node in table");
+		NB_die_if(ch->table[i] != table[i] && table[i] != 3, "slot %zu moved needlessly", i);
+	}
+	free(table);
+
+die:
+	free(before);
+	chash_free(ch);
+	return err_cnt;
+}
+
+
+
+/*	bench()
+Cost of a lookup by node count: jump, rendezvous, table.
+*/
+static int bench()
+{
+	int err_cnt = 0;
+	struct chash *ch = NULL;
+	const size_t lookups = 1000000;
+	uint64_t sum = 0;
+
+	NB_prn("nodes: ns per lookup, jump / hrw / table; table build (ms)");
+	for (size_t nodes = 64; nodes <= 512; nodes *= 2) {
+		NB_die_if(!(ch = chash_new()), "");
+		NB_die_if(add_nodes(ch, nodes), "");
+
+		nlc_timing_start(jump);
+		for (size_t i=0; i < lookups; i++)
+			sum += chash_jump(i * 0x9e3779b97f4a7c15, nodes);
+		nlc_timing_stop(jump);
+
+		nlc_timing_start(hrw);
+		for (size_t i=0; i < lookups / 10; i++)
+			sum += chash_hrw(ch, i * 0x9e3779b97f4a7c15);
+		nlc_timing_stop(hrw);
+
+		nlc_timing_start(build);
+		NB_die_if(chash_table(ch, 16), "");
+		nlc_timing_stop(build);
+
+		nlc_timing_start(route);
+		for (size_t i=0; i < lookups; i++)
+			sum += chash_route(ch, i * 0x9e3779b97f4a7c15);
+		nlc_timing_stop(route);
+
+		NB_prn("%4zu: %6.1f / %6.1f / %6.1f; %.1f", nodes,
+			nlc_timing_wall(jump) * 1e9 / lookups,
+			nlc_timing_wall(hrw) * 1e9 / (lookups / 10),
+			nlc_timing_wall(route) * 1e9 / lookups,
+			nlc_timing_wall(build) * 1e3);
+
+		chash_free(ch);
+		ch = NULL;
+	}
+	NB_inf("(checksum %"PRIu64")", sum);
+
+die:
+	chash_free(ch);
+	return err_cnt;
+}
+
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	err_cnt += test_jump();
+	err_cnt += test_hrw();
+	err_cnt += bench();
+	return err_cnt;
+}
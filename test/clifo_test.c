@@ -0,0 +1,211 @@
+/*	clifo_test.c
+
+Concurrent LIFO: order when single-threaded; no value lost or duplicated
+	with threads pushing and popping at once;
+	and throughput against a mutex-wrapped lifo, by number of threads.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#include <clifo.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <pthread.h>
+#include <stdlib.h> /* getenv() */
+
+
+#define THREADS_MAX 8
+
+
+/*	test_order()
+*/
+int test_order(size_t numiter)
+{
+	int err_cnt = 0;
+	struct clifo *cl = NULL;
+	NB_die_if(!(cl = clifo_new()), "");
+
+	/* twice: the second time, nodes come off the free stack */
+	for (int round=0; round < 2; round++) {
+		for (LIFO_MEM_TYPE i=0; i < numiter; i++) {
+			NB_die_if(clifo_push(cl, i), "push %zu", i);
+		}
+		LIFO_MEM_TYPE pop;
+		for (LIFO_MEM_TYPE i=numiter; i > 0; i--) {
+			NB_die_if(clifo_pop(cl, &pop), "pop %zu", i - 1);
+			NB_die_if(pop != i - 1, "pop %zu != %zu", pop, i - 1);
+		}
+		NB_die_if(!clifo_pop(cl, &pop), "pop from empty stack");
+	}
+	NB_die_if(cl->alloc != numiter, "%"PRIu64" nodes for %zu values", cl->alloc, numiter);
+
+die:
+	clifo_free(cl);
+	return err_cnt;
+}
+
+
+/*	worker
+Each worker pushes its own range of values and pops whatever it gets,
+	counting what it popped into 'seen'.
+*/
+struct worker {
+	pthread_t	tid;
+	struct clifo	*cl;
+	size_t		id;
+	size_t		numiter;
+	uint8_t		*seen;		/* one counter per value, shared */
+	int		err_cnt;
+};
+
+void *worker(void *arg)
+{
+	struct worker *w = arg;
+	LIFO_MEM_TYPE base = w->id * w->numiter;
+	LIFO_MEM_TYPE pop;
+	for (size_t i=0; i < w->numiter; i++) {
+		w->err_cnt += clifo_push(w->cl, base + i);
+		/* pop some of the time: the stack holds a mix of all threads' values */
+		if ((i & 3) != 3 && !clifo_pop(w->cl, &pop))
+			__atomic_fetch_add(&w->seen[pop], 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+
+/*	test_threads()
+*/
+int test_threads(size_t threads, size_t numiter)
+{
+	int err_cnt = 0;
+	struct clifo *cl = NULL;
+	uint8_t *seen = NULL;
+	struct worker w[THREADS_MAX] = { { 0 } };
+
+	NB_die_if(!(cl = clifo_new()), "");
+	NB_die_if(!(seen = calloc(threads * numiter, 1)), "");
+	for (size_t i=0; i < threads; i++) {
+		w[i] = (struct worker){ .cl = cl, .id = i, .numiter = numiter, .seen = seen };
+		NB_die_if(pthread_create(&w[i].tid, NULL, worker, &w[i]), "");
+	}
+	for (size_t i=0; i < threads; i++) {
+		pthread_join(w[i].tid, NULL);
+		err_cnt += w[i].err_cnt;
+	}
+
+	/* drain: every value seen exactly once */
+	LIFO_MEM_TYPE pop;
+	while (!clifo_pop(cl, &pop))
+		seen[pop]++;
+	for (size_t i=0; i < threads * numiter; i++) {
+		NB_die_if(seen[i] != 1, "%zu threads: value %zu seen %d times",
+			threads, i, seen[i]);
+	}
+
+die:
+	free(seen);
+	clifo_free(cl);
+	return err_cnt;
+}
+
+
+/*	bench
+Push/pop pairs from every thread: clifo against lifo with a mutex.
+*/
+struct bench {
+	pthread_t	tid;
+	struct clifo	*cl;
+	struct lifo	**stk;
+	pthread_mutex_t	*lock;
+	size_t		numiter;
+};
+
+void *bench_clifo(void *arg)
+{
+	struct bench *b = arg;
+	LIFO_MEM_TYPE pop;
+	for (size_t i=0; i < b->numiter; i++) {
+		clifo_push(b->cl, i);
+		clifo_pop(b->cl, &pop);
+	}
+	return NULL;
+}
+
+void *bench_mutex(void *arg)
+{
+	struct bench *b = arg;
+	LIFO_MEM_TYPE pop;
+	for (size_t i=0; i < b->numiter; i++) {
+		pthread_mutex_lock(b->lock);
+		lifo_push(b->stk, i);
+		pthread_mutex_unlock(b->lock);
+		pthread_mutex_lock(b->lock);
+		lifo_pop(*b->stk, &pop);
+		pthread_mutex_unlock(b->lock);
+	}
+	return NULL;
+}
+
+int bench(size_t numiter)
+{
+	int err_cnt = 0;
+	struct clifo *cl = NULL;
+	struct lifo *stk = NULL;
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	struct bench b[THREADS_MAX];
+
+	NB_die_if(!(cl = clifo_new()), "");
+	NB_die_if(!(stk = lifo_new()), "");
+
+	for (size_t threads=1; threads <= THREADS_MAX; threads *= 2) {
+		size_t per = numiter / threads;
+		for (size_t i=0; i < threads; i++)
+			b[i] = (struct bench){ .cl = cl, .stk = &stk, .lock = &lock, .numiter = per };
+
+		nlc_timing_start(lockfree);
+		for (size_t i=0; i < threads; i++) {
+			NB_die_if(pthread_create(&b[i].tid, NULL, bench_clifo, &b[i]), "");
+		}
+		for (size_t i=0; i < threads; i++)
+			pthread_join(b[i].tid, NULL);
+		nlc_timing_stop(lockfree);
+
+		nlc_timing_start(mutex);
+		for (size_t i=0; i < threads; i++) {
+			NB_die_if(pthread_create(&b[i].tid, NULL, bench_mutex, &b[i]), "");
+		}
+		for (size_t i=0; i < threads; i++)
+			pthread_join(b[i].tid, NULL);
+		nlc_timing_stop(mutex);
+
+		double mops = (double)per * threads * 2 / 1e6;
+		NB_prn("%zu threads: Mops/s clifo %.1f, lifo+mutex %.1f", threads,
+			mops / nlc_timing_wall(lockfree), mops / nlc_timing_wall(mutex));
+	}
+
+die:
+	lifo_free(stk);
+	clifo_free(cl);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	/* do MUCH less work if VALGRIND environment variable is set */
+	size_t numiter = 1 << 20;
+	if (getenv("VALGRIND"))
+		numiter = 1 << 12;
+
+	err_cnt += test_order(numiter);
+	for (size_t threads=1; threads <= THREADS_MAX; threads *= 2)
+		err_cnt += test_threads(threads, numiter / threads);
+	err_cnt += bench(numiter * 4);
+
+	return err_cnt;
+}
@@ -1,5 +1,5 @@
 /*	fnv_test.c
-Designed to test the correctness of FNV1A (both 32-bit and 64-bit).
+Designed to test the correctness of FNV1A (32-bit, 64-bit and 128-bit).
 
 NOTE that while it would be nice to see a CRC32 comparison in here
 	(there was - and it was always beaten slightly by FNV32),
@@ -48,6 +48,28 @@ static const uint32_t out32[] = {
 	0x0d2b7f73,
 	0x6f93f02d
 };
+static const uint64_t out_fast64[] = {
+	0xe8609ced49069d95,
+	0x3927baf662e2eb84,
+	0xcd7062888aa38a39,
+	0x8402c6cd39910051,
+	0x6ab2a4a1775138cd,
+	0xecd355600602d1e8,
+	0x8bc38bc842747c2a,
+	0x0cdb00d343c25958
+};
+#ifdef __SIZEOF_INT128__
+static const uint64_t out128[][2] = {	/**< { high, low } */
+	{ 0x6c62272e07bb0142, 0x62b821756295c58d },
+	{ 0x44277a16f91ee613, 0xfe68853261156ce0 },
+	{ 0x1d1a8250ad235a5b, 0xc4b6635f195a6006 },
+	{ 0xe3f855f370643df8, 0x16d8999adb168caf },
+	{ 0xccb137d314bf33f8, 0x80b78477deae80bb },
+	{ 0x7281d32ee5e963ab, 0x52283de2b322386d },
+	{ 0xa109a64bee05375c, 0x0a6f57b80c5f31c3 },
+	{ 0x5a7bcefa1683d94f, 0x70814eb9d3708e05 }
+};
+#endif
 
 
 
@@ -102,6 +124,299 @@ int correctness()
 		/* 32-bit */
 		uint32_t res32 = fnv_hash32(NULL, phrases[i], strlen(phrases[i]));
 		NB_err_if(res32 != out32[i], "i=%"PRIuFAST16"; 0x%"PRIx32" != 0x%"PRIx32, i, res32, out32[i]);
+#ifdef __SIZEOF_INT128__
+		/* 128-bit */
+		fnv128_t res128 = fnv_hash128(NULL, phrases[i], strlen(phrases[i]));
+		NB_err_if((uint64_t)(res128 >> 64) != out128[i][0] || (uint64_t)res128 != out128[i][1],
+			"i=%"PRIuFAST16"; 0x%016"PRIx64"%016"PRIx64" != 0x%016"PRIx64"%016"PRIx64,
+			i, (uint64_t)(res128 >> 64), (uint64_t)res128, out128[i][0], out128[i][1]);
+		/* byte-by-byte continuation */
+		fnv128_t cont = fnv_hash128(NULL, NULL, 0);
+		for (size_t j=0; j < strlen(phrases[i]); j++)
+			cont = fnv_hash128(&cont, &phrases[i][j], 1);
+		NB_err_if(cont != res128, "i=%"PRIuFAST16"; 128-bit continuation differs", i);
+#endif
+	}
+
+	return err_cnt;
+}
+
+
+
+/*	batch()
+Batch hashing must give results identical to hashing each key on its own,
+	regardless of key lengths or how many keys are left over
+	after the last full group of lanes.
+Also time batched vs. per-key hashing of many short keys.
+
+returns 0 on success
+*/
+int batch()
+{
+	const size_t cnt = (1UL << 20) + 3; /* deliberately not a multiple of lanes */
+	const size_t max_len = 64;
+
+	int err_cnt = 0;
+	uint8_t *keys = NULL;
+	const void **data = NULL;
+	size_t *data_len = NULL;
+	uint64_t *res64 = NULL;
+	uint32_t *res32 = NULL;
+
+	NB_die_if(!(
+		keys = malloc(cnt * max_len)
+		), "malloc %zu", cnt * max_len);
+	NB_die_if(!(data = malloc(cnt * sizeof(*data))), "");
+	NB_die_if(!(data_len = malloc(cnt * sizeof(*data_len))), "");
+	NB_die_if(!(res64 = malloc(cnt * sizeof(*res64))), "");
+	NB_die_if(!(res32 = malloc(cnt * sizeof(*res32))), "");
+
+	/* Random keys of 8-64B.
+	 * Keys come in runs of similar length (as they would e.g. when hashing
+	 * a column of identifiers), with the odd empty key thrown in.
+	 * Runs are not a multiple of lanes: groups straddle runs.
+	 */
+	struct pcg_state rnd;
+	pcg_seed_static(&rnd);
+	pcg_set(&rnd, keys, cnt * max_len);
+	size_t run_len = 0;
+	for (size_t i=0; i < cnt; i++) {
+		if (!(i % 12))
+			run_len = 8 + pcg_rand_bound(&rnd, max_len - 11);
+		data[i] = &keys[i * max_len];
+		data_len[i] = run_len + pcg_rand_bound(&rnd, 4);
+		if (!(i % 1001))
+			data_len[i] = 0;
+	}
+	memset(res64, 0, cnt * sizeof(*res64));
+	memset(res32, 0, cnt * sizeof(*res32));
+
+	/* 64-bit */
+	nlc_timing_start(batch64);
+	fnv_hash64_batch(res64, data, data_len, cnt);
+	nlc_timing_stop(batch64);
+
+	nlc_timing_start(single64);
+	for (size_t i=0; i < cnt; i++) {
+		uint64_t res = fnv_hash64(NULL, data[i], data_len[i]);
+		NB_err_if(res != res64[i], "i=%zu; 0x%"PRIx64" != 0x%"PRIx64,
+			i, res64[i], res);
+	}
+	nlc_timing_stop(single64);
+	NB_prn("fnv_hash64_batch on %zu keys: %fs; per-key (and check): %fs",
+		cnt, nlc_timing_cpu(batch64), nlc_timing_cpu(single64));
+
+	/* 32-bit */
+	nlc_timing_start(batch32);
+	fnv_hash32_batch(res32, data, data_len, cnt);
+	nlc_timing_stop(batch32);
+
+	nlc_timing_start(single32);
+	for (size_t i=0; i < cnt; i++) {
+		uint32_t res = fnv_hash32(NULL, data[i], data_len[i]);
+		NB_err_if(res != res32[i], "i=%zu; 0x%"PRIx32" != 0x%"PRIx32,
+			i, res32[i], res);
+	}
+	nlc_timing_stop(single32);
+	NB_prn("fnv_hash32_batch on %zu keys: %fs; per-key (and check): %fs",
+		cnt, nlc_timing_cpu(batch32), nlc_timing_cpu(single32));
+
+	/* known-good values through the batch path */
+	const void *phr[NLC_ARRAY_LEN(phrases)];
+	size_t phr_len[NLC_ARRAY_LEN(phrases)];
+	for (size_t i=0; i < NLC_ARRAY_LEN(phrases); i++) {
+		phr[i] = phrases[i];
+		phr_len[i] = strlen(phrases[i]);
+	}
+	fnv_hash64_batch(res64, phr, phr_len, NLC_ARRAY_LEN(phrases));
+	fnv_hash32_batch(res32, phr, phr_len, NLC_ARRAY_LEN(phrases));
+	for (size_t i=0; i < NLC_ARRAY_LEN(phrases); i++) {
+		NB_err_if(res64[i] != out64[i], "i=%zu; 0x%"PRIx64" != 0x%"PRIx64,
+			i, res64[i], out64[i]);
+		NB_err_if(res32[i] != out32[i], "i=%zu; 0x%"PRIx32" != 0x%"PRIx32,
+			i, res32[i], out32[i]);
+	}
+
+die:
+	free(keys);
+	free(data);
+	free(data_len);
+	free(res64);
+	free(res32);
+	return err_cnt;
+}
+
+
+
+/*	tree()
+The tree hash must not depend on how leaves are split among workers:
+	hash leaves in uneven ranges and compare against fnv_tree_hash64().
+Also check the documented format against fnv_hash64() directly.
+
+returns 0 on success
+*/
+int tree()
+{
+	const size_t leaf = 4096;
+	const size_t sz = leaf * 37 + 123; /* short trailing leaf */
+
+	int err_cnt = 0;
+	uint8_t *data = NULL;
+	uint64_t *digests = NULL;
+
+	NB_die_if(!(data = malloc(sz)), "malloc %zu", sz);
+	pcg_randset(data, sz, PCG_RAND_S1, PCG_RAND_S2);
+
+	size_t leaves = fnv_tree_leaves(sz, leaf);
+	NB_die_if(leaves != 38, "%zu leaves", leaves);
+	NB_die_if(!(digests = malloc(leaves * sizeof(*digests))), "");
+
+	/* ranges of 1, 2, 3 ... leaves */
+	for (size_t first=0, cnt=1; first < leaves; first += cnt, cnt++) {
+		if (cnt > leaves - first)
+			cnt = leaves - first;
+		fnv_tree_leaf64(data, sz, leaf, first, cnt, &digests[first]);
+	}
+	uint64_t root = fnv_tree_root64(NULL, digests, leaves);
+	uint64_t serial = fnv_tree_hash64(data, sz, leaf);
+	NB_err_if(root != serial, "0x%"PRIx64" != 0x%"PRIx64, root, serial);
+
+	/* format: root is FNV1a over little-endian leaf digests */
+	uint64_t check = fnv_hash64(NULL, NULL, 0);
+	for (size_t i=0; i < leaves; i++) {
+		size_t len = i < leaves - 1 ? leaf : sz - i * leaf;
+		uint64_t digest = fnv_hash64(NULL, &data[i * leaf], len);
+		NB_err_if(digest != digests[i], "leaf %zu", i);
+		uint8_t le[8];
+		for (int j=0; j < 8; j++)
+			le[j] = digest >> (j * 8);
+		check = fnv_hash64(&check, le, sizeof(le));
+	}
+	NB_err_if(check != root, "0x%"PRIx64" != 0x%"PRIx64, check, root);
+
+	/* empty input is a single empty leaf */
+	uint64_t basis = fnv_hash64(NULL, NULL, 0);
+	NB_err_if(fnv_tree_hash64(NULL, 0, 0) != fnv_tree_root64(NULL, &basis, 1), "");
+
+die:
+	free(data);
+	free(digests);
+	return err_cnt;
+}
+
+
+
+/*	fast()
+Check fnv_fast64() against known values; both short phrases (no whole stripe)
+	and a longer pattern (whole stripes plus a tail).
+Streaming must give the one-shot result regardless of how input is split.
+
+returns 0 on success
+*/
+int fast()
+{
+	int err_cnt = 0;
+	uint8_t *data = NULL;
+
+	for (uint_fast16_t i = 0; i < NLC_ARRAY_LEN(phrases); i++) {
+		uint64_t res = fnv_fast64(phrases[i], strlen(phrases[i]));
+		NB_err_if(res != out_fast64[i], "i=%"PRIuFAST16"; 0x%"PRIx64" != 0x%"PRIx64,
+			i, res, out_fast64[i]);
+	}
+
+	/* empty input may be NULL (e.g. an empty file, mapped) */
+	uint64_t empty = fnv_fast64(NULL, 0);
+	NB_err_if(empty != out_fast64[0], "NULL: 0x%"PRIx64" != 0x%"PRIx64, empty, out_fast64[0]);
+
+	/* 15 stripes and a 40B tail; value from an independent implementation */
+	const size_t pattern = 1000;
+	NB_die_if(!(data = malloc(pattern)), "malloc %zu", pattern);
+	for (size_t i=0; i < pattern; i++)
+		data[i] = i * 7 + (i >> 11);
+	uint64_t res = fnv_fast64(data, pattern);
+	NB_err_if(res != 0x5d448e888453656d, "0x%"PRIx64, res);
+
+	/* feed in pieces of 0, 1, 2 ... bytes: crosses stripes at every offset */
+	const size_t sz = 100000;
+	NB_die_if(!(data = realloc(data, sz)), "realloc %zu", sz);
+	pcg_randset(data, sz, PCG_RAND_S1, PCG_RAND_S2);
+	struct fnv_fast64_state state;
+	fnv_fast64_init(&state);
+	for (size_t done=0, take=0; done < sz; done += take, take++) {
+		if (take > sz - done)
+			take = sz - done;
+		fnv_fast64_update(&state, &data[done], take);
+	}
+	uint64_t streamed = fnv_fast64_final(&state);
+	uint64_t oneshot = fnv_fast64(data, sz);
+	NB_err_if(streamed != oneshot, "0x%"PRIx64" != 0x%"PRIx64, streamed, oneshot);
+
+die:
+	free(data);
+	return err_cnt;
+}
+
+
+
+/*	compile_time()
+Compile-time hashes must match runtime ones.
+FNV*_CHARS() must be a constant expression (_Static_assert, case labels);
+	FNV*_STR() must at least fold to a constant when optimizing.
+
+returns 0 on success
+*/
+_Static_assert(FNV32_CHARS('b', 'l', 'a', 'a', 'r') == 0x6f93f02d, "FNV32_CHARS");
+_Static_assert(FNV64_CHARS('b', 'l', 'a', 'a', 'r') == 0x4b64e9abbc760b0d, "FNV64_CHARS");
+
+static const char *commands[] = { "get", "put", "delete", "nope" };
+
+int compile_time()
+{
+	int err_cnt = 0;
+
+	/* every test phrase (except the empty one, which is just the basis) */
+	NB_err_if(FNV32_STR("") != FNV32_BASIS || FNV64_STR("") != FNV64_BASIS, "");
+	NB_err_if(FNV32_STR("the quick brown fox jumped over the lazy dog") != out32[1], "");
+	NB_err_if(FNV64_STR("the quick brown fox jumped over the lazy dog") != out64[1], "");
+	NB_err_if(FNV32_STR("/the/enemy/gate/is/down") != out32[2], "");
+	NB_err_if(FNV64_STR("/the/enemy/gate/is/down") != out64[2], "");
+	NB_err_if(FNV32_STR("\t{}[]*\\&^%$#@!") != out32[3], "");
+	NB_err_if(FNV64_STR("\t{}[]*\\&^%$#@!") != out64[3], "");
+	NB_err_if(FNV64_STR("eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee") != out64[4], "");
+	NB_err_if(FNV64_STR("The player formerly known as mousecop") != out64[5], "");
+	NB_err_if(FNV32_STR("Dan Smith") != out32[6], "");
+	NB_err_if(FNV64_STR("Dan Smith") != out64[6], "");
+
+	/* the longest literal allowed, including a high-bit byte */
+	const char *longest = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\xe9";
+	NB_err_if(FNV64_STR("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde\xe9")
+			!= fnv_hash64(NULL, longest, FNV_STR_MAX), "");
+	NB_err_if(FNV32_CHARS('\xe9') != fnv_hash32(NULL, "\xe9", 1), "");
+
+#ifdef __OPTIMIZE__
+	NB_err_if(!__builtin_constant_p(FNV64_STR("the quick brown fox jumped over the lazy dog")),
+		"FNV64_STR() not folded");
+	NB_err_if(!__builtin_constant_p(FNV32_STR("/the/enemy/gate/is/down")),
+		"FNV32_STR() not folded");
+#endif
+
+	/* dispatch on hashed keys */
+	for (size_t i=0; i < NLC_ARRAY_LEN(commands); i++) {
+		int which;
+		switch (fnv_hash32(NULL, commands[i], strlen(commands[i]))) {
+		case FNV32_CHARS('g', 'e', 't'):
+			which = 0;
+			break;
+		case FNV32_CHARS('p', 'u', 't'):
+			which = 1;
+			break;
+		case FNV32_CHARS('d', 'e', 'l', 'e', 't', 'e'):
+			which = 2;
+			break;
+		default:
+			which = 3;
+		}
+		NB_err_if(which != i, "'%s' dispatched to %d", commands[i], which);
 	}
 
 	return err_cnt;
@@ -137,11 +452,27 @@ int	speed()
 
 	/* run FNV32 */
 	nlc_timing_start(fnv32);
-	uint32_t res32 = fnv_hash64(NULL, large, sz);
+	uint32_t res32 = fnv_hash32(NULL, large, sz);
 	nlc_timing_stop(fnv32);
 	NB_prn("fnv_hash32 on %zuB: %fs - %"PRIx32,
 			sz, nlc_timing_cpu(fnv32), res32);
 
+	/* run fast FNV64 */
+	nlc_timing_start(fast64);
+	uint64_t res_fast = fnv_fast64(large, sz);
+	nlc_timing_stop(fast64);
+	NB_prn("fnv_fast64 on %zuB: %fs - %"PRIx64,
+			sz, nlc_timing_cpu(fast64), res_fast);
+
+#ifdef __SIZEOF_INT128__
+	/* run FNV128 */
+	nlc_timing_start(fnv128);
+	fnv128_t res128 = fnv_hash128(NULL, large, sz);
+	nlc_timing_stop(fnv128);
+	NB_prn("fnv_hash128 on %zuB: %fs - %016"PRIx64"%016"PRIx64,
+			sz, nlc_timing_cpu(fnv128), (uint64_t)(res128 >> 64), (uint64_t)res128);
+#endif
+
 die:
 	free(large);
 	return err_cnt;
@@ -157,6 +488,10 @@ int main()
 
 	err_cnt += equivalence();
 	err_cnt += correctness();
+	err_cnt += batch();
+	err_cnt += tree();
+	err_cnt += fast();
+	err_cnt += compile_time();
 	err_cnt += speed();
 
 	return err_cnt;
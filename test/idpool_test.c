@@ -0,0 +1,215 @@
+/*	idpool_test.c
+
+ID allocator: allocation order, double release, exhaustion;
+	random alloc/release checked against a plain array,
+	including iteration; and speed and memory at 100M IDs.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#include <idpool.h>
+#include <pcg_rand.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <stdlib.h> /* getenv() */
+
+
+/*	test_basic()
+*/
+int test_basic()
+{
+	int err_cnt = 0;
+	struct idpool *ip = NULL;
+	uint32_t id;
+	const size_t max = 1000;
+
+	NB_die_if(!(ip = idpool_new(max)), "");
+
+	/* fresh pool: lowest first */
+	for (uint32_t i=0; i < max; i++) {
+		NB_die_if(idpool_alloc(ip, &id) || id != i, "alloc %"PRIu32": %"PRIu32, i, id);
+	}
+	NB_die_if(!idpool_alloc(ip, &id), "alloc from exhausted pool");
+	NB_die_if(ip->count != max, "");
+
+	/* most recently released first */
+	NB_die_if(idpool_release(ip, 10) || idpool_release(ip, 700) || idpool_release(ip, 5), "");
+	NB_die_if(idpool_is_alloc(ip, 700) || !idpool_is_alloc(ip, 701), "");
+	NB_die_if(idpool_alloc(ip, &id) || id != 5, "alloc %"PRIu32" != 5", id);
+
+	/* double release; out of range; never allocated */
+	NB_die_if(!idpool_release(ip, 700), "double release not detected");
+	NB_die_if(!idpool_release(ip, max), "release out of range");
+	NB_die_if(!idpool_release(ip, UINT32_MAX), "release out of range");
+
+	/* lowest: 10, though 700 was released last */
+	NB_die_if(idpool_alloc_low(ip, &id) || id != 10, "alloc_low %"PRIu32" != 10", id);
+	NB_die_if(idpool_alloc(ip, &id) || id != 700, "alloc %"PRIu32" != 700", id);
+	NB_die_if(!idpool_alloc(ip, &id), "");
+
+	/* iteration skips released IDs */
+	for (uint32_t i=0; i < max; i += 2) {
+		NB_die_if(idpool_release(ip, i), "");
+	}
+	size_t cnt = 0;
+	IDPOOL_FOREACH(ip, i) {
+		NB_die_if(i != cnt * 2 + 1, "iterated %zu, expected %zu", i, cnt * 2 + 1);
+		cnt++;
+	}
+	NB_die_if(cnt != max / 2 || ip->count != cnt, "iterated %zu", cnt);
+
+die:
+	idpool_free(ip);
+	return err_cnt;
+}
+
+
+/*	test_random()
+Random alloc/release (both kinds), checked against a byte per ID.
+*/
+int test_random(size_t max, size_t numiter)
+{
+	int err_cnt = 0;
+	struct idpool *ip = NULL;
+	uint8_t *ref = NULL;
+	struct pcg_state rnd;
+	pcg_seed_static(&rnd);
+	size_t count = 0;
+
+	NB_die_if(!(ip = idpool_new(max)), "");
+	NB_die_if(!(ref = calloc(max, 1)), "");
+
+	for (size_t i=0; i < numiter; i++) {
+		uint32_t id = pcg_rand_bound(&rnd, max);
+		/* drift between mostly-full and mostly-empty */
+		bool fill = (i / (max / 2 + 1)) & 0x1;
+		if (fill || pcg_rand(&rnd) & 0x1) {
+			int ret = (pcg_rand(&rnd) & 0x7) ? idpool_alloc(ip, &id) : idpool_alloc_low(ip, &id);
+			if (count == max) {
+				NB_die_if(!ret, "alloc from full pool");
+				continue;
+			}
+			NB_die_if(ret, "alloc with %zu of %zu", count, max);
+			NB_die_if(id >= max || ref[id], "alloc %"PRIu32" twice", id);
+			ref[id] = 1;
+			count++;
+		} else if (ref[id]) {
+			NB_die_if(idpool_release(ip, id), "release %"PRIu32, id);
+			ref[id] = 0;
+			count--;
+		/* now and then, a double release (which logs) */
+		} else if (!(i & 0xffff)) {
+			NB_die_if(!idpool_release(ip, id), "released free %"PRIu32, id);
+		}
+		NB_die_if(ip->count != count, "count %zu != %zu", ip->count, count);
+	}
+
+	/* every allocated ID, in order, once */
+	size_t next = 0;
+	IDPOOL_FOREACH(ip, id) {
+		while (next < id) {
+			NB_die_if(ref[next++], "%zu not iterated", next - 1);
+		}
+		NB_die_if(!ref[id], "%zu iterated but free", id);
+		next++;
+	}
+	while (next < max) {
+		NB_die_if(ref[next++], "%zu not iterated", next - 1);
+	}
+
+die:
+	free(ref);
+	idpool_free(ip);
+	return err_cnt;
+}
+
+
+/*	bench()
+Fill 'max' IDs; release and reallocate in random order; iterate.
+*/
+int bench(size_t max)
+{
+	int err_cnt = 0;
+	struct idpool *ip = NULL;
+	uint32_t *order = NULL;
+	uint32_t id;
+	NB_die_if(!(ip = idpool_new(max)), "");
+	NB_die_if(!(order = malloc(max * sizeof(*order))), "");
+
+	nlc_timing_start(fill);
+	for (size_t i=0; i < max; i++) {
+		NB_die_if(idpool_alloc(ip, &id), "");
+	}
+	nlc_timing_stop(fill);
+
+	/* shuffle */
+	struct pcg_state rnd;
+	pcg_seed_static(&rnd);
+	for (size_t i=0; i < max; i++)
+		order[i] = i;
+	for (size_t i=max - 1; i > 0; i--) {
+		uint32_t j = pcg_rand_bound(&rnd, i + 1);
+		uint32_t t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+
+	/* churn: release 1/16 at random, allocate them back through the free-list */
+	size_t churn = max / 16;
+	nlc_timing_start(cycle);
+	for (size_t i=0; i < churn; i++) {
+		NB_die_if(idpool_release(ip, order[i]), "");
+	}
+	for (size_t i=0; i < churn; i++) {
+		NB_die_if(idpool_alloc(ip, &id), "");
+	}
+	nlc_timing_stop(cycle);
+
+	/* iterate a sparse pool: 1/16 allocated */
+	for (size_t i=churn; i < max; i++) {
+		NB_die_if(idpool_release(ip, order[i]), "");
+	}
+	size_t cnt = 0, sum = 0;
+	nlc_timing_start(iter);
+	IDPOOL_FOREACH(ip, i) {
+		cnt++;
+		sum += i;
+	}
+	nlc_timing_stop(iter);
+	NB_die_if(cnt != churn, "iterated %zu of %zu", cnt, churn);
+
+	size_t words1 = (ip->words + 63) >> 6;
+	size_t bytes = ip->words * 8 + words1 * 16 + ((words1 + 63) >> 6) * 8
+		+ ip->list->mem_len;
+	NB_prn("%zu IDs, %.1f MiB (%.2f bits/ID): fill %.1f ns/ID, release+alloc %.1f ns/ID, iterate %.1f ns/ID (%zu of them)",
+		max, bytes / 1048576.0, bytes * 8.0 / max,
+		nlc_timing_wall(fill) * 1e9 / max,
+		nlc_timing_wall(cycle) * 1e9 / churn,
+		nlc_timing_wall(iter) * 1e9 / cnt, cnt);
+
+die:
+	free(order);
+	idpool_free(ip);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	/* do MUCH less work if VALGRIND environment variable is set */
+	size_t max = 100000000;
+	if (getenv("VALGRIND"))
+		max = 100000;
+
+	err_cnt += test_basic();
+	err_cnt += test_random(1000, 100000);
+	err_cnt += test_random(64 * 64 * 64 + 7, 1000000);
+	err_cnt += bench(max);
+
+	return err_cnt;
+}
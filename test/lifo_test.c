@@ -3,6 +3,10 @@
 #include <lifo.h>
 #include <time.h> /* clock() */
 #include <stdlib.h> /* getenv() */
+#include <stdbool.h>
+
+LIFO_DECLARE(id32, uint32_t)
+LIFO_DECLARE(id8, uint8_t)
 
 /*	test_many()
 */
@@ -38,6 +42,251 @@ die:
 }
 
 
+/*	test_stable()
+A reserved stack never moves as it grows.
+*/
+int	test_stable()
+{
+	int err_cnt = 0;
+#ifdef LIFO_HAVE_RESERVE
+	struct lifo *stk = NULL;
+	LIFO_MEM_TYPE numiter = LIFO_RESERVE_GROW / sizeof(LIFO_MEM_TYPE) * 4;
+	NB_die_if(!(stk = lifo_new_reserved(numiter * sizeof(LIFO_MEM_TYPE))), "");
+	const struct lifo *orig = stk;
+
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++) {
+		lifo_push(&stk, i);
+		NB_die_if(stk != orig, "stack moved at push %zu", i);
+	}
+	NB_die_if(stk->mem_len < numiter * sizeof(LIFO_MEM_TYPE), "");
+	NB_die_if(stk->mem[numiter / 2] != numiter / 2, "");
+
+die:
+	lifo_free(stk);
+#endif
+	return err_cnt;
+}
+
+
+/*	test_full()
+A reserved stack refuses to grow past its reservation, and is left as it was.
+*/
+int	test_full()
+{
+	int err_cnt = 0;
+#ifdef LIFO_HAVE_RESERVE
+	struct lifo *stk = NULL;
+	struct id32 *s32 = NULL;
+	NB_die_if(!(stk = lifo_new_reserved(1)), "");
+	NB_die_if(!(s32 = id32_new_reserved(1)), "");
+	const struct lifo *orig = stk;
+	LIFO_MEM_TYPE numiter = stk->mem_max / sizeof(LIFO_MEM_TYPE);
+
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++) {
+		NB_die_if(lifo_push(&stk, i) != i, "push %zu", i);
+	}
+	NB_die_if(lifo_push(&stk, 0) != LIFO_ERR, "pushed past the reservation");
+	NB_die_if(lifo_push_n(&stk, &numiter, 1) != LIFO_ERR, "");
+	NB_die_if(!lifo_reserve(&stk, 1), "");
+	NB_die_if(stk != orig || stk->next != numiter, "");
+	NB_die_if(stk->mem[numiter - 1] != numiter - 1, "");
+
+	for (uint32_t i=0; i < s32->mem_max / sizeof(uint32_t); i++) {
+		NB_die_if(id32_push(&s32, i) != i, "push %"PRIu32, i);
+	}
+	NB_die_if(id32_push(&s32, 0) != LIFO_ERR, "pushed past the reservation");
+
+die:
+	id32_free(s32);
+	lifo_free(stk);
+#endif
+	return err_cnt;
+}
+
+
+/*	test_trim()
+Memory comes back only well below the high-water mark; RSS shows it.
+'reserved': of a stack from lifo_new_reserved().
+*/
+int	test_trim(bool reserved)
+{
+	int err_cnt = 0;
+	struct lifo *stk = NULL;
+	size_t step = reserved ? LIFO_RESERVE_GROW : LIFO_GROW;
+	LIFO_MEM_TYPE numiter = step / sizeof(LIFO_MEM_TYPE) * 16;
+	if (reserved) {
+		NB_die_if(!(stk = lifo_new_reserved(numiter * sizeof(LIFO_MEM_TYPE))), "");
+	} else {
+		NB_die_if(!(stk = lifo_new()), "");
+	}
+	LIFO_MEM_TYPE pop;
+
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++)
+		lifo_push(&stk, i);
+	size_t high = lifo_rss(stk);
+	NB_die_if(high < numiter * sizeof(LIFO_MEM_TYPE), "rss %zu at high-water", high);
+
+	/* hysteresis: not at half the high-water mark */
+	while (stk->next > numiter / 2)
+		lifo_pop(stk, &pop);
+	NB_die_if(lifo_trim(&stk), "trimmed at 1/2");
+
+	/* trimmed at 1/8, keeping twice the use */
+	while (stk->next > numiter / 8)
+		lifo_pop(stk, &pop);
+	size_t freed = lifo_trim(&stk);
+	size_t rss = lifo_rss(stk);
+	NB_inf("rss %zu at high-water; %zu after trim (%zu given back)", high, rss, freed);
+	NB_die_if(!freed, "not trimmed at 1/8");
+	NB_die_if(rss >= high || rss > stk->mem_len + sizeof(*stk), "rss %zu after trim", rss);
+	NB_die_if(stk->mem_len < stk->next * sizeof(LIFO_MEM_TYPE) * 2, "trimmed too much");
+	NB_die_if(lifo_trim(&stk), "trimmed twice");
+
+	/* contents intact; regrow */
+	NB_die_if(stk->mem[stk->next - 1] != stk->next - 1, "");
+	for (LIFO_MEM_TYPE i=stk->next; i < numiter; i++)
+		lifo_push(&stk, i);
+	for (LIFO_MEM_TYPE i=numiter; i > 0; i--) {
+		NB_die_if(lifo_pop(stk, &pop) != i - 1 || pop != i - 1, "pop %zu", i - 1);
+	}
+
+die:
+	lifo_free(stk);
+	return err_cnt;
+}
+
+
+/*	test_bulk()
+lifo_push_n()/lifo_pop_n() against the same work done one ID at a time:
+	same contents, same order; then time both (warm memory, batches of 'batch').
+*/
+int	test_bulk(size_t numiter, size_t batch)
+{
+	int err_cnt = 0;
+	struct lifo *one = NULL, *bulk = NULL;
+	LIFO_MEM_TYPE *ids = NULL, *buf = NULL;
+	NB_die_if(!(one = lifo_new()) || !(bulk = lifo_new()), "");
+	NB_die_if(!(ids = malloc(numiter * sizeof(LIFO_MEM_TYPE))), "");
+	NB_die_if(!(buf = malloc(numiter * sizeof(LIFO_MEM_TYPE))), "");
+	for (size_t i=0; i < numiter; i++)
+		ids[i] = i;
+
+	/* pre-sized: no growing from here on */
+	NB_die_if(lifo_reserve(&one, numiter) || lifo_reserve(&bulk, numiter), "");
+	NB_die_if(bulk->mem_len < numiter * sizeof(LIFO_MEM_TYPE), "reserve too short");
+	size_t len = bulk->mem_len;
+
+	LIFO_MEM_TYPE pop;
+	double single_push = 0, single_pop = 0, bulk_push = 0, bulk_pop = 0;
+	const int rounds = 16;
+	for (int r=0; r < rounds; r++) {
+		nlc_timing_start(t_single_push);
+		for (size_t i=0; i < numiter; i++)
+			lifo_push(&one, ids[i]);
+		nlc_timing_stop(t_single_push);
+
+		nlc_timing_start(t_bulk_push);
+		for (size_t i=0; i < numiter; i += batch) {
+			NB_die_if(lifo_push_n(&bulk, &ids[i], batch) != i, "push_n at %zu", i);
+		}
+		nlc_timing_stop(t_bulk_push);
+		NB_die_if(memcmp(one->mem, bulk->mem, numiter * sizeof(LIFO_MEM_TYPE)),
+			"contents differ");
+
+		nlc_timing_start(t_single_pop);
+		for (size_t i=0; i < numiter; i++)
+			lifo_pop(one, &buf[i]);
+		nlc_timing_stop(t_single_pop);
+		NB_die_if(lifo_pop(one, &pop) != LIFO_ERR, "");
+
+		nlc_timing_start(t_bulk_pop);
+		for (size_t i=numiter; i > 0; i -= batch) {
+			NB_die_if(lifo_pop_n(bulk, &buf[i - batch], batch) != batch, "pop_n at %zu", i);
+		}
+		nlc_timing_stop(t_bulk_pop);
+		NB_die_if(memcmp(ids, buf, numiter * sizeof(LIFO_MEM_TYPE)), "pop_n order");
+
+		/* first round faults memory in: don't count it */
+		if (!r)
+			continue;
+		single_push += nlc_timing_wall(t_single_push);
+		bulk_push += nlc_timing_wall(t_bulk_push);
+		single_pop += nlc_timing_wall(t_single_pop);
+		bulk_pop += nlc_timing_wall(t_bulk_pop);
+	}
+	NB_die_if(bulk->mem_len != len, "grew after lifo_reserve()");
+	NB_die_if(lifo_pop_n(bulk, buf, batch), "pop_n from empty stack");
+
+	/* short pop; growing through lifo_push_n() */
+	NB_die_if(lifo_push_n(&bulk, ids, 3) != 0, "");
+	NB_die_if(lifo_pop_n(bulk, buf, batch) != 3 || buf[2] != 2, "short pop_n");
+	for (size_t i=0; i < LIFO_GROW / sizeof(LIFO_MEM_TYPE) * 2; i += batch) {
+		NB_die_if(lifo_push_n(&bulk, ids, batch) == LIFO_ERR, "grow at %zu", i);
+	}
+	NB_die_if(bulk->mem_len <= len, "did not grow");
+
+	double per = 1e9 / ((double)numiter * (rounds - 1));
+	NB_prn("%zu IDs in batches of %zu, ns/ID: push %.2f, push_n %.2f; pop %.2f, pop_n %.2f",
+		numiter, batch, single_push * per, bulk_push * per,
+		single_pop * per, bulk_pop * per);
+
+die:
+	free(buf);
+	free(ids);
+	lifo_free(bulk);
+	lifo_free(one);
+	return err_cnt;
+}
+
+
+/*	test_declare()
+Stacks of narrower types side by side with a 'struct lifo':
+	same behavior, in a fraction of the memory.
+*/
+int	test_declare(size_t numiter)
+{
+	int err_cnt = 0;
+	struct lifo *stk = NULL;
+	struct id32 *s32 = NULL;
+	struct id8 *s8 = NULL;
+	NB_die_if(!(stk = lifo_new()) || !(s32 = id32_new()) || !(s8 = id8_new()), "");
+
+	for (size_t i=0; i < numiter; i++) {
+		NB_die_if(lifo_push(&stk, i) != i, "");
+		NB_die_if(id32_push(&s32, i) != i, "id32 push %zu", i);
+		NB_die_if(id8_push(&s8, i) != i, "id8 push %zu", i);
+	}
+	NB_inf("%zu IDs: rss lifo %zu, id32 %zu, id8 %zu", numiter,
+		lifo_rss(stk), id32_rss(s32), id8_rss(s8));
+	NB_die_if(s32->mem_len >= stk->mem_len / 2 + LIFO_GROW, "id32 not narrower");
+	NB_die_if(s8->mem_len >= stk->mem_len / 8 + LIFO_GROW, "id8 not narrower");
+
+	uint32_t buf[256];
+	NB_die_if(id32_pop_n(s32, buf, 256) != 256, "");
+	NB_die_if(buf[255] != numiter - 1 || buf[0] != numiter - 256, "id32 pop_n order");
+	NB_die_if(id32_push_n(&s32, buf, 256) != numiter - 256, "");
+
+	LIFO_MEM_TYPE pop;
+	uint32_t pop32;
+	uint8_t pop8;
+	for (size_t i=numiter; i > 0; i--) {
+		NB_die_if(lifo_pop(stk, &pop) != i - 1 || pop != i - 1, "");
+		NB_die_if(id32_pop(s32, &pop32) != i - 1 || pop32 != (uint32_t)(i - 1),
+			"id32 pop %zu", i - 1);
+		NB_die_if(id8_pop(s8, &pop8) != i - 1 || pop8 != (uint8_t)(i - 1),
+			"id8 pop %zu", i - 1);
+	}
+	NB_die_if(id32_pop(s32, &pop32) != LIFO_ERR || id8_pop(s8, &pop8) != LIFO_ERR, "");
+	NB_die_if(!id32_trim(&s32) || !id8_trim(&s8), "not trimmed");
+
+die:
+	id8_free(s8);
+	id32_free(s32);
+	lifo_free(stk);
+	return err_cnt;
+}
+
+
 /*	main()
 */
 int main()
@@ -62,5 +311,12 @@ int main()
 			numiter, nlc_timing_cpu(elapsed));
 	}
 
+	err_cnt += test_stable();
+	err_cnt += test_full();
+	err_cnt += test_trim(false);
+	err_cnt += test_trim(true);
+	err_cnt += test_declare(LIFO_GROW / sizeof(LIFO_MEM_TYPE) * 8);
+	err_cnt += test_bulk(getenv("VALGRIND") ? 1 << 12 : 1 << 20, 256);
+
 	return err_cnt;
 }
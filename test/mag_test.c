@@ -0,0 +1,251 @@
+/*	mag_test.c
+
+Magazine caches: IDs pushed come back out, once, whichever thread pops them;
+	the depot holds no more empty magazines than allowed;
+	and throughput against clifo alone, by number of threads.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#include <mag.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <pthread.h>
+#include <stdlib.h> /* getenv() */
+
+
+#define THREADS_MAX 8
+
+
+/*	test_single()
+One thread: every ID pushed is popped exactly once; after a flush the
+	depot keeps at most 'empty_max' empty magazines.
+*/
+int test_single(size_t numiter)
+{
+	int err_cnt = 0;
+	struct mag_depot *dp = NULL;
+	uint8_t *seen = NULL;
+	struct mag_cache mc;
+	const size_t empty_max = 2;
+
+	NB_die_if(!(dp = mag_depot_new(empty_max)), "");
+	NB_die_if(!(seen = calloc(numiter, 1)), "");
+	mag_cache_init(&mc, dp);
+
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++) {
+		NB_die_if(mag_push(&mc, i), "push %zu", i);
+	}
+	NB_die_if(dp->full->alloc < numiter / MAG_SIZE - 2, "depot holds too few magazines");
+
+	LIFO_MEM_TYPE pop;
+	for (size_t i=0; i < numiter; i++) {
+		NB_die_if(mag_pop(&mc, &pop), "pop %zu", i);
+		NB_die_if(pop >= numiter || seen[pop]++, "pop %zu: %zu", i, pop);
+	}
+	NB_die_if(!mag_pop(&mc, &pop), "pop from empty pool");
+
+	NB_die_if(mag_cache_flush(&mc), "");
+	NB_die_if(mc.loaded || mc.prev, "flush left magazines");
+	NB_die_if(dp->empty_cnt > empty_max, "%zu empty magazines kept, max %zu",
+		dp->empty_cnt, empty_max);
+
+die:
+	free(seen);
+	mag_depot_free(dp);
+	return err_cnt;
+}
+
+
+/*	worker
+Pops IDs off the shared pool and pushes them back, some time later;
+	an ID popped while marked as out is a duplicate.
+*/
+struct worker {
+	pthread_t		tid;
+	struct mag_depot	*dp;
+	size_t			numiter;
+	uint8_t			*out;		/* per ID: popped and not pushed yet */
+	int			err_cnt;
+};
+
+void *worker(void *arg)
+{
+	struct worker *w = arg;
+	struct mag_cache mc;
+	mag_cache_init(&mc, w->dp);
+	LIFO_MEM_TYPE held[MAG_SIZE * 3];
+	size_t cnt = 0;
+
+	for (size_t i=0; i < w->numiter; i++) {
+		/* hold up to 3 magazines' worth, to make the depot work */
+		if (cnt < NLC_ARRAY_LEN(held) && (i % 7 != 6 || !cnt)) {
+			if (mag_pop(&mc, &held[cnt]))
+				continue;
+			if (__atomic_exchange_n(&w->out[held[cnt]], 1, __ATOMIC_RELAXED))
+				w->err_cnt++;
+			cnt++;
+		} else {
+			cnt--;
+			__atomic_store_n(&w->out[held[cnt]], 0, __ATOMIC_RELAXED);
+			w->err_cnt += mag_push(&mc, held[cnt]);
+		}
+	}
+	while (cnt--) {
+		__atomic_store_n(&w->out[held[cnt]], 0, __ATOMIC_RELAXED);
+		w->err_cnt += mag_push(&mc, held[cnt]);
+	}
+	w->err_cnt += mag_cache_flush(&mc);
+	return NULL;
+}
+
+
+/*	test_threads()
+*/
+int test_threads(size_t threads, size_t ids, size_t numiter)
+{
+	int err_cnt = 0;
+	struct mag_depot *dp = NULL;
+	uint8_t *out = NULL;
+	struct worker w[THREADS_MAX] = { { 0 } };
+	struct mag_cache mc;
+
+	NB_die_if(!(dp = mag_depot_new(threads * 2)), "");
+	NB_die_if(!(out = calloc(ids, 1)), "");
+
+	mag_cache_init(&mc, dp);
+	for (LIFO_MEM_TYPE i=0; i < ids; i++) {
+		NB_die_if(mag_push(&mc, i), "");
+	}
+	NB_die_if(mag_cache_flush(&mc), "");
+
+	for (size_t i=0; i < threads; i++) {
+		w[i] = (struct worker){ .dp = dp, .numiter = numiter, .out = out };
+		NB_die_if(pthread_create(&w[i].tid, NULL, worker, &w[i]), "");
+	}
+	for (size_t i=0; i < threads; i++) {
+		pthread_join(w[i].tid, NULL);
+		NB_err_if(w[i].err_cnt, "thread %zu: %d errors", i, w[i].err_cnt);
+		err_cnt += w[i].err_cnt;
+	}
+
+	/* all IDs back in the depot, once */
+	mag_cache_init(&mc, dp);
+	LIFO_MEM_TYPE pop;
+	size_t cnt = 0;
+	for (; !mag_pop(&mc, &pop); cnt++) {
+		NB_die_if(pop >= ids || out[pop]++, "%zu threads: ID %zu twice", threads, pop);
+	}
+	NB_die_if(cnt != ids, "%zu threads: %zu of %zu IDs back", threads, cnt, ids);
+	NB_die_if(mag_cache_flush(&mc), "");
+
+die:
+	free(out);
+	mag_depot_free(dp);
+	return err_cnt;
+}
+
+
+/*	bench
+Pop/push pairs from every thread: magazines against bare clifo.
+*/
+struct bench {
+	pthread_t		tid;
+	struct mag_depot	*dp;
+	struct clifo		*cl;
+	size_t			numiter;
+};
+
+void *bench_mag(void *arg)
+{
+	struct bench *b = arg;
+	struct mag_cache mc;
+	mag_cache_init(&mc, b->dp);
+	LIFO_MEM_TYPE id;
+	for (size_t i=0; i < b->numiter; i++) {
+		if (!mag_pop(&mc, &id))
+			mag_push(&mc, id);
+	}
+	mag_cache_flush(&mc);
+	return NULL;
+}
+
+void *bench_clifo(void *arg)
+{
+	struct bench *b = arg;
+	LIFO_MEM_TYPE id;
+	for (size_t i=0; i < b->numiter; i++) {
+		if (!clifo_pop(b->cl, &id))
+			clifo_push(b->cl, id);
+	}
+	return NULL;
+}
+
+int bench(size_t ids, size_t numiter)
+{
+	int err_cnt = 0;
+	struct mag_depot *dp = NULL;
+	struct clifo *cl = NULL;
+	struct bench b[THREADS_MAX];
+	struct mag_cache mc;
+
+	NB_die_if(!(dp = mag_depot_new(THREADS_MAX * 2)), "");
+	NB_die_if(!(cl = clifo_new()), "");
+	mag_cache_init(&mc, dp);
+	for (LIFO_MEM_TYPE i=0; i < ids; i++) {
+		NB_die_if(mag_push(&mc, i) || clifo_push(cl, i), "");
+	}
+	NB_die_if(mag_cache_flush(&mc), "");
+
+	for (size_t threads=1; threads <= THREADS_MAX; threads *= 2) {
+		size_t per = numiter / threads;
+		for (size_t i=0; i < threads; i++)
+			b[i] = (struct bench){ .dp = dp, .cl = cl, .numiter = per };
+
+		nlc_timing_start(magazine);
+		for (size_t i=0; i < threads; i++) {
+			NB_die_if(pthread_create(&b[i].tid, NULL, bench_mag, &b[i]), "");
+		}
+		for (size_t i=0; i < threads; i++)
+			pthread_join(b[i].tid, NULL);
+		nlc_timing_stop(magazine);
+
+		nlc_timing_start(lockfree);
+		for (size_t i=0; i < threads; i++) {
+			NB_die_if(pthread_create(&b[i].tid, NULL, bench_clifo, &b[i]), "");
+		}
+		for (size_t i=0; i < threads; i++)
+			pthread_join(b[i].tid, NULL);
+		nlc_timing_stop(lockfree);
+
+		double mops = (double)per * threads * 2 / 1e6;
+		NB_prn("%zu threads: Mops/s magazines %.1f, clifo %.1f", threads,
+			mops / nlc_timing_wall(magazine), mops / nlc_timing_wall(lockfree));
+	}
+
+die:
+	clifo_free(cl);
+	mag_depot_free(dp);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	/* do MUCH less work if VALGRIND environment variable is set */
+	size_t numiter = 1 << 20;
+	if (getenv("VALGRIND"))
+		numiter = 1 << 12;
+
+	err_cnt += test_single(numiter);
+	for (size_t threads=1; threads <= THREADS_MAX; threads *= 2)
+		err_cnt += test_threads(threads, MAG_SIZE * 16, numiter / threads);
+	err_cnt += bench(MAG_SIZE * 16, numiter * 4);
+
+	return err_cnt;
+}
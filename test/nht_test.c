@@ -0,0 +1,355 @@
+/*	nht_test.c
+Correctness of the nht hash table (inline and long keys, deletes, resizing,
+	a degenerate hash function); and a benchmark against a plain chained table
+	(one malloc() per node) such as is commonly hand-rolled.
+
+Benchmark sizes: 1M entries by default;
+	set NHT_BENCH_MAX (e.g. 100000000) to also run 10M, 100M ... up to that.
+*/
+
+#include <nht.h>
+#include <fnv.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+#include <pcg_rand.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+/*	key()
+Write the 'i'th test key to 'buf' (at least 48B); return its length.
+Keys 0..7 are 0..7B long; the others cycle through 8..47B and embed 'i':
+	all are distinct, both inline and long (referenced) keys.
+*/
+static size_t key(size_t i, uint8_t *buf)
+{
+	size_t len = i < 8 ? i : 8 + i % 40;
+	uint64_t x = i * 0x9e3779b97f4a7c15;
+	for (size_t j=0; j < len; j++)
+		buf[j] = x >> ((j % 8) * 8) ^ j;
+	if (len >= sizeof(i))
+		memcpy(buf, &i, sizeof(i));
+	return len;
+}
+
+
+
+/*	check()
+Insert, overwrite, look up, delete and re-insert 'n' keys
+	in a table grown from empty (i.e.: through many incremental resizes).
+Keys are kept in 'keys' (48B each) because long keys are referenced, not copied.
+
+returns 0 on success
+*/
+static int check(size_t n, nht_hash_t hash)
+{
+	int err_cnt = 0;
+	struct nht *nht = NULL;
+	uint8_t *keys = NULL;
+	size_t *lens = NULL;
+
+	NB_die_if(!(keys = malloc(n * 48)), "");
+	NB_die_if(!(lens = malloc(n * sizeof(*lens))), "");
+	NB_die_if(!(nht = nht_new(0, hash)), "");
+
+	for (size_t i=0; i < n; i++) {
+		lens[i] = key(i, &keys[i * 48]);
+		NB_die_if(nht_set(nht, &keys[i * 48], lens[i], i), "set %zu", i);
+	}
+	NB_err_if(nht_count(nht) != n, "count %zu != %zu", nht_count(nht), n);
+
+	/* overwrite every third value; with a fresh copy of the key */
+	uint8_t copy[48];
+	for (size_t i=0; i < n; i += 3) {
+		size_t len = key(i, copy);
+		if (len > NHT_INLINE)
+			continue; /* long keys are referenced: the copy would not outlive it */
+		NB_die_if(nht_set(nht, copy, len, i + n), "overwrite %zu", i);
+	}
+	NB_err_if(nht_count(nht) != n, "count %zu != %zu after overwrite", nht_count(nht), n);
+
+	for (size_t i=0; i < n; i++) {
+		nht_val_t val;
+		NB_die_if(nht_get(nht, &keys[i * 48], lens[i], &val), "get %zu", i);
+		size_t expect = (!(i % 3) && lens[i] <= NHT_INLINE) ? i + n : i;
+		NB_die_if(val.integer != expect, "%zu: %zu != %zu", i, val.integer, expect);
+	}
+
+	/* delete odd keys */
+	for (size_t i=1; i < n; i += 2) {
+		nht_val_t val;
+		NB_die_if(nht_del(nht, &keys[i * 48], lens[i], &val), "del %zu", i);
+	}
+	NB_err_if(nht_count(nht) != n - n / 2, "count %zu after delete", nht_count(nht));
+	for (size_t i=0; i < n; i++) {
+		int ret = nht_get(nht, &keys[i * 48], lens[i], NULL);
+		NB_die_if((i & 1) ? !ret : ret, "%zu after delete: %d", i, ret);
+	}
+	/* nothing to delete twice */
+	NB_err_if(!nht_del(nht, &keys[1 * 48], lens[1], NULL), "deleted twice");
+
+	/* re-insert: tombstones get reused or cleaned up by a same-size resize */
+	for (size_t i=1; i < n; i += 2)
+		NB_die_if(nht_set(nht, &keys[i * 48], lens[i], i), "re-set %zu", i);
+	NB_err_if(nht_count(nht) != n, "count %zu != %zu after re-insert", nht_count(nht), n);
+	for (size_t i=1; i < n; i += 2) {
+		nht_val_t val;
+		NB_die_if(nht_get(nht, &keys[i * 48], lens[i], &val) || val.integer != i,
+			"re-get %zu", i);
+	}
+
+	/* delete everything */
+	for (size_t i=0; i < n; i++)
+		NB_die_if(nht_del(nht, &keys[i * 48], lens[i], NULL), "del all %zu", i);
+	NB_err_if(nht_count(nht) != 0, "count %zu != 0", nht_count(nht));
+
+die:
+	nht_free(nht);
+	free(lens);
+	free(keys);
+	return err_cnt;
+}
+
+
+/*	degenerate()
+A hash putting everything in the same group with the same control byte:
+	every lookup probes all keys. Correct, if slow.
+*/
+static uint64_t degenerate(const void *key, size_t key_len)
+{
+	return 0;
+}
+
+
+
+/*	chained baseline
+A typical hand-rolled chained table: FNV, one malloc() per node,
+	power-of-2 buckets doubled (all at once) at load factor 1.
+*/
+struct chain_node {
+	struct chain_node	*next;
+	uint64_t		hash;
+	size_t			key_len;
+	uint8_t			key[NHT_INLINE];
+	uintptr_t		val;
+};
+struct chain {
+	struct chain_node	**buckets;
+	size_t			mask;
+	size_t			cnt;
+};
+
+static int chain_init(struct chain *ch)
+{
+	ch->mask = 15;
+	ch->cnt = 0;
+	return !(ch->buckets = calloc(ch->mask + 1, sizeof(*ch->buckets)));
+}
+
+static void chain_free(struct chain *ch)
+{
+	for (size_t i=0; ch->buckets && i <= ch->mask; i++) {
+		for (struct chain_node *n = ch->buckets[i], *next; n; n = next) {
+			next = n->next;
+			free(n);
+		}
+	}
+	free(ch->buckets);
+}
+
+static struct chain_node *chain_find(struct chain *ch, uint64_t hash,
+					const void *key, size_t key_len)
+{
+	for (struct chain_node *n = ch->buckets[hash & ch->mask]; n; n = n->next) {
+		if (n->hash == hash && n->key_len == key_len && !memcmp(n->key, key, key_len))
+			return n;
+	}
+	return NULL;
+}
+
+static int chain_set(struct chain *ch, const void *key, size_t key_len, uintptr_t val)
+{
+	uint64_t hash = fnv_hash64(NULL, key, key_len);
+	struct chain_node *n = chain_find(ch, hash, key, key_len);
+	if (n) {
+		n->val = val;
+		return 0;
+	}
+
+	if (ch->cnt > ch->mask) {
+		size_t mask = ch->mask * 2 + 1;
+		struct chain_node **buckets = calloc(mask + 1, sizeof(*buckets));
+		if (!buckets)
+			return 1;
+		for (size_t i=0; i <= ch->mask; i++) {
+			for (struct chain_node *o = ch->buckets[i], *next; o; o = next) {
+				next = o->next;
+				o->next = buckets[o->hash & mask];
+				buckets[o->hash & mask] = o;
+			}
+		}
+		free(ch->buckets);
+		ch->buckets = buckets;
+		ch->mask = mask;
+	}
+
+	if (!(n = malloc(sizeof(*n))))
+		return 1;
+	*n = (struct chain_node){ .hash = hash, .key_len = key_len, .val = val };
+	memcpy(n->key, key, key_len);
+	n->next = ch->buckets[hash & ch->mask];
+	ch->buckets[hash & ch->mask] = n;
+	ch->cnt++;
+	return 0;
+}
+
+static int chain_get(struct chain *ch, const void *key, size_t key_len, uintptr_t *val)
+{
+	struct chain_node *n = chain_find(ch, fnv_hash64(NULL, key, key_len), key, key_len);
+	if (!n)
+		return 1;
+	*val = n->val;
+	return 0;
+}
+
+
+
+/*	bench()
+Insert 'n' random 8B keys (in batches, noting the slowest batch: resize spikes);
+	then look up all of them in random order (hits) and as many absent keys (misses).
+NOTE: looking hits up in insertion order would flatter the chained table,
+	whose nodes are then visited in allocation order.
+Same for the chained baseline.
+
+returns 0 on success
+*/
+#define BENCH_BATCH 1024
+
+static int bench(size_t n)
+{
+	int err_cnt = 0;
+	uint64_t *keys = NULL;
+	uint32_t *order = NULL;
+	struct nht *nht = NULL;
+	struct chain ch = { 0 };
+	uint64_t sum = 0;
+
+	/* 2n keys: the first n are inserted; the rest are (almost surely) misses */
+	NB_die_if(!(keys = malloc(2 * n * sizeof(*keys))), "malloc %zu keys", 2 * n);
+	pcg_randset(keys, 2 * n * sizeof(*keys), PCG_RAND_S1, PCG_RAND_S2);
+
+	/* lookup order: Fisher-Yates shuffle */
+	NB_die_if(!(order = malloc(n * sizeof(*order))), "malloc %zu", n);
+	struct pcg_state rnd;
+	pcg_seed_static(&rnd);
+	for (uint32_t i=0; i < n; i++)
+		order[i] = i;
+	for (uint32_t i=n-1; i > 0; i--) {
+		uint32_t j = pcg_rand_bound(&rnd, i + 1);
+		uint32_t tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	NB_die_if(!(nht = nht_new(0, NULL)), "");
+	NB_die_if(chain_init(&ch), "");
+
+	/* nht */
+	uint64_t spike_nht = 0;
+	nlc_timing_start(nht_set);
+	for (size_t i=0; i < n; i += BENCH_BATCH) {
+		nlc_timing_start(batch);
+		for (size_t j=i; j < i + BENCH_BATCH && j < n; j++)
+			NB_die_if(nht_set(nht, &keys[j], sizeof(keys[j]), j), "");
+		nlc_timing_stop(batch);
+		if (wall_batch > spike_nht)
+			spike_nht = wall_batch;
+	}
+	nlc_timing_stop(nht_set);
+
+	nlc_timing_start(nht_hit);
+	for (size_t i=0; i < n; i++) {
+		nht_val_t val;
+		NB_die_if(nht_get(nht, &keys[order[i]], sizeof(keys[0]), &val), "miss %zu", i);
+		sum += val.integer;
+	}
+	nlc_timing_stop(nht_hit);
+
+	nlc_timing_start(nht_miss);
+	for (size_t i=n; i < 2 * n; i++)
+		sum += !nht_get(nht, &keys[i], sizeof(keys[i]), NULL);
+	nlc_timing_stop(nht_miss);
+
+	/* chained */
+	uint64_t spike_chain = 0;
+	nlc_timing_start(chain_set);
+	for (size_t i=0; i < n; i += BENCH_BATCH) {
+		nlc_timing_start(batch);
+		for (size_t j=i; j < i + BENCH_BATCH && j < n; j++)
+			NB_die_if(chain_set(&ch, &keys[j], sizeof(keys[j]), j), "");
+		nlc_timing_stop(batch);
+		if (wall_batch > spike_chain)
+			spike_chain = wall_batch;
+	}
+	nlc_timing_stop(chain_set);
+
+	nlc_timing_start(chain_hit);
+	for (size_t i=0; i < n; i++) {
+		uintptr_t val;
+		NB_die_if(chain_get(&ch, &keys[order[i]], sizeof(keys[0]), &val), "miss %zu", i);
+		sum -= val;
+	}
+	nlc_timing_stop(chain_hit);
+
+	nlc_timing_start(chain_miss);
+	for (size_t i=n; i < 2 * n; i++) {
+		uintptr_t val;
+		sum -= !chain_get(&ch, &keys[i], sizeof(keys[i]), &val);
+	}
+	nlc_timing_stop(chain_miss);
+
+	NB_err_if(sum, "nht and chained tables disagree");
+
+	NB_prn("%zu entries: set / get hit / get miss (s); slowest batch of %d sets (ms)",
+		n, BENCH_BATCH);
+	NB_prn("\tnht    : %.3f / %.3f / %.3f; %.3f",
+		nlc_timing_wall(nht_set), nlc_timing_wall(nht_hit), nlc_timing_wall(nht_miss),
+		(double)spike_nht / 1000000);
+	NB_prn("\tchained: %.3f / %.3f / %.3f; %.3f",
+		nlc_timing_wall(chain_set), nlc_timing_wall(chain_hit), nlc_timing_wall(chain_miss),
+		(double)spike_chain / 1000000);
+
+die:
+	chain_free(&ch);
+	nht_free(nht);
+	free(order);
+	free(keys);
+	return err_cnt;
+}
+
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	err_cnt += check(300000, NULL);
+	err_cnt += check(3000, degenerate);
+
+	/* hint * 8 wraps to 8: refused, not a tiny table */
+	struct nht *wrap = nht_new(SIZE_MAX / 8 + 2, NULL);
+	NB_err_if(wrap != NULL, "hint %zu accepted", SIZE_MAX / 8 + 2);
+	nht_free(wrap);
+
+	size_t max = 1000000;
+	const char *env = getenv("NHT_BENCH_MAX");
+	if (env)
+		max = strtoull(env, NULL, 10);
+	for (size_t n = 1000000; n <= max; n *= 10)
+		err_cnt += bench(n);
+
+	return err_cnt;
+}
@@ -0,0 +1,234 @@
+/*	plifo_test.c
+
+Persistent LIFO: contents survive close and reopen; a crash rolls back to
+	the last sync, or fails to open if that cannot be trusted;
+	corrupt files are refused.
+And: reopening against rebuilding the stack by pushing every entry.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#include <plifo.h>
+#include <npath.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <stdlib.h> /* getenv(), mkdtemp() */
+#include <stdio.h> /* snprintf() */
+#include <limits.h> /* PATH_MAX */
+#include <unistd.h>
+
+
+/*	crash()
+Drop 'pl' without plifo_close(), as a crashed process would.
+*/
+static void crash(struct plifo *pl)
+{
+	nmem_free(&pl->nm, NULL);
+	free(pl);
+}
+
+
+/*	test_reopen()
+*/
+int test_reopen(const char *path, size_t numiter)
+{
+	int err_cnt = 0;
+	struct plifo *pl = NULL;
+	LIFO_MEM_TYPE pop;
+
+	NB_die_if(!(pl = plifo_new(path)), "");
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++) {
+		NB_die_if(plifo_push(pl, i) != i, "push %zu", i);
+	}
+	NB_die_if(plifo_close(pl), "");
+	pl = NULL;
+
+	NB_die_if((pl = plifo_new(path)) != NULL, "plifo_new() over an existing file");
+
+	NB_die_if(!(pl = plifo_open(path)), "");
+	NB_die_if(pl->stk->next != numiter, "%zu entries after reopen", pl->stk->next);
+	for (LIFO_MEM_TYPE i=numiter; i > numiter / 2; i--) {
+		NB_die_if(plifo_pop(pl, &pop) != i - 1 || pop != i - 1, "pop %zu", i - 1);
+	}
+	NB_die_if(plifo_close(pl), "");
+
+	NB_die_if(!(pl = plifo_open(path)), "");
+	NB_die_if(pl->stk->next != numiter / 2, "");
+	NB_die_if(pl->stk->mem[numiter / 2 - 1] != numiter / 2 - 1, "");
+
+die:
+	plifo_close(pl);
+	unlink(path);
+	return err_cnt;
+}
+
+
+/*	test_exists()
+plifo_new() fails, and writes nothing, when 'path' exists by the time its file
+	is linked there: here a dangling symlink, which access() does not see.
+*/
+int test_exists(const char *path)
+{
+	int err_cnt = 0;
+	struct plifo *pl = NULL;
+	char target[PATH_MAX];
+	snprintf(target, sizeof(target), "%s.target", path);
+
+	NB_die_if(symlink(target, path), "symlink '%s'", path);
+	NB_die_if((pl = plifo_new(path)) != NULL, "plifo_new() over a dangling symlink");
+	NB_die_if(!access(target, F_OK), "plifo_new() wrote '%s' through a symlink", target);
+
+die:
+	plifo_close(pl);
+	unlink(target);
+	unlink(path);
+	return err_cnt;
+}
+
+
+/*	test_crash()
+*/
+int test_crash(const char *path, size_t numiter)
+{
+	int err_cnt = 0;
+	struct plifo *pl = NULL;
+	LIFO_MEM_TYPE pop;
+
+	/* pushes after the sync are lost */
+	NB_die_if(!(pl = plifo_new(path)), "");
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++)
+		plifo_push(pl, i);
+	NB_die_if(plifo_sync(pl), "");
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++)
+		plifo_push(pl, 0);
+	crash(pl);
+	NB_die_if(!(pl = plifo_open(path)), "open after crash");
+	NB_die_if(pl->stk->next != numiter, "%zu entries, %zu synced", pl->stk->next, numiter);
+	NB_die_if(plifo_pop(pl, &pop) == LIFO_ERR || pop != numiter - 1, "");
+
+	/* pops alone are undone */
+	NB_die_if(plifo_push(pl, numiter - 1) == LIFO_ERR || plifo_sync(pl), "");
+	for (size_t i=0; i < numiter / 2; i++)
+		plifo_pop(pl, &pop);
+	crash(pl);
+	NB_die_if(!(pl = plifo_open(path)), "open after crash");
+	NB_die_if(pl->stk->next != numiter, "");
+	NB_die_if(pl->stk->mem[numiter - 1] != numiter - 1, "");
+
+	/* synced entries overwritten: cannot be trusted */
+	NB_die_if(plifo_pop(pl, &pop) == LIFO_ERR || plifo_push(pl, pop + 1) == LIFO_ERR, "");
+	crash(pl);
+	pl = NULL;
+	NB_die_if((pl = plifo_open(path)) != NULL, "opened with overwritten entries");
+
+die:
+	plifo_close(pl);
+	unlink(path);
+	return err_cnt;
+}
+
+
+/*	test_corrupt()
+*/
+int test_corrupt(const char *path)
+{
+	int err_cnt = 0;
+	struct plifo *pl = NULL;
+	struct nmem nm = { .fd = -1 };
+
+	NB_die_if(!(pl = plifo_new(path)), "");
+	NB_die_if(plifo_push(pl, 42) == LIFO_ERR, "");
+	NB_die_if(plifo_close(pl), "");
+	pl = NULL;
+
+	/* flip a bit in the header */
+	NB_die_if(nmem_file_rw(path, &nm), "");
+	((struct plifo_hdr *)nm.mem)->sync_next ^= 0x4;
+	nmem_free(&nm, NULL);
+	NB_die_if((pl = plifo_open(path)) != NULL, "opened with corrupt header");
+
+	/* not a plifo at all */
+	NB_die_if((pl = plifo_open("/dev/null")) != NULL, "opened /dev/null");
+
+die:
+	nmem_free(&nm, NULL);
+	plifo_close(pl);
+	unlink(path);
+	return err_cnt;
+}
+
+
+/*	bench()
+Restart: rebuild by pushing every entry, against mapping the file back.
+*/
+int bench(const char *path, size_t numiter)
+{
+	int err_cnt = 0;
+	struct plifo *pl = NULL;
+	struct lifo *stk = NULL;
+
+	NB_die_if(!(pl = plifo_new(path)), "");
+	NB_die_if(plifo_reserve(pl, numiter), "");
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++)
+		plifo_push(pl, i);
+
+	nlc_timing_start(sync);
+	NB_die_if(plifo_sync(pl), "");
+	nlc_timing_stop(sync);
+	nlc_timing_start(close);
+	NB_die_if(plifo_close(pl), "");
+	nlc_timing_stop(close);
+	pl = NULL;
+
+	nlc_timing_start(rebuild);
+	NB_die_if(!(stk = lifo_new()), "");
+	for (LIFO_MEM_TYPE i=0; i < numiter; i++)
+		lifo_push(&stk, i);
+	nlc_timing_stop(rebuild);
+
+	nlc_timing_start(reopen);
+	NB_die_if(!(pl = plifo_open(path)), "");
+	nlc_timing_stop(reopen);
+	NB_die_if(pl->stk->next != numiter, "");
+
+	NB_prn("%zu entries: rebuild %.3f ms, plifo_open() %.3f ms; plifo_sync() %.1f ms, plifo_close() %.1f ms",
+		numiter,
+		nlc_timing_wall(rebuild) * 1e3, nlc_timing_wall(reopen) * 1e3,
+		nlc_timing_wall(sync) * 1e3, nlc_timing_wall(close) * 1e3);
+
+die:
+	lifo_free(stk);
+	plifo_close(pl);
+	unlink(path);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	char *path = NULL;
+
+	/* do MUCH less work if VALGRIND environment variable is set */
+	size_t numiter = 1 << 23;
+	if (getenv("VALGRIND"))
+		numiter = 1 << 12;
+
+	char dir[] = "/tmp/plifo_test_XXXXXX";
+	NB_die_if(!mkdtemp(dir), "mkdtemp");
+	path = n_join(dir, "stack");
+
+	err_cnt += test_reopen(path, numiter / 16);
+	err_cnt += test_exists(path);
+	err_cnt += test_crash(path, numiter / 16);
+	err_cnt += test_corrupt(path);
+	err_cnt += bench(path, numiter);
+
+	rmdir(dir);
+die:
+	free(path);
+	return err_cnt;
+}
@@ -0,0 +1,407 @@
+/*	ring_test.c
+
+Bounded FIFO: order and full/empty when single-threaded; no ID lost,
+	duplicated or (per producer) reordered with threads at both ends;
+	eventfd wakeups; and throughput and latency, by pair of CPUs.
+
+(c) 2018 Sirio Balmelli; https://b-ad.ch
+*/
+
+#ifdef __linux__
+	#define _GNU_SOURCE /* pthread_setaffinity_np() */
+#endif
+#include <ring.h>
+#include <ndebug.h>
+#include <nonlibc.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h> /* getenv() */
+#include <unistd.h>
+#ifdef __linux__
+	#include <poll.h>
+#endif
+
+
+#define THREADS_MAX 4
+#define BATCH_MAX 32
+
+
+/*	test_fifo()
+*/
+int test_fifo(unsigned flags)
+{
+	int err_cnt = 0;
+	struct ring *rg = NULL;
+	RING_MEM_TYPE buf[BATCH_MAX];
+	RING_MEM_TYPE val;
+
+	NB_die_if(!(rg = ring_new(100, flags)), "");
+	NB_die_if(rg->size != 128, "size %"PRIu64" not rounded up", rg->size);
+
+	/* fill, overfill, drain */
+	for (RING_MEM_TYPE i=0; i < rg->size; i++) {
+		NB_die_if(ring_enqueue(rg, i), "enqueue %zu", i);
+	}
+	NB_die_if(!ring_enqueue(rg, 0), "enqueue into full ring");
+	NB_die_if(ring_count(rg) != rg->size, "");
+	for (RING_MEM_TYPE i=0; i < rg->size; i++) {
+		NB_die_if(ring_dequeue(rg, &val) || val != i, "dequeue %zu: %zu", i, val);
+	}
+	NB_die_if(!ring_dequeue(rg, &val), "dequeue from empty ring");
+
+	/* batches of every size, across the wrap */
+	RING_MEM_TYPE next_in = 0, next_out = 0;
+	for (size_t i=0; i < rg->size * 8; i++) {
+		size_t cnt = i % BATCH_MAX + 1;
+		for (size_t j=0; j < cnt; j++)
+			buf[j] = next_in + j;
+		next_in += ring_enqueue_n(rg, buf, cnt);
+		size_t got = ring_dequeue_n(rg, buf, (i * 7) % BATCH_MAX + 1);
+		for (size_t j=0; j < got; j++, next_out++) {
+			NB_die_if(buf[j] != next_out, "batch %zu: %zu != %zu", i, buf[j], next_out);
+		}
+		NB_die_if(ring_count(rg) != next_in - next_out, "");
+		NB_die_if(ring_count(rg) > rg->size, "");
+	}
+
+die:
+	ring_free(rg);
+	return err_cnt;
+}
+
+
+/*	worker
+Producers enqueue their own range of IDs in batches;
+	consumers dequeue until all IDs are out, and check them.
+*/
+struct worker {
+	pthread_t	tid;
+	struct ring	*rg;
+	size_t		id;
+	size_t		numiter;	/* IDs per producer */
+	size_t		producers;
+	size_t		*consumed;	/* shared */
+	size_t		total;
+	uint8_t		*seen;		/* one per ID, shared */
+	int		err_cnt;
+};
+
+void *producer(void *arg)
+{
+	struct worker *w = arg;
+	RING_MEM_TYPE buf[BATCH_MAX];
+	RING_MEM_TYPE base = w->id * w->numiter;
+	for (size_t i=0; i < w->numiter; ) {
+		size_t cnt = (i / 3 + w->id) % BATCH_MAX + 1;
+		if (cnt > w->numiter - i)
+			cnt = w->numiter - i;
+		for (size_t j=0; j < cnt; j++)
+			buf[j] = base + i + j;
+		/* a partial batch must resume where it stopped */
+		size_t done = ring_enqueue_n(w->rg, buf, cnt);
+		if (!done)
+			sched_yield();
+		i += done;
+	}
+	return NULL;
+}
+
+void *consumer(void *arg)
+{
+	struct worker *w = arg;
+	RING_MEM_TYPE buf[BATCH_MAX];
+	RING_MEM_TYPE last[THREADS_MAX];
+	for (size_t i=0; i < w->producers; i++)
+		last[i] = (RING_MEM_TYPE)-1;
+
+	while (__atomic_load_n(w->consumed, __ATOMIC_RELAXED) < w->total) {
+		size_t got = ring_dequeue_n(w->rg, buf, (w->id * 5) % BATCH_MAX + 1);
+		if (!got) {
+			sched_yield();
+			continue;
+		}
+		for (size_t j=0; j < got; j++) {
+			if (buf[j] >= w->total || __atomic_fetch_add(&w->seen[buf[j]], 1, __ATOMIC_RELAXED))
+				w->err_cnt++;
+			/* one consumer: each producer's IDs come out in order */
+			if (!(w->rg->flags & RING_MC)) {
+				size_t p = buf[j] / w->numiter;
+				if (p < w->producers && last[p] + 1 != buf[j] - p * w->numiter)
+					w->err_cnt++;
+				if (p < w->producers)
+					last[p] = buf[j] - p * w->numiter;
+			}
+		}
+		__atomic_fetch_add(w->consumed, got, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+
+/*	test_threads()
+*/
+int test_threads(unsigned flags, size_t producers, size_t consumers, size_t numiter)
+{
+	int err_cnt = 0;
+	struct ring *rg = NULL;
+	uint8_t *seen = NULL;
+	size_t consumed = 0;
+	size_t total = producers * numiter;
+	struct worker p[THREADS_MAX] = { { 0 } };
+	struct worker c[THREADS_MAX] = { { 0 } };
+
+	NB_die_if(!(rg = ring_new(256, flags)), "");
+	NB_die_if(!(seen = calloc(total, 1)), "");
+	for (size_t i=0; i < consumers; i++) {
+		c[i] = (struct worker){ .rg = rg, .id = i, .numiter = numiter,
+			.producers = producers, .consumed = &consumed, .total = total,
+			.seen = seen };
+		NB_die_if(pthread_create(&c[i].tid, NULL, consumer, &c[i]), "");
+	}
+	for (size_t i=0; i < producers; i++) {
+		p[i] = (struct worker){ .rg = rg, .id = i, .numiter = numiter };
+		NB_die_if(pthread_create(&p[i].tid, NULL, producer, &p[i]), "");
+	}
+	for (size_t i=0; i < producers; i++)
+		pthread_join(p[i].tid, NULL);
+	for (size_t i=0; i < consumers; i++) {
+		pthread_join(c[i].tid, NULL);
+		NB_err_if(c[i].err_cnt, "%zuP/%zuC consumer %zu: %d errors",
+			producers, consumers, i, c[i].err_cnt);
+		err_cnt += c[i].err_cnt;
+	}
+
+	for (size_t i=0; i < total; i++) {
+		NB_die_if(seen[i] != 1, "%zuP/%zuC: ID %zu seen %d times",
+			producers, consumers, i, seen[i]);
+	}
+	NB_die_if(ring_count(rg), "ring not empty");
+
+die:
+	free(seen);
+	ring_free(rg);
+	return err_cnt;
+}
+
+
+/*	test_eventfd()
+The consumer sleeps in poll() on ring_fd(); the producer enqueues in bursts.
+A lost wakeup shows up as a poll() timeout.
+*/
+#ifdef __linux__
+struct efd_arg {
+	struct ring	*rg;
+	size_t		numiter;
+};
+
+void *efd_producer(void *arg)
+{
+	struct efd_arg *a = arg;
+	for (RING_MEM_TYPE i=0; i < a->numiter; ) {
+		i += ring_enqueue_n(a->rg, &i, 1);
+		if (!(i % 64))
+			usleep(100);
+	}
+	return NULL;
+}
+#endif
+
+int test_eventfd(size_t numiter)
+{
+	int err_cnt = 0;
+#ifdef __linux__
+	struct ring *rg = NULL;
+	pthread_t tid;
+	size_t wakeups = 0;
+
+	NB_die_if(!(rg = ring_new(64, RING_SPSC | RING_EVENTFD)), "");
+	NB_die_if(ring_fd(rg) < 0, "");
+	struct efd_arg a = { .rg = rg, .numiter = numiter };
+	NB_die_if(pthread_create(&tid, NULL, efd_producer, &a), "");
+
+	RING_MEM_TYPE next = 0, val;
+	while (next < numiter) {
+		struct pollfd pfd = { .fd = ring_fd(rg), .events = POLLIN };
+		int ret = poll(&pfd, 1, 2000);
+		NB_die_if(ret < 0, "poll");
+		NB_die_if(!ret, "no wakeup: %zu of %zu IDs, %zu in ring",
+			next, numiter, ring_count(rg));
+		wakeups++;
+		ring_fd_clear(rg);
+		while (!ring_dequeue(rg, &val)) {
+			NB_die_if(val != next, "%zu != %zu", val, next);
+			next++;
+		}
+	}
+	pthread_join(tid, NULL);
+	NB_inf("%zu IDs, %zu wakeups", numiter, wakeups);
+
+die:
+	ring_free(rg);
+#endif
+	return err_cnt;
+}
+
+
+/*	bench
+Throughput: one producer and one consumer, on a pair of CPUs.
+Latency: one ID back and forth over two rings (round trip).
+*/
+struct bench {
+	pthread_t	tid;
+	struct ring	*rg;
+	struct ring	*back;
+	size_t		numiter;
+	size_t		batch;
+	int		cpu;
+};
+
+static void bench_pin(int cpu)
+{
+#ifdef __linux__
+	if (cpu < 0)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+void *bench_prod(void *arg)
+{
+	struct bench *b = arg;
+	bench_pin(b->cpu);
+	RING_MEM_TYPE buf[BATCH_MAX] = { 0 };
+	for (size_t i=0; i < b->numiter; ) {
+		size_t n = ring_enqueue_n(b->rg, buf, b->batch);
+		if (!n)
+			sched_yield();
+		i += n;
+	}
+	return NULL;
+}
+
+void *bench_cons(void *arg)
+{
+	struct bench *b = arg;
+	bench_pin(b->cpu);
+	RING_MEM_TYPE buf[BATCH_MAX];
+	for (size_t i=0; i < b->numiter; ) {
+		size_t n = ring_dequeue_n(b->rg, buf, b->batch);
+		if (!n)
+			sched_yield();
+		i += n;
+	}
+	return NULL;
+}
+
+void *bench_echo(void *arg)
+{
+	struct bench *b = arg;
+	bench_pin(b->cpu);
+	RING_MEM_TYPE val;
+	for (size_t i=0; i < b->numiter; i++) {
+		while (ring_dequeue(b->rg, &val))
+			sched_yield();
+		while (ring_enqueue(b->back, val))
+			sched_yield();
+	}
+	return NULL;
+}
+
+int bench_pair(unsigned flags, int cpu_a, int cpu_b, size_t numiter)
+{
+	int err_cnt = 0;
+	struct ring *rg = NULL, *back = NULL;
+	NB_die_if(!(rg = ring_new(1024, flags)) || !(back = ring_new(1024, flags)), "");
+
+	double mops[2];
+	const size_t batches[] = { 1, BATCH_MAX };
+	for (size_t i=0; i < NLC_ARRAY_LEN(batches); i++) {
+		struct bench p = { .rg = rg, .numiter = numiter, .batch = batches[i], .cpu = cpu_a };
+		struct bench c = { .rg = rg, .numiter = numiter, .batch = batches[i], .cpu = cpu_b };
+		nlc_timing_start(thru);
+		NB_die_if(pthread_create(&c.tid, NULL, bench_cons, &c), "");
+		NB_die_if(pthread_create(&p.tid, NULL, bench_prod, &p), "");
+		pthread_join(p.tid, NULL);
+		pthread_join(c.tid, NULL);
+		nlc_timing_stop(thru);
+		mops[i] = numiter / nlc_timing_wall(thru) / 1e6;
+	}
+
+	/* round trips: fewer, they are slow if the CPUs are shared */
+	size_t trips = numiter / 64;
+	struct bench e = { .rg = rg, .back = back, .numiter = trips, .cpu = cpu_b };
+	bench_pin(cpu_a);
+	RING_MEM_TYPE val;
+	nlc_timing_start(lat);
+	NB_die_if(pthread_create(&e.tid, NULL, bench_echo, &e), "");
+	for (RING_MEM_TYPE i=0; i < trips; i++) {
+		while (ring_enqueue(rg, i))
+			sched_yield();
+		while (ring_dequeue(back, &val))
+			sched_yield();
+		NB_die_if(val != i, "echo %zu != %zu", val, i);
+	}
+	pthread_join(e.tid, NULL);
+	nlc_timing_stop(lat);
+
+	NB_prn("%s CPUs %d,%d: Mops/s %.1f (batch 1), %.1f (batch %d); round trip %.0f ns",
+		flags & RING_MC ? "MPMC" : flags & RING_MP ? "MPSC" : "SPSC",
+		cpu_a, cpu_b, mops[0], mops[1], BATCH_MAX,
+		nlc_timing_wall(lat) * 1e9 / trips);
+
+die:
+	ring_free(back);
+	ring_free(rg);
+	return err_cnt;
+}
+
+int bench(size_t numiter)
+{
+	int err_cnt = 0;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const unsigned flags[] = { RING_SPSC, RING_MPSC, RING_MPMC };
+
+	for (size_t f=0; f < NLC_ARRAY_LEN(flags); f++) {
+		if (cpus < 2) {
+			/* unpinned: both threads time-share one CPU */
+			err_cnt += bench_pair(flags[f], -1, -1, numiter);
+			continue;
+		}
+		/* CPU 0 against a neighbour and against the farthest (maybe other socket) */
+		err_cnt += bench_pair(flags[f], 0, 1, numiter);
+		if (cpus > 2)
+			err_cnt += bench_pair(flags[f], 0, cpus - 1, numiter);
+	}
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+
+	/* do MUCH less work if VALGRIND environment variable is set */
+	size_t numiter = 1 << 20;
+	if (getenv("VALGRIND"))
+		numiter = 1 << 12;
+
+	const unsigned flags[] = { RING_SPSC, RING_MPSC, RING_MPMC };
+	for (size_t f=0; f < NLC_ARRAY_LEN(flags); f++)
+		err_cnt += test_fifo(flags[f]);
+
+	err_cnt += test_threads(RING_SPSC, 1, 1, numiter);
+	for (size_t threads=1; threads <= THREADS_MAX; threads *= 2) {
+		err_cnt += test_threads(RING_MPSC, threads, 1, numiter / threads);
+		err_cnt += test_threads(RING_MPMC, threads, threads, numiter / threads);
+	}
+	err_cnt += test_eventfd(numiter / 64);
+	err_cnt += bench(numiter * 4);
+
+	return err_cnt;
+}
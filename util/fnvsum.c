@@ -6,8 +6,10 @@
  * (c) 2017 Sirio Balmelli; https://b-ad.ch
  */
 
+#define _GNU_SOURCE /* F_SETPIPE_SZ */
 #include <ndebug.h>
 #include <fnv.h>
+#include <nmem.h>
 #include <getopt.h>
 #include <limits.h> /* PIPE_BUF */
 
@@ -17,12 +19,258 @@
 #include <fcntl.h> /* open() */
 #include <sys/mman.h> /* mmap() */
 #include <stdlib.h> /* strtol */
+#include <pthread.h>
+#include <string.h> /* strcmp() */
+#include <strings.h> /* strcasecmp() */
 
 
-/*	do_stdin()
- * Hash the contents of stdin; until EOF or errno do us part.
+/*
+	global option flags
+*/
+static int tree = 0;
+static int fast = 0; /* fnv_fast64() */
+static long threads = 0; /* 0 == one per online CPU */
+static int stdio = 0; /* read stdin with fread() only */
+static int check = 0; /* FILEs are manifests to verify */
+
+
+/* Longest hash as a hex string, plus '\0' */
+#define HEX_MAX 33
+
+/* Files up to this size are read() into a (reused) worker buffer:
+ * cheaper than the mmap()/munmap() round-trip and its page faults.
  */
-int	do_stdin(size_t bitlength)
+#define SMALL_FILE (64 * 1024)
+
+/* A piped stdin is spliced into two buffers of STDIN_BUF bytes;
+ * the pipe itself is grown to STDIN_PIPE_SZ if allowed.
+ */
+#define STDIN_BUF (4 * 1024 * 1024)
+#define STDIN_PIPE_SZ (1024 * 1024)
+
+/* '--check' reads and verifies this many manifest lines at a time */
+#define CHECK_BATCH 4096
+
+
+/*	struct tree_work
+ * A contiguous range of leaves hashed by one thread.
+ */
+struct tree_work {
+	pthread_t	thread;
+	const void	*data;
+	size_t		data_len;
+	size_t		first;
+	size_t		cnt;
+	uint64_t	*digests;
+};
+
+/*	tree_worker()
+ */
+static void *tree_worker(void *arg)
+{
+	struct tree_work *work = arg;
+	fnv_tree_leaf64(work->data, work->data_len, FNV_TREE_LEAF,
+			work->first, work->cnt, &work->digests[work->first]);
+	return NULL;
+}
+
+/*	tree_hash()
+ * Tree hash 'data', spreading leaves across (at most) 'nthr' threads.
+ * Each thread gets a contiguous range of leaves and writes only its own digests:
+ * the result is independent of the number of threads.
+ * Returns 0 on success.
+ */
+int tree_hash(const void *data, size_t data_len, long nthr, uint64_t *out)
+{
+	int err_cnt = 0;
+	uint64_t *digests = NULL;
+	struct tree_work *work = NULL;
+	long started = 0;
+
+	size_t leaves = fnv_tree_leaves(data_len, FNV_TREE_LEAF);
+	if (nthr > leaves)
+		nthr = leaves;
+
+	NB_die_if(!(
+		digests = malloc(leaves * sizeof(*digests))
+		), "malloc %zu leaf digests", leaves);
+	NB_die_if(!(
+		work = calloc(nthr, sizeof(*work))
+		), "calloc %ld threads", nthr);
+
+	/* split leaves evenly; the first 'rem' threads get one extra */
+	size_t share = leaves / nthr;
+	size_t rem = leaves % nthr;
+	for (long i=0, first=0; i < nthr; i++) {
+		work[i] = (struct tree_work){
+			.data = data,
+			.data_len = data_len,
+			.first = first,
+			.cnt = share + (i < rem),
+			.digests = digests
+		};
+		first += work[i].cnt;
+	}
+
+	/* this thread takes the first range itself */
+	for (started=1; started < nthr; started++) {
+		NB_die_if(pthread_create(&work[started].thread, NULL, tree_worker, &work[started]),
+			"pthread_create");
+	}
+	tree_worker(&work[0]);
+
+die:
+	for (long i=1; i < started; i++)
+		pthread_join(work[i].thread, NULL);
+	if (!err_cnt)
+		*out = fnv_tree_root64(NULL, digests, leaves);
+	free(work);
+	free(digests);
+	return err_cnt;
+}
+
+
+#ifdef __SIZEOF_INT128__
+/*	hex128()
+ * Print a 128-bit hash the way "%"PRIx64 prints the others: no leading zeroes.
+ */
+void hex128(char *hex, fnv128_t hash)
+{
+	uint64_t hi = hash >> 64;
+	if (hi)
+		snprintf(hex, HEX_MAX, "%"PRIx64"%016"PRIx64, hi, (uint64_t)hash);
+	else
+		snprintf(hex, HEX_MAX, "%"PRIx64, (uint64_t)hash);
+}
+#endif
+
+
+/*	struct stream
+ * Incremental hash state for an input of unknown length (stdin);
+ * gives the same result as hash_mem() over the whole input.
+ */
+struct stream {
+	size_t		bitlength;
+	uint64_t	h64;
+	uint32_t	h32;		/* 16-bit hashes fold this only at the end */
+#ifdef __SIZEOF_INT128__
+	fnv128_t	h128;
+#endif
+	struct fnv_fast64_state	fast;
+	uint64_t	leaf;		/* tree: digest of the current leaf ... */
+	size_t		leaf_fill;	/* ... and how many bytes are in it */
+	size_t		leaves;
+};
+
+/*	stream_init()
+ */
+void stream_init(struct stream *st, size_t bitlength)
+{
+	*st = (struct stream){
+		.bitlength = bitlength,
+		.h64 = fnv_hash64(NULL, NULL, 0),
+		.h32 = fnv_hash32(NULL, NULL, 0),
+		.leaf = fnv_hash64(NULL, NULL, 0)
+	};
+#ifdef __SIZEOF_INT128__
+	st->h128 = fnv_hash128(NULL, NULL, 0);
+#endif
+	if (tree)
+		st->h64 = fnv_tree_root64(NULL, NULL, 0);
+	fnv_fast64_init(&st->fast);
+}
+
+/*	stream_update()
+ * Hash 'len' more bytes at 'data'.
+ */
+void stream_update(struct stream *st, const void *data, size_t len)
+{
+	const uint8_t *d = data;
+
+	if (fast) {
+		fnv_fast64_update(&st->fast, d, len);
+
+	} else if (tree) {
+		/* Fold each leaf into the root as soon as it is full.
+		 * No parallelism on a stream, but the same result as for a file.
+		 */
+		for (size_t done = 0; done < len; ) {
+			size_t take = FNV_TREE_LEAF - st->leaf_fill;
+			if (take > len - done)
+				take = len - done;
+			st->leaf = fnv_hash64(&st->leaf, &d[done], take);
+			st->leaf_fill += take;
+			done += take;
+
+			if (st->leaf_fill == FNV_TREE_LEAF) {
+				st->h64 = fnv_tree_root64(&st->h64, &st->leaf, 1);
+				st->leaves++;
+				st->leaf = fnv_hash64(NULL, NULL, 0);
+				st->leaf_fill = 0;
+			}
+		}
+
+	} else if (st->bitlength == 64) {
+		st->h64 = fnv_hash64(&st->h64, d, len);
+
+#ifdef __SIZEOF_INT128__
+	} else if (st->bitlength == 128) {
+		st->h128 = fnv_hash128(&st->h128, d, len);
+#endif
+
+	} else {
+		st->h32 = fnv_hash32(&st->h32, d, len);
+	}
+}
+
+/*	stream_final()
+ * Write the hash as a hex string to 'hex' (at least HEX_MAX bytes).
+ * Returns 0 on success.
+ */
+int stream_final(struct stream *st, char *hex)
+{
+	int err_cnt = 0;
+
+	if (fast) {
+		snprintf(hex, HEX_MAX, "%"PRIx64, fnv_fast64_final(&st->fast));
+
+	} else if (tree) {
+		/* trailing partial leaf, or the single empty leaf of an empty input */
+		if (st->leaf_fill || !st->leaves)
+			st->h64 = fnv_tree_root64(&st->h64, &st->leaf, 1);
+		snprintf(hex, HEX_MAX, "%"PRIx64, st->h64);
+
+	} else if (st->bitlength == 64) {
+		snprintf(hex, HEX_MAX, "%"PRIx64, st->h64);
+
+#ifdef __SIZEOF_INT128__
+	} else if (st->bitlength == 128) {
+		hex128(hex, st->h128);
+#endif
+
+	} else if (st->bitlength == 32) {
+		snprintf(hex, HEX_MAX, "%"PRIx32, st->h32);
+
+	} else if (st->bitlength == 16) {
+		/* xor-fold, as fnv_hash16() */
+		uint16_t hash = (st->h32 >> 16) ^ (st->h32 & 0xffff);
+		snprintf(hex, HEX_MAX, "%"PRIx16, hash);
+
+	} else {
+		NB_die("bitlength %zu invalid", st->bitlength);
+	}
+
+die:
+	return err_cnt;
+}
+
+
+/*	stdin_stdio()
+ * Hash stdin through fread() in PIPE_BUF chunks.
+ * This is the original (slow) path: kept for '--stdio',
+ * and for inputs which are neither pipes nor regular files (e.g. a terminal).
+ */
+int stdin_stdio(struct stream *st)
 {
 	int err_cnt = 0;
 	/* The smallest unit of atomic FD I/O
@@ -32,90 +280,527 @@ int	do_stdin(size_t bitlength)
 	uint8_t buf[PIPE_BUF];
 	size_t size;
 
-	if (bitlength == 64) {
-		uint64_t hash = fnv_hash64(NULL, NULL, 0);
-		/* full buffer blocks */
-		while ((size = fread(buf, sizeof(buf[0]), PIPE_BUF, stdin)) == PIPE_BUF)
-			hash = fnv_hash64(&hash, buf, PIPE_BUF);
-		/* Hash trailing blocks.
-		 * NOTE that '0' is a valid size to hash; it does nothing.
-		 */
-		hash = fnv_hash64(&hash, buf, size);
-		printf("%"PRIx64"  -\n", hash);
+	while ((size = fread(buf, sizeof(buf[0]), PIPE_BUF, stdin)))
+		stream_update(st, buf, size);
+	NB_die_if(ferror(stdin), "fread() stdin");
+
+die:
+	return err_cnt;
+}
+
+
+/*	struct ingest
+ * Double-buffering between a reader thread splicing stdin into one buffer
+ * and the hashing thread consuming the other.
+ * A buffer belongs to the reader while '!full', to the hasher while 'full'.
+ */
+struct ingest {
+	struct {
+		struct nmem	nm;
+		size_t		fill;
+		int		full;
+		int		last;	/* EOF or error: nothing follows */
+	}		buf[2];
+	int		fd;
+	int		err;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+};
+
+/*	ingest_reader()
+ * Fill buffers alternately until EOF.
+ */
+static void *ingest_reader(void *arg)
+{
+	struct ingest *in = arg;
+	int last = 0;
+
+	for (int i=0; !last; i ^= 1) {
+		pthread_mutex_lock(&in->lock);
+		while (in->buf[i].full)
+			pthread_cond_wait(&in->cond, &in->lock);
+		pthread_mutex_unlock(&in->lock);
+
+		struct nmem *nm = &in->buf[i].nm;
+		size_t fill = 0;
+		while (fill < nm->len) {
+			ssize_t ret = nmem_in_splice(nm, fill, nm->len - fill, in->fd);
+			if (ret < 1) {
+				in->err = (ret < 0);
+				last = 1;
+				break;
+			}
+			fill += ret;
+		}
+
+		pthread_mutex_lock(&in->lock);
+		in->buf[i].fill = fill;
+		in->buf[i].last = last;
+		in->buf[i].full = 1;
+		pthread_cond_broadcast(&in->cond);
+		pthread_mutex_unlock(&in->lock);
+	}
+	return NULL;
+}
+
+/*	stdin_splice()
+ * Hash stdin (a pipe) by splicing it into a pair of memfd-backed buffers:
+ * a reader thread fills one while this thread hashes the other.
+ */
+int stdin_splice(struct stream *st)
+{
+	int err_cnt = 0;
+	struct ingest in = {
+		.fd = STDIN_FILENO,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER
+	};
+	in.buf[0].nm.fd = in.buf[1].nm.fd = -1;
+	pthread_t reader;
+	int started = 0;
+
+	/* A larger pipe means fewer, larger splices and fewer wakeups of the writer.
+	 * Best effort: the limit (/proc/sys/fs/pipe-max-size) may be lower.
+	 */
+#ifdef F_SETPIPE_SZ
+	if (fcntl(in.fd, F_SETPIPE_SZ, STDIN_PIPE_SZ) == -1) {
+		NB_inf("could not grow stdin pipe to %d", STDIN_PIPE_SZ);
+	}
+#endif
+
+	for (int i=0; i < 2; i++) {
+		NB_die_if(nmem_alloc(STDIN_BUF, NULL, &in.buf[i].nm),
+			"alloc %d B stdin buffer", STDIN_BUF);
+	}
+
+	NB_die_if(pthread_create(&reader, NULL, ingest_reader, &in),
+		"pthread_create");
+	started = 1;
+
+	for (int i=0, last=0; !last; i ^= 1) {
+		pthread_mutex_lock(&in.lock);
+		while (!in.buf[i].full)
+			pthread_cond_wait(&in.cond, &in.lock);
+		pthread_mutex_unlock(&in.lock);
+
+		stream_update(st, in.buf[i].nm.mem, in.buf[i].fill);
+		last = in.buf[i].last;
+
+		pthread_mutex_lock(&in.lock);
+		in.buf[i].full = 0;
+		pthread_cond_broadcast(&in.cond);
+		pthread_mutex_unlock(&in.lock);
+	}
+	NB_die_if(in.err, "splice() stdin");
+
+die:
+	if (started)
+		pthread_join(reader, NULL);
+	for (int i=0; i < 2; i++)
+		nmem_free(&in.buf[i].nm, NULL);
+	return err_cnt;
+}
+
+
+/*	hash_mem()
+ * Hash 'len' bytes at 'mem' according to 'bitlength' and options;
+ * write the hash as a hex string to 'hex' (at least HEX_MAX bytes).
+ * 'tree_threads' is how many threads a tree hash may use.
+ * Returns 0 on success.
+ */
+int hash_mem(const void *mem, size_t len, size_t bitlength, long tree_threads, char *hex)
+{
+	int err_cnt = 0;
+
+	if (fast) {
+		snprintf(hex, HEX_MAX, "%"PRIx64, fnv_fast64(mem, len));
+
+	} else if (tree) {
+		uint64_t hash;
+		NB_die_if(tree_hash(mem, len, tree_threads, &hash), "");
+		snprintf(hex, HEX_MAX, "%"PRIx64, hash);
+
+	} else if (bitlength == 64) {
+		snprintf(hex, HEX_MAX, "%"PRIx64, fnv_hash64(NULL, mem, len));
+
+#ifdef __SIZEOF_INT128__
+	} else if (bitlength == 128) {
+		hex128(hex, fnv_hash128(NULL, mem, len));
+#endif
 
 	} else if (bitlength == 32) {
-		uint32_t hash = fnv_hash32(NULL, NULL, 0);
-		while ((size = fread(buf, sizeof(buf[0]), PIPE_BUF, stdin)) == PIPE_BUF)
-			hash = fnv_hash32(&hash, buf, PIPE_BUF);
-		hash = fnv_hash32(&hash, buf, size);
-		printf("%"PRIx32"  -\n", hash);
+		snprintf(hex, HEX_MAX, "%"PRIx32, fnv_hash32(NULL, mem, len));
 
 	} else if (bitlength == 16) {
-		uint16_t hash = fnv_hash16(NULL, NULL, 0);
-		while ((size = fread(buf, sizeof(buf[0]), PIPE_BUF, stdin)) == PIPE_BUF)
-			hash = fnv_hash16(&hash, buf, PIPE_BUF);
-		hash = fnv_hash16(&hash, buf, size);
-		printf("%"PRIx16"  -\n", hash);
+		snprintf(hex, HEX_MAX, "%"PRIx16, fnv_hash16(NULL, mem, len));
 
 	} else {
-		NB_err("bitlength %zu invalid", bitlength);
+		NB_die("bitlength %zu invalid", bitlength);
 	}
+
+die:
 	return err_cnt;
 }
 
 
-/*	do_file()
- * Hash a file, print the results;
+/*	hash_file()
+ * Hash a file into 'hex' (see hash_mem() above).
+ * Files of at most SMALL_FILE bytes are read into 'buf' (if given);
+ * larger ones are mapped.
+ * Returns 0 on success.
  */
-int do_file(const char *file, size_t bitlength)
+int hash_file(const char *file, size_t bitlength, long tree_threads, uint8_t *buf, char *hex)
 {
 	int err_cnt = 0;
 	int fd = -1;
 	void *map = NULL;
 
-	/* a '-' file is handled as stdin */
-	if (file[0] == '-')
-		return do_stdin(bitlength);
-
-	/* stat file; sanity */
+	/* open, then stat the open file: one path lookup per file.
+	 * O_NONBLOCK: a FIFO must not block the open() (it is refused below);
+	 * it has no effect on regular files.
+	 */
 	struct stat st;
-	NB_die_if( stat(file, &st),
+	NB_die_if((
+		fd = open(file, O_RDONLY | O_NONBLOCK)
+		) == -1, "open() '%s'", file);
+	NB_die_if( fstat(fd, &st),
 		"error stat()ing '%s'", file);
 	NB_die_if(!S_ISREG(st.st_mode),
 		"'%s' not a regular file", file);
 
-	if (st.st_size) {
-		/* open file */
-		NB_die_if((
-			fd = open(file, O_RDONLY)
-			) == -1, "open() '%s'", file);
+	if (buf && st.st_size && st.st_size <= SMALL_FILE) {
+		size_t len = 0;
+		ssize_t ret;
+		while (len < st.st_size && (ret = read(fd, &buf[len], st.st_size - len))) {
+			NB_die_if(ret < 0, "read() '%s'", file);
+			len += ret;
+		}
+		NB_die_if(hash_mem(buf, len, bitlength, tree_threads, hex),
+			"hash '%s'", file);
+
+	} else {
 		/* map it */
-		NB_die_if((
-			map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)
-			) == MAP_FAILED, "mmap() '%s'", file);
+		if (st.st_size) {
+			NB_die_if((
+				map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)
+				) == MAP_FAILED, "mmap() '%s'", file);
+		}
+		NB_die_if(hash_mem(map, st.st_size, bitlength, tree_threads, hex),
+			"hash '%s'", file);
 	}
 
-	if (bitlength == 64) {
-		uint64_t hash = fnv_hash64(NULL, map, st.st_size);
-		printf("%"PRIx64"  %s\n", hash, file);
+die:
+	if (map && map != MAP_FAILED)
+		munmap(map, st.st_size);
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
 
-	} else if (bitlength == 32) {
-		uint32_t hash = fnv_hash32(NULL, map, st.st_size);
-		printf("%"PRIx32"  %s\n", hash, file);
 
-	} else if (bitlength == 16) {
-		uint16_t hash = fnv_hash16(NULL, map, st.st_size);
-		printf("%"PRIx16"  %s\n", hash, file);
+/*	do_stdin()
+ * Hash the contents of stdin; until EOF or errno do us part.
+ * A regular file (e.g. 'fnvsum < file') is mapped and hashed as any FILE;
+ * a pipe is spliced and hashed as it arrives.
+ */
+int	do_stdin(size_t bitlength)
+{
+	int err_cnt = 0;
+	char hex[HEX_MAX];
+	void *map = NULL;
+
+	struct stat st;
+	NB_die_if(fstat(STDIN_FILENO, &st), "fstat() stdin");
+
+	/* map only if nothing has been read yet (e.g. not '- -') */
+	if (!stdio && S_ISREG(st.st_mode) && !lseek(STDIN_FILENO, 0, SEEK_CUR)) {
+		if (st.st_size) {
+			NB_die_if((
+				map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, STDIN_FILENO, 0)
+				) == MAP_FAILED, "mmap() stdin");
+		}
+		NB_die_if(hash_mem(map, st.st_size, bitlength, threads, hex), "");
+		/* consume it, as reading would have */
+		lseek(STDIN_FILENO, st.st_size, SEEK_SET);
 
 	} else {
-		NB_err("bitlength %zu invalid", bitlength);
+		struct stream stream;
+		stream_init(&stream, bitlength);
+		if (!stdio && S_ISFIFO(st.st_mode)) {
+			NB_die_if(stdin_splice(&stream), "");
+		} else {
+			NB_die_if(stdin_stdio(&stream), "");
+		}
+		NB_die_if(stream_final(&stream, hex), "");
 	}
 
+	printf("%s  -\n", hex);
+
 die:
 	if (map && map != MAP_FAILED)
 		munmap(map, st.st_size);
-	if (fd != -1)
-		close(fd);
+	return err_cnt;
+}
+
+
+/*	struct job
+ * One FILE argument: filled in by a worker, printed (in order) by main().
+ */
+struct job {
+	const char	*file;
+	char		hex[HEX_MAX];
+	int		err;
+	int		done;
+};
+
+/*	struct pool
+ * Workers take jobs in argument order and mark them done;
+ * main() waits on each job in turn and prints it.
+ */
+struct pool {
+	struct job	*jobs;
+	size_t		cnt;
+	size_t		next;		/* next job to take; atomic */
+	size_t		bitlength;
+	long		tree_threads;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+};
+
+
+/*	pool_worker()
+ * Hash files until there are no more jobs.
+ * Each worker reuses a single SMALL_FILE buffer for all the small files it reads.
+ */
+static void *pool_worker(void *arg)
+{
+	struct pool *pool = arg;
+	uint8_t *buf = malloc(SMALL_FILE); /* NULL is OK: every file gets mapped */
+
+	size_t i;
+	while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->cnt) {
+		struct job *job = &pool->jobs[i];
+
+		/* '-' (stdin) is hashed by main() when its turn comes */
+		if (strcmp(job->file, "-"))
+			job->err = hash_file(job->file, pool->bitlength, pool->tree_threads,
+						buf, job->hex);
+
+		pthread_mutex_lock(&pool->lock);
+		job->done = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+
+/*	do_files()
+ * Hash 'cnt' files using (at most) 'threads' workers;
+ * print results in the order given.
+ */
+int do_files(char **files, size_t cnt, size_t bitlength)
+{
+	int err_cnt = 0;
+	struct pool pool = {
+		.cnt = cnt,
+		.bitlength = bitlength,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER
+	};
+	pthread_t *workers = NULL;
+	long started = 0;
+
+	long nthr = threads;
+	if (nthr > cnt)
+		nthr = cnt;
+	/* spare threads go to tree-hashing each file */
+	pool.tree_threads = threads / nthr;
+
+	NB_die_if(!(
+		pool.jobs = calloc(cnt, sizeof(*pool.jobs))
+		), "calloc %zu jobs", cnt);
+	for (size_t i=0; i < cnt; i++)
+		pool.jobs[i].file = files[i];
+
+	NB_die_if(!(
+		workers = calloc(nthr, sizeof(*workers))
+		), "calloc %ld workers", nthr);
+	for (; started < nthr; started++) {
+		NB_die_if(pthread_create(&workers[started], NULL, pool_worker, &pool),
+			"pthread_create");
+	}
+
+	for (size_t i=0; i < cnt; i++) {
+		struct job *job = &pool.jobs[i];
+
+		pthread_mutex_lock(&pool.lock);
+		while (!job->done)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		if (!strcmp(job->file, "-"))
+			err_cnt += do_stdin(bitlength);
+		else if (job->err)
+			err_cnt += job->err;
+		else
+			printf("%s  %s\n", job->hex, job->file);
+	}
+
+die:
+	/* on error, let workers drain the remaining jobs before freeing them */
+	for (long i=0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	free(pool.jobs);
+	return err_cnt;
+}
+
+
+
+/*	struct entry
+ * One line of a manifest being checked: 'want' and 'file' point into 'line'.
+ */
+struct entry {
+	char		*line;
+	size_t		cap;		/* of 'line', grown by getline() */
+	const char	*want;
+	const char	*file;
+};
+
+/*	entry_parse()
+ * Split a manifest line, as printed by fnvsum (or md5sum): HASH, two spaces
+ * (or space and '*'), FILE. Leading zeroes of HASH are dropped:
+ * fnvsum does not print them.
+ * Returns 0 on success.
+ */
+int entry_parse(struct entry *e, size_t len)
+{
+	char *line = e->line;
+	if (len && line[len-1] == '\n')
+		line[--len] = '\0';
+	if (len && line[len-1] == '\r')
+		line[--len] = '\0';
+
+	size_t hex_len = strspn(line, "0123456789abcdefABCDEF");
+	if (!hex_len || hex_len >= HEX_MAX || hex_len + 2 >= len)
+		return 1;
+	if (line[hex_len] != ' ' || (line[hex_len+1] != ' ' && line[hex_len+1] != '*'))
+		return 1;
+
+	line[hex_len] = '\0';
+	e->file = &line[hex_len + 2];
+	while (line[0] == '0' && line[1])
+		line++;
+	e->want = line;
+	return 0;
+}
+
+
+/*	do_check()
+ * Verify the files listed in 'manifest' ('-' for stdin),
+ * which is read CHECK_BATCH lines at a time: memory use does not depend on its length.
+ * Each batch is hashed by (at most) 'threads' workers, then its failures printed.
+ * Returns 0 if all files listed were verified.
+ */
+int do_check(const char *manifest, size_t bitlength)
+{
+	int err_cnt = 0;
+	FILE *in = stdin;
+	struct entry *entries = NULL;
+	size_t bad_lines = 0;
+	size_t failed = 0;
+	struct pool pool = {
+		.bitlength = bitlength,
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER
+	};
+	pthread_t *workers = NULL;
+
+	if (strcmp(manifest, "-")) {
+		NB_die_if(!(
+			in = fopen(manifest, "r")
+			), "open manifest '%s'", manifest);
+	}
+
+	long nthr = threads > CHECK_BATCH ? CHECK_BATCH : threads;
+	NB_die_if(!(
+		entries = calloc(CHECK_BATCH, sizeof(*entries))
+		), "calloc %d entries", CHECK_BATCH);
+	NB_die_if(!(
+		pool.jobs = calloc(CHECK_BATCH, sizeof(*pool.jobs))
+		), "calloc %d jobs", CHECK_BATCH);
+	NB_die_if(!(
+		workers = calloc(nthr, sizeof(*workers))
+		), "calloc %ld workers", nthr);
+
+	for (int eof = 0; !eof; ) {
+		/* read a batch */
+		size_t cnt = 0;
+		while (cnt < CHECK_BATCH) {
+			struct entry *e = &entries[cnt];
+			ssize_t len = getline(&e->line, &e->cap, in);
+			if (len < 0) {
+				eof = 1;
+				break;
+			}
+			if (len == 1 && e->line[0] == '\n')
+				continue;
+			if (entry_parse(e, len)) {
+				bad_lines++;
+				continue;
+			}
+			pool.jobs[cnt++] = (struct job){ .file = e->file };
+		}
+		NB_die_if(ferror(in), "read manifest '%s'", manifest);
+		if (!cnt)
+			continue;
+
+		/* hash it */
+		pool.cnt = cnt;
+		pool.next = 0;
+		long run = nthr > cnt ? cnt : nthr;
+		pool.tree_threads = threads / run;
+		long started = 0;
+		while (started < run && !pthread_create(&workers[started], NULL, pool_worker, &pool))
+			started++;
+		NB_die_if(!started, "pthread_create");
+		for (long i=0; i < started; i++)
+			pthread_join(workers[i], NULL);
+
+		/* report failures only */
+		for (size_t i=0; i < cnt; i++) {
+			struct job *job = &pool.jobs[i];
+			/* '-' is skipped by workers: stdin is the manifest or not a file */
+			if (job->err || !strcmp(job->file, "-")) {
+				printf("%s: FAILED open or read\n", job->file);
+				failed++;
+			} else if (strcasecmp(job->hex, entries[i].want)) {
+				printf("%s: FAILED\n", job->file);
+				failed++;
+			}
+		}
+	}
+
+	/* always printed: NB_wrn() is silent in release builds */
+	if (bad_lines)
+		fprintf(stderr, "WARNING: %zu lines improperly formatted\n", bad_lines);
+	if (failed)
+		fprintf(stderr, "WARNING: %zu listed files FAILED\n", failed);
+	err_cnt += (failed != 0);
+
+die:
+	if (in && in != stdin)
+		fclose(in);
+	if (entries) {
+		for (size_t i=0; i < CHECK_BATCH; i++)
+			free(entries[i].line);
+	}
+	free(entries);
+	free(pool.jobs);
+	free(workers);
 	return err_cnt;
 }
 
@@ -125,13 +810,23 @@ die:
  */
 static const char *usage =
 "usage:\n"
-"\t%s [OPTIONS] [FILE]\n"
+"\t%s [OPTIONS] [FILE]...\n"
 "\n"
-"Calculate the 64-bit FNV1a hash of FILE.\n"
+"Calculate the 64-bit FNV1a hash of each FILE.\n"
 "Read from standard input if no FILE or when FILE is '-'\n"
 "\n"
 "Options:\n"
-"\t-l, --length LENGTH	: return a hash of LENGTH bits (currently supported: 64, 32, 16)\n"
+"\t-l, --length LENGTH	: return a hash of LENGTH bits (currently supported: 128, 64, 32, 16)\n"
+"\t-a, --algorithm ALGO	: 'fnv1a' (default) or 'fast': a word-at-a-time 64-bit FNV variant\n"
+"\t			  for bulk data (a different value than FNV1a; see fnv.h)\n"
+"\t-t, --tree		: 64-bit FNV1a tree hash over 1MiB leaves, hashed in parallel\n"
+"\t			  (a different value than the plain hash; see fnv.h)\n"
+"\t-j, --jobs N		: hash using N threads (default: one per CPU);\n"
+"\t			  output is always in the order FILEs are given\n"
+"\t-s, --stdio		: read standard input with stdio instead of splice()/mmap()\n"
+"\t-c, --check		: read hashes and file names from each FILE (as output by fnvsum)\n"
+"\t			  and verify them, printing only failures; hash options\n"
+"\t			  (length, algorithm, tree) must match those used to create it\n"
 "\t-h, --help		: print usage and exit\n";
 
 
@@ -146,15 +841,42 @@ int main(int argc, char **argv)
 		int opt;
 		static struct option long_options[] = {
 			{ "length",	required_argument,	0,	'l'},
+			{ "algorithm",	required_argument,	0,	'a'},
+			{ "tree",	no_argument,		0,	't'},
+			{ "jobs",	required_argument,	0,	'j'},
+			{ "stdio",	no_argument,		0,	's'},
+			{ "check",	no_argument,		0,	'c'},
 			{ "help",	no_argument,		0,	'h'},
 			{0, 0, 0, 0}
 		};
-		while ((opt = getopt_long(argc, argv, "l:h", long_options, NULL)) != -1) {
+		while ((opt = getopt_long(argc, argv, "l:a:tj:sch", long_options, NULL)) != -1) {
 			switch(opt) {
 			case 'l':
 				NB_die_if(!optarg, "optarg not provided");
 				bitlength = strtol(optarg, NULL, 10);
 				break;
+			case 'a':
+				NB_die_if(!optarg, "optarg not provided");
+				if (!strcmp(optarg, "fast"))
+					fast = 1;
+				else
+					NB_die_if(strcmp(optarg, "fnv1a"), "unknown algorithm '%s'", optarg);
+				break;
+			case 't':
+				tree = 1;
+				break;
+			case 'j':
+				NB_die_if(!optarg, "optarg not provided");
+				NB_die_if((
+					threads = strtol(optarg, NULL, 10)
+					) < 1, "invalid number of jobs '%s'", optarg);
+				break;
+			case 's':
+				stdio = 1;
+				break;
+			case 'c':
+				check = 1;
+				break;
 			case 'h':
 				fprintf(stderr, usage, argv[0]);
 				goto die;
@@ -165,13 +887,26 @@ int main(int argc, char **argv)
 		}
 	}
 
+	NB_die_if(tree && bitlength != 64, "tree hash is 64-bit only");
+	NB_die_if(fast && bitlength != 64, "fast hash is 64-bit only");
+	NB_die_if(fast && tree, "fast hash has no tree mode");
+	if (!threads && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		threads = 1;
+
+	if (check) {
+		if (optind == argc)
+			return do_check("-", bitlength);
+		for (int i=optind; i < argc; i++)
+			err_cnt += do_check(argv[i], bitlength);
+		goto die;
+	}
+
 	/* no args means "hash from stdint" */
 	if (optind == argc)
 		return do_stdin(bitlength);
 
 	/* otherwise, look for files */
-	while (optind < argc)
-		err_cnt += do_file(argv[optind++], bitlength);
+	err_cnt += do_files(&argv[optind], argc - optind, bitlength);
 
 die:
 	return err_cnt;
@@ -0,0 +1,244 @@
+/*	nhex.c
+ * A command-line application, on the pattern of 'xxd -p' and 'xxd -r -p',
+ * which converts binary to plain hex and back using the binhex hx_stream codec.
+ *
+ * A regular FILE is mapped and converted in place;
+ * standard input (or any other FILE) is spliced into an nmem buffer
+ * a chunk at a time, so input of any size streams through in constant memory.
+ *
+ * (c) 2018 Sirio Balmelli; https://b-ad.ch
+ */
+
+#include <ndebug.h>
+#include <binhex.h>
+#include <nmem.h>
+#include <getopt.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h> /* open() */
+#include <stdlib.h> /* strtoul() */
+#include <string.h> /* strcmp() */
+
+
+/*
+	global option flags
+*/
+static int reverse = 0;
+static size_t cols = 30; /* bytes per line, as 'xxd -p' */
+
+
+/* Input is converted this many bytes at a time */
+#define NHEX_CHUNK (1024 * 1024)
+
+
+/* Use as a printf prototype.
+ * Expects 'program_name' as a string variable.
+ */
+static const char *usage =
+"Usage:\n"
+"\t%1$s [OPTION]... [FILE]\n"
+"\n"
+"Write FILE (or standard input) to standard output as plain hex;\n"
+"or with '-r', parse plain hex (whitespace is ignored) back into binary.\n"
+"\n"
+"Options:\n"
+"\t-r, --reverse		: hex to binary\n"
+"\t-c, --cols BYTES	: bytes per output line (default 30); 0 is one line\n"
+"\t-h, --help		: print usage and exit\n";
+
+
+/*	struct conv
+ * Converts a stream of chunks; owns the output buffer.
+ */
+struct conv {
+	struct hx_stream	hs;
+	char			*out;
+	size_t			out_len;
+	size_t			out_max;
+};
+
+
+/*	write_all()
+ * Writes 'len' bytes at 'buf' to stdout.
+ * Output is written, not spliced: pages spliced into a pipe are only
+ * referenced, and the output buffer is reused for the next chunk.
+ * Returns 0 on success.
+ */
+static int write_all(const void *buf, size_t len)
+{
+	int err_cnt = 0;
+	const char *p = buf;
+	while (len) {
+		ssize_t ret = write(STDOUT_FILENO, p, len);
+		NB_die_if(ret < 1, "write() stdout");
+		p += ret;
+		len -= ret;
+	}
+die:
+	return err_cnt;
+}
+
+
+/*	conv_chunk()
+ * Convert 'len' bytes at 'mem' and write the result.
+ * Returns 0 on success.
+ */
+static int conv_chunk(struct conv *cv, const void *mem, size_t len)
+{
+	int err_cnt = 0;
+
+	if (reverse) {
+		size_t start = cv->hs.pos;
+		ssize_t ret = hx_stream_dec(&cv->hs, mem, len, (uint8_t *)cv->out);
+		NB_die_if(ret < 0, "not hex: '%c' at offset %zu",
+			((const char *)mem)[cv->hs.pos - start], cv->hs.pos);
+		cv->out_len = ret;
+	} else {
+		cv->out_len = hx_stream_enc(&cv->hs, mem, len, cv->out);
+	}
+	NB_die_if(write_all(cv->out, cv->out_len), "");
+
+die:
+	return err_cnt;
+}
+
+
+/*	conv_end()
+ * Finish the stream.
+ * Returns 0 on success.
+ */
+static int conv_end(struct conv *cv)
+{
+	int err_cnt = 0;
+	if (reverse) {
+		NB_die_if(hx_stream_dec_end(&cv->hs), "odd number of hex digits");
+	} else {
+		cv->out_len = hx_stream_enc_end(&cv->hs, cv->out);
+		NB_die_if(write_all(cv->out, cv->out_len), "");
+	}
+die:
+	return err_cnt;
+}
+
+
+/*	conv_mapped()
+ * Convert a regular file by mapping it.
+ */
+static int conv_mapped(struct conv *cv, const char *path)
+{
+	int err_cnt = 0;
+	struct nmem nm = { .fd = -1 };
+
+	NB_die_if(nmem_file(path, &nm), "");
+	for (size_t off = 0; off < nm.len; off += NHEX_CHUNK) {
+		size_t len = nm.len - off < NHEX_CHUNK ? nm.len - off : NHEX_CHUNK;
+		NB_die_if(conv_chunk(cv, (const char *)nm.mem + off, len), "");
+	}
+
+die:
+	nmem_free(&nm, NULL);
+	return err_cnt;
+}
+
+
+/*	conv_spliced()
+ * Convert anything else (e.g. a pipe) by splicing it into a buffer,
+ * one chunk at a time.
+ */
+static int conv_spliced(struct conv *cv, int fd)
+{
+	int err_cnt = 0;
+	struct nmem buf = { .fd = -1 };
+
+	NB_die_if(nmem_alloc(NHEX_CHUNK, NULL, &buf), "alloc %d B buffer", NHEX_CHUNK);
+	for (;;) {
+		size_t fill = 0;
+		ssize_t ret = 0;
+		while (fill < buf.len && (ret = nmem_in_splice(&buf, fill, buf.len - fill, fd)) > 0)
+			fill += ret;
+		NB_die_if(ret < 0, "splice() input");
+		if (fill) {
+			NB_die_if(conv_chunk(cv, buf.mem, fill), "");
+		}
+		if (fill < buf.len)
+			break;
+	}
+
+die:
+	nmem_free(&buf, NULL);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	struct conv cv = { 0 };
+	int fd = -1;
+
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "reverse",	no_argument,		0,	'r'},
+		{ "cols",	required_argument,	0,	'c'},
+		{ "help",	no_argument,		0,	'h'},
+		{0, 0, 0, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "rc:h", long_options, NULL)) != -1) {
+		switch(opt) {
+		case 'r':
+			reverse = 1;
+			break;
+		case 'c':
+		{
+			char *end = NULL;
+			errno = 0;
+			cols = strtoul(optarg, &end, 10);
+			NB_die_if(errno || *end || cols > NHEX_CHUNK, "invalid cols '%s'", optarg);
+			break;
+		}
+		case 'h':
+			fprintf(stderr, usage, argv[0]);
+			goto die;
+		default:
+			NB_die(""); /* libc will already complain about invalid option */
+		}
+	}
+	if (errno == 0x26) errno = 0;  /* weird getopt errno, pointedly ignore */
+	NB_die_if(argc - optind > 1, "more than one FILE");
+
+	hx_stream_init(&cv.hs, reverse ? 0 : cols);
+	cv.out_max = reverse ? NHEX_CHUNK / 2 + 1 : hx_stream_enc_max(&cv.hs, NHEX_CHUNK);
+	NB_die_if(!(
+		cv.out = malloc(cv.out_max)
+		), "malloc %zu", cv.out_max);
+
+	/* map regular files; splice everything else */
+	const char *path = argc > optind ? argv[optind] : NULL;
+	struct stat st = { 0 };
+	if (path && strcmp(path, "-")) {
+		NB_die_if(stat(path, &st), "'%s'", path);
+		if (S_ISREG(st.st_mode) && st.st_size) {
+			NB_die_if(conv_mapped(&cv, path), "");
+			goto end;
+		}
+		NB_die_if((
+			fd = open(path, O_RDONLY)
+			) == -1, "open '%s'", path);
+	} else {
+		fd = STDIN_FILENO;
+	}
+	NB_die_if(conv_spliced(&cv, fd), "");
+
+end:
+	NB_die_if(conv_end(&cv), "");
+
+die:
+	if (fd > STDIN_FILENO)
+		close(fd);
+	free(cv.out);
+	return err_cnt;
+}
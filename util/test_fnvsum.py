@@ -11,6 +11,7 @@ and checking again expected output.
 import subprocess
 import sys
 import os
+import time
 
 HASH64 = {
     b''                                              : 0xcbf29ce484222325,
@@ -32,8 +33,72 @@ HASH32 = {
     b'Dan Smith'                                     : 0x0d2b7f73,
     b'blaar'                                         : 0x6f93f02d
 }
+HASH128 = {
+    b''                                              : 0x6c62272e07bb014262b821756295c58d,
+    b'the quick brown fox jumped over the lazy dog'  : 0x44277a16f91ee613fe68853261156ce0,
+    b'/the/enemy/gate/is/down'                       : 0x1d1a8250ad235a5bc4b6635f195a6006,
+    b'\t{}[]*\&^%$#@!'                               : 0xe3f855f370643df816d8999adb168caf,  #pylint: disable=anomalous-backslash-in-string
+    b'eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee'        : 0xccb137d314bf33f880b78477deae80bb,
+    b'The player formerly known as mousecop'         : 0x7281d32ee5e963ab52283de2b322386d,
+    b'Dan Smith'                                     : 0xa109a64bee05375c0a6f57b80c5f31c3,
+    b'blaar'                                         : 0x5a7bcefa1683d94f70814eb9d3708e05
+}
 
 FNVSUM = 'util/fnvsum'
+TREE_LEAF = 1 << 20
+
+
+
+def fnv64(data, hsh=0xcbf29ce484222325):
+    '''reference FNV1a 64-bit'''
+    for byte in data:
+        hsh = ((hsh ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+    return hsh
+
+
+
+def fnv128(data, hsh=0x6c62272e07bb014262b821756295c58d):
+    '''reference FNV1a 128-bit'''
+    for byte in data:
+        hsh = ((hsh ^ byte) * 0x0000000001000000000000000000013b) & ((1 << 128) - 1)
+    return hsh
+
+
+
+def fnv32(data, hsh=0x811c9dc5):
+    '''reference FNV1a 32-bit'''
+    for byte in data:
+        hsh = ((hsh ^ byte) * 0x01000193) & 0xffffffff
+    return hsh
+
+
+
+def fnv16(data):
+    '''reference FNV1a 16-bit: xor-folded 32-bit'''
+    hsh = fnv32(data)
+    return (hsh >> 16) ^ (hsh & 0xffff)
+
+
+
+def fnv64_fast(data):
+    '''reference fast FNV64: 8 lanes over 64B stripes of little-endian words'''
+    lanes = [0xcbf29ce484222325 ^ i for i in range(8)]
+    stripes = len(data) // 64
+    for j in range(stripes):
+        for i in range(8):
+            word = int.from_bytes(data[j*64 + i*8 : j*64 + i*8 + 8], 'little')
+            hsh = ((lanes[i] ^ word) * 0x100000001b3) & 0xffffffffffffffff
+            lanes[i] = ((hsh << 29) | (hsh >> 35)) & 0xffffffffffffffff
+    hsh = fnv64(b''.join(lane.to_bytes(8, 'little') for lane in lanes))
+    hsh = fnv64(data[stripes * 64:], hsh)
+    return fnv64(len(data).to_bytes(8, 'little'), hsh)
+
+
+
+def fnv64_tree(data):
+    '''reference tree hash: FNV1a over little-endian digests of 1MiB leaves'''
+    leaves = [data[i:i+TREE_LEAF] for i in range(0, len(data), TREE_LEAF)] or [b'']
+    return fnv64(b''.join(fnv64(leaf).to_bytes(8, 'little') for leaf in leaves))
 
 
 
@@ -84,6 +149,140 @@ def fnvsum_file(str_in, expect_fnv, args=[]):  # pylint: disable=dangerous-defau
 
 
 
+def fnvsum_redirect(str_in, expect_fnv, args=[]):  # pylint: disable=dangerous-default-value
+    '''put 'string' in a file; give that file to fnvsum as stdin (mapped, not piped);
+        verify that output matches 'expect_fnv'
+    '''
+    with open('./temp', 'wb') as fil:
+        fil.write(str_in)
+
+    try:
+        with open('./temp', 'rb') as fil:
+            sub = subprocess.run([FNVSUM] + args, stdin=fil,
+                                 stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                 shell=False, check=True)
+    except subprocess.CalledProcessError as err:
+        print(err.cmd)
+        print(err.stdout.decode('ascii'))
+        print(err.stderr.decode('ascii'))
+        exit(1)
+
+    res = int(sub.stdout.decode('ascii').split(' ')[0], 16)
+    if res != expect_fnv:
+        print('%xd != %xd;  %s' % (res, expect_fnv, str_in), sys.stderr)
+        exit(1)
+
+    os.remove('./temp')
+
+
+
+def bench_stdin(size, algo=[]):  # pylint: disable=dangerous-default-value
+    '''pipe 'size' bytes through fnvsum (with 'algo' args)
+        using splice() and (with '--stdio') fread();
+        verify both give the same hash and print their throughput
+    '''
+    blob = os.urandom(size)
+    out = {}
+    for args in [[], ['--stdio']]:
+        start = time.monotonic()
+        sub = subprocess.run([FNVSUM] + algo + args, input=blob,
+                             stdout=subprocess.PIPE, shell=False, check=True)
+        elapsed = time.monotonic() - start
+        out[sub.stdout] = elapsed
+        print('stdin %-8s %-8s %4d MiB: %7.1f MiB/s' % (' '.join(algo) or 'fnv1a',
+                                                        ' '.join(args) or 'splice',
+                                                        size >> 20, (size >> 20) / elapsed))
+    if len(out) != 1:
+        print('splice and stdio stdin paths disagree', sys.stderr)
+        exit(1)
+
+
+
+def fnvsum_many(args=[]):  # pylint: disable=dangerous-default-value
+    '''hash many files of assorted sizes (and stdin) in one run;
+        verify output is in argument order and correct
+    '''
+    os.makedirs('./temp_many', exist_ok=True)
+    names = []
+    expect = []
+    for i in range(64):
+        blob = bytes((i * j) & 0xff for j in range(i * 1531))  # up to ~96KiB
+        name = './temp_many/%d' % i
+        with open(name, 'wb') as fil:
+            fil.write(blob)
+        names.append(name)
+        expect.append('%x  %s' % (fnv64(blob), name))
+    # stdin, somewhere in the middle
+    names.insert(17, '-')
+    expect.insert(17, '%x  -' % fnv64(b'stdin'))
+
+    try:
+        sub = subprocess.run([FNVSUM] + args + names, input=b'stdin',
+                             stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                             shell=False, check=True)
+    except subprocess.CalledProcessError as err:
+        print(err.cmd)
+        print(err.stdout.decode('ascii'))
+        print(err.stderr.decode('ascii'))
+        exit(1)
+
+    lines = sub.stdout.decode('ascii').splitlines()
+    if lines != expect:
+        print('unexpected output with %s' % args, sys.stderr)
+        exit(1)
+
+    for name in names:
+        if name != '-':
+            os.remove(name)
+    os.rmdir('./temp_many')
+
+
+
+def fnvsum_check(args=[]):  # pylint: disable=dangerous-default-value
+    '''write a manifest with fnvsum; verify it checks clean;
+        then corrupt, remove and misformat entries and verify only those are reported
+    '''
+    os.makedirs('./temp_check', exist_ok=True)
+    names = []
+    for i in range(5000):  # more than one batch
+        name = './temp_check/%d' % i
+        with open(name, 'wb') as fil:
+            fil.write(bytes((i * j) & 0xff for j in range(i % 97)))
+        names.append(name)
+
+    sub = subprocess.run([FNVSUM] + args + names, stdout=subprocess.PIPE, check=True)
+    with open('./temp_manifest', 'wb') as fil:
+        fil.write(sub.stdout)
+
+    sub = subprocess.run([FNVSUM, '-c'] + args + ['./temp_manifest'],
+                         stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if sub.returncode or sub.stdout:
+        print('clean manifest failed check with %s' % args, sys.stderr)
+        print(sub.stdout.decode('ascii'), sys.stderr)
+        exit(1)
+
+    with open(names[4321], 'ab') as fil:
+        fil.write(b'x')
+    os.remove(names[7])
+    with open('./temp_manifest', 'ab') as fil:
+        fil.write(b'not a manifest line\n')
+    with open('./temp_manifest', 'rb') as fil:
+        sub = subprocess.run([FNVSUM, '-c'] + args, stdin=fil,
+                             stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    expect = ['%s: FAILED open or read' % names[7], '%s: FAILED' % names[4321]]
+    if sub.returncode != 1 or sub.stdout.decode('ascii').splitlines() != expect:
+        print('unexpected check output with %s' % args, sys.stderr)
+        print(sub.stdout.decode('ascii'), sys.stderr)
+        exit(1)
+
+    for name in names:
+        if os.path.exists(name):
+            os.remove(name)
+    os.rmdir('./temp_check')
+    os.remove('./temp_manifest')
+
+
+
 #   main()
 if __name__ == "__main__":
     if sys.argv[1] is not None:
@@ -98,3 +297,40 @@ if __name__ == "__main__":
     for string, fnv in HASH32.items():
         fnvsum_stdin(string, fnv, ['-l 32'])
         fnvsum_file(string, fnv, ['-l 32'])
+
+    for string in HASH64:
+        fnvsum_stdin(string, fnv64_fast(string), ['-a', 'fast'])
+        fnvsum_file(string, fnv64_fast(string), ['-a', 'fast'])
+    # empty file: hashed from a NULL mapping
+    fnvsum_file(b'', fnv64_fast(b''), ['-a', 'fast'])
+
+    for string, fnv in HASH128.items():
+        fnvsum_stdin(string, fnv, ['-l 128'])
+        fnvsum_file(string, fnv, ['-l 128'])
+
+    # stdin: piped, mapped and through stdio; across chunk/buffer boundaries
+    for size in [0, 4095, 4097, 4 * 1024 * 1024 + 3]:
+        blob = bytes((i * 13 + (i >> 9)) & 0xff for i in range(size))
+        for args, fnv in [([], fnv64(blob)), (['-l', '32'], fnv32(blob)),
+                          (['-l', '16'], fnv16(blob)), (['-l', '128'], fnv128(blob)),
+                          (['-a', 'fast'], fnv64_fast(blob))]:
+            fnvsum_stdin(blob, fnv, args)
+            fnvsum_stdin(blob, fnv, args + ['--stdio'])
+            fnvsum_redirect(blob, fnv, args)
+            fnvsum_file(blob, fnv, args)
+
+    for jobs in ['1', '3', '16']:
+        fnvsum_many(['-j', jobs])
+
+    for args in [[], ['-l', '32'], ['-a', 'fast'], ['-j', '3']]:
+        fnvsum_check(args)
+
+    # tree hash: empty, single short leaf, exact leaf, many leaves with a short tail
+    for size in [0, 23, TREE_LEAF, 3 * TREE_LEAF + 7]:
+        blob = bytes((i * 7 + (i >> 11)) & 0xff for i in range(size))
+        fnv = fnv64_tree(blob)
+        fnvsum_stdin(blob, fnv, ['--tree'])
+        fnvsum_file(blob, fnv, ['--tree'])
+
+    bench_stdin(256 << 20)
+    bench_stdin(256 << 20, ['-a', 'fast'])
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+'''test_nhex.py
+Test the 'nhex' utility: its output against Python's own hex conversion,
+for files and pipes, line widths, and hex split and spaced arbitrarily.
+(c) 2018 Sirio Balmelli
+'''
+
+import binascii
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+NHEX = 'util/nhex'
+
+
+
+def run(args, data):
+    '''run nhex with 'args', 'data' on stdin; return (returncode, stdout)'''
+    sub = subprocess.run([NHEX] + args, input=data,
+                         stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                         shell=False, check=False)
+    return sub.returncode, sub.stdout
+
+
+
+def hexlines(data, cols):
+    '''expected 'nhex -c cols' output'''
+    hx = binascii.hexlify(data)
+    if not cols:
+        return hx
+    step = cols * 2
+    return b''.join(hx[i:i+step] + b'\n' for i in range(0, len(hx), step))
+
+
+
+def fail(msg):
+    '''print and exit nonzero'''
+    print(msg, file=sys.stderr)
+    sys.exit(1)
+
+
+
+def check_encode(data, path):
+    '''encode from a pipe and from a (mapped) file, at several line widths'''
+    for cols in [30, 0, 1, 16, 4096]:
+        args = ['-c', str(cols)] if cols != 30 else []
+        expect = hexlines(data, cols)
+        ret, out = run(args, data)
+        if ret or out != expect:
+            fail(f'encode stdin cols {cols}: {ret}; {out[:64]} != {expect[:64]}')
+        ret, out = run(args + [path], b'')
+        if ret or out != expect:
+            fail(f'encode file cols {cols}: {ret}; {out[:64]} != {expect[:64]}')
+
+
+
+def check_decode(data):
+    '''decode hex with whitespace sprinkled in, also between digits of a byte'''
+    hx = binascii.hexlify(data)
+    rnd = random.Random(42)
+    spaced = bytearray()
+    for digit in hx:
+        spaced.append(digit)
+        if rnd.random() < 0.1:
+            spaced += rnd.choice([b' ', b'\n', b'\t', b'\r\n'])
+    ret, out = run(['-r'], bytes(spaced).upper())
+    if ret or out != data:
+        fail(f'decode: {ret}; {len(out)} bytes of {len(data)}')
+
+
+
+def check_errors():
+    '''bad characters and odd digit counts fail'''
+    for bad in [b'abz0', b'abc', b'0x12']:
+        ret, _ = run(['-r'], bad)
+        if not ret:
+            fail(f'decoding {bad} did not fail')
+
+
+
+#   main()
+if __name__ == "__main__":
+    if len(sys.argv) > 1:
+        NHEX = sys.argv[1]
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for size in [0, 1, 15, 31, 64, 1000, 3 * 1024 * 1024 + 7]:
+            data = os.urandom(size)
+            path = os.path.join(tmp, f'{size}.bin')
+            with open(path, 'wb') as f:
+                f.write(data)
+            check_encode(data, path)
+            check_decode(data)
+    check_errors()